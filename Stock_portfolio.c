@@ -1,97 +1,601 @@
+// POSIX.1-2008 (st_mtim, mkdtemp) plus madvise, usleep and strcasecmp,
+// which strict -std=c11 would otherwise hide
+#define _POSIX_C_SOURCE 200809L
+#define _DEFAULT_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
 #include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+#include <sys/types.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <signal.h>
+#include <errno.h>
+#include <math.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <limits.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define HAVE_AVX2_KERNELS 1   // AVX2 kernels compiled in, used if the CPU has it
+#endif
+
+// Build: gcc -O2 -pthread Stock_portfolio.c -o portfolio -lm
 
 #define TABLE_SIZE      101
+#define MARKET_INITIAL_CAPACITY 64   // Market index capacity, always a power of two
+#define MARKET_MAX_LOAD_PERCENT 85   // Grow the market index beyond this load factor
+#define MARKET_PAGE_SIZE 20          // Rows per page in prefix search results
 #define MAX_SYMBOL_LEN  16
 #define MAX_SECTOR_LEN  20
 #define MAX_DATE_LEN    32
-#define MAX_TRANSACTIONS 1000  // For transaction history
+#define PRICE_TOLERANCE 1e-6         // Relative; saved prices carry 10 decimals
+#define TRANSACTION_CHUNK_SIZE 4096  // Transactions per history chunk
+#define HISTORY_PAGE_SIZE 20         // Records per page in history query results
+#define LEADERBOARD_DEFAULT_K 20     // Rows per side of the batch LEADERS report
+#define MAX_ACCOUNT_NAME 32
+#define MAX_PATH_LEN    256
+#define MAX_OPEN_JOURNALS 64         // Journal files kept open at once across accounts
+#define HOLDING_CHECKPOINT_DELTAS 256  // Holding deltas between background checkpoints
+#define TICK_READ_SIZE (1 << 16)     // Read buffer for the price tick feed
+#define TICK_LATENCY_SAMPLES 65536   // Latency samples kept for percentiles
+#define TOTALS_RESUM_INTERVAL 1024   // Running-total updates between exact re-sums
+#define PROBE_HISTOGRAM_BUCKETS 8    // Probe lengths 1, 2, 3, 4, 5-8, 9-16, 17-32, 33+
+
+// Build with -DTABLE_STATS to count the probes of every market and holdings
+// lookup (see TABLE HEALTH); without it the counting hooks compile away.
 
 #define MARKET_FILE "market_data.txt"     // Market data: symbol, sector, current price
 #define USER_FILE   "user_portfolio.txt"  // User: holdings
-#define TRANSACTION_FILE "transactions.txt"  // Transaction history
+#define TRANSACTION_FILE "transactions.txt"  // Transaction history (append-only journal)
+#define ACCOUNTS_DIR "accounts"    // Other accounts: accounts/<name>/{USER_FILE,TRANSACTION_FILE}
+#define DEFAULT_ACCOUNT "default"  // The account stored in USER_FILE and TRANSACTION_FILE
+
+// Binary snapshots sit next to each text file ("x.txt" -> "x.bin") and are
+// used at startup whenever they still match the text file they were saved with.
+#define SNAPSHOT_MAGIC   0x504e5353U   // "SSNP"
+#define SNAPSHOT_VERSION 8
+#define SNAPSHOT_MARKET       1
+#define SNAPSHOT_HOLDINGS     2
+#define SNAPSHOT_TRANSACTIONS 3
 
 typedef enum {
     EMPTY,
     OCCUPIED,
-    DELETED
+    DELETED     // tombstone; only found in holdings snapshots of older builds
 } EntryStatus;
 
 // -------- Market Entry --------
+// Row form of a market entry. The market table itself is stored as columns
+// (see Global tables); this layout is kept as the baseline for --bench-layout.
 typedef struct {
     char symbol[MAX_SYMBOL_LEN];
-    char sector[MAX_SECTOR_LEN];
+    int sectorId;        // id in the sector dictionary
     double price;
     EntryStatus status;
 } MarketEntry;
 
+// Consistent copy of one market row for lock-free readers (see CONCURRENT
+// MARKET READS)
+typedef struct {
+    char symbol[MAX_SYMBOL_LEN];
+    double price;
+    int sectorId;
+    int listed;
+} MarketQuote;
+
+// -------- Timestamp --------
+// Nanoseconds since 1970-01-01 in local wall-clock time (see Timestamps)
+typedef long long Timestamp;
+#define TIMESTAMP_NONE LLONG_MIN     // unknown date, written as "-"
+#define NS_PER_SECOND 1000000000LL
+#define NS_PER_MINUTE (60 * NS_PER_SECOND)
+#define NS_PER_DAY    (1440 * NS_PER_MINUTE)
+
 // -------- User Holding Entry --------
 typedef struct {
     char symbol[MAX_SYMBOL_LEN];
-    char sector[MAX_SECTOR_LEN];
+    int  sectorId;       // id in the sector dictionary
     int  quantity;
     double avgBuyPrice;
-    char lastBuyDate[MAX_DATE_LEN];
+    Timestamp lastBuyTime;
     EntryStatus status;
 } HoldingEntry;
 
 // -------- Transaction Entry --------
+// How a sell picks the lots it closes (see TAX LOTS); a relief >= 0 is the
+// id of the lot to close, the history index of the buy that opened it.
+#define RELIEF_AVERAGE  -1   // blended average cost
+#define RELIEF_FIFO     -2
+#define RELIEF_LIFO     -3
+
 typedef struct {
     char symbol[MAX_SYMBOL_LEN];
-    int quantity;
+    Timestamp time;
     double pricePerShare;
-    char date[MAX_DATE_LEN];
+    int quantity;
     int type;  // 0 = buy, 1 = sell
+    int relief;  // sells: RELIEF_* or a lot id
 } TransactionEntry;
 
+// -------- Snapshot Header --------
+typedef struct {
+    unsigned int magic;
+    unsigned int version;
+    unsigned int kind;          // SNAPSHOT_MARKET / _HOLDINGS / _TRANSACTIONS
+    unsigned int recordSize;    // sizeof the record struct, guards layout changes
+    long long count;            // number of records
+    long long extra;            // kind-specific (market: index capacity)
+    long long sourceSize;       // size of the text file when the snapshot was taken
+    long long sourceMtimeNs;    // mtime of that text file
+    long long sourceInode;      // inode of that text file
+    unsigned long long sourceChecksum;  // transactions: see prefixChecksum
+} SnapshotHeader;
+
+// -------- Symbol Key --------
+// Symbols are compared as one 64-bit key (see SYMBOL KEYS): up to 8
+// characters are packed into it uppercased, longer symbols are tagged ids in
+// the long symbol table. SYMBOL_KEY_NONE is never the key of a symbol.
+typedef unsigned long long SymbolKey;
+#define SYMBOL_KEY_PACKED_LEN 8
+#define SYMBOL_KEY_NONE    0ULL
+#define SYMBOL_KEY_LONG    (1ULL << 63)
+
+// Name -> id lookup of the long symbol table, replaced as a whole when it
+// grows so readers always see a matching capacity
+typedef struct {
+    unsigned int capacity;   // power of two
+    int slots[];             // long symbol ids, -1 = empty
+} LongSymbolLookup;
+
+// -------- Market Index Slot (Robin Hood) --------
+typedef struct {
+    SymbolKey key;       // symbol key of the row, compared in place
+    int row;             // market row id, -1 = empty slot
+    int dist;            // probe distance from the home slot
+} MarketSlot;
+
+// -------- Probe Statistics (see TABLE HEALTH) --------
+typedef struct {
+    unsigned long long lookups;    // lookups (or stored entries) counted
+    unsigned long long hits;
+    unsigned long long probes;     // slots examined in total
+    unsigned long long maxProbe;
+    unsigned long long histogram[PROBE_HISTOGRAM_BUCKETS];
+} ProbeStats;
+
+// -------- Sector Member List --------
+typedef struct {
+    int *members;       // market rows or holding slots
+    int count;
+    int capacity;
+} SectorMembers;
+
+// -------- Ordered Index (see ORDERED INDEX) --------
+typedef struct {
+    double *key;
+    int *left, *right;
+    int *size;          // subtree size; 0 = id not in the index
+    int root;
+    int capacity;
+} OrderIndex;
+
+// -------- Portfolio Aggregates (see PORTFOLIO AGGREGATES) --------
+typedef struct {
+    int holdings;             // occupied holding slots
+    int pricedHoldings;       // ... of which have a market price
+    double investment;        // avgBuyPrice * quantity over all holdings
+    double pricedInvestment;  // ... over priced holdings only
+    double currentValue;      // price * quantity over priced holdings
+    int updates;              // since the sums were last re-derived
+} PortfolioTotals;
+
+typedef struct {
+    int tracked;              // included in the account's totals
+    int marketRow;            // row the holding is priced against, or -1
+    int holderPos;            // position in marketHolders[marketRow]
+    double cost;              // contribution last added to the totals
+    double value;
+} HoldingAggregate;
+
+// One (account, holding slot) pair holding a market row
+typedef struct {
+    int account;
+    int slot;
+} HolderRef;
+
+typedef struct {
+    HolderRef *refs;
+    int count;
+    int capacity;
+} MarketHolders;
+
+// -------- Valuation Kernel Results (see VALUATION KERNELS) --------
+typedef struct {
+    double sum, min, max;
+} PriceStats;
+
+typedef struct {
+    double cost;    // sum of qty * avgBuyPrice
+    double value;   // sum of qty * price
+} BookTotals;
+
+// -------- History Index (see HISTORY INDEX) --------
+typedef struct {
+    int *records;           // history indexes, by (time, index) unless unsorted
+    int count;
+    int capacity;
+    int unsorted;           // a record was added out of time order
+} HistoryList;
+
+typedef struct {
+    SymbolKey key;          // SYMBOL_KEY_NONE = empty slot
+    HistoryList list;
+    HistoryList sides[2];   // the same records split into buys and sells
+} HistorySymbol;
+
+typedef struct {
+    Timestamp *times;       // per record: its timestamp
+    int count;              // records indexed; equals transactionCount
+    int capacity;
+    int failed;             // an allocation failed; queries are refused
+    HistoryList byTime;     // every record
+    HistoryList bySide[2];  // every buy, every sell
+    HistorySymbol *symbols; // posting lists per symbol, open addressing
+    int symbolCount;
+    int symbolCapacity;     // power of two
+} HistoryIndex;
+
+typedef struct {
+    char symbol[MAX_SYMBOL_LEN];   // "" = any symbol
+    Timestamp from, to;            // inclusive range
+    int type;                      // -1 = any, 0 = buy, 1 = sell
+} HistoryQuery;
+
+// -------- Tax Lots (see TAX LOTS) --------
+typedef struct {
+    Timestamp time;
+    double price;           // per share, before the queue's scale
+    int quantity;           // 0 once a sell of that lot has closed it
+    int id;                 // history index of the opening buy; -1 = opening lot
+} Lot;
+
+typedef struct {
+    SymbolKey key;          // SYMBOL_KEY_NONE = empty slot
+    char symbol[MAX_SYMBOL_LEN];
+    Lot *lots;              // ring buffer in buy order, so ids ascend
+    int head;
+    int count;
+    int capacity;           // power of two
+    int openQuantity;       // shares in the open lots
+    double basis;           // cost of those shares
+    double scale;           // multiplies every lot price; see rescaleLots
+    double realized;        // realized P&L of every sell so far
+} LotQueue;
+
+typedef struct {
+    LotQueue *queues;       // one per symbol traded, open addressing
+    int queueCount;
+    int queueCapacity;      // power of two
+    double realized;        // sum over the queues
+    int failed;             // an allocation failed; lots are incomplete
+} LotBook;
+
+// -------- Account (see ACCOUNTS) --------
+// Everything that belongs to one client: holdings with their sector lists
+// and running aggregates, and the transaction history with its journal.
+// All accounts share the market table.
+typedef struct {
+    char name[MAX_ACCOUNT_NAME];
+    int id;                          // index in accounts[]
+    char holdingsFile[MAX_PATH_LEN];
+    char transactionFile[MAX_PATH_LEN];
+    int dirty;                       // holdings changed since the last save
+
+    HoldingEntry holdings[TABLE_SIZE];
+    // Probe keys per slot, so lookups scan one dense array; SYMBOL_KEY_NONE
+    // = empty. Deletion shifts entries back, so there are no tombstones.
+    SymbolKey holdingKeys[TABLE_SIZE];
+    int sectorPos[TABLE_SIZE];       // per holding slot: position in its list
+    SectorMembers *sectorMembers;    // per sector id: holding slots
+    int sectorMembersCapacity;
+
+    PortfolioTotals totals;          // running totals (see PORTFOLIO AGGREGATES)
+    HoldingAggregate aggregates[TABLE_SIZE];
+    OrderIndex profitIndex;          // priced holdings ordered by profit
+    BookTotals revalued;             // result of the last full revaluation
+
+    // Transaction history is a directory of fixed-size chunks, so appends
+    // never move existing records. With historyWindow > 0 only the most
+    // recent records stay in memory; older chunks are dropped and read back
+    // from transactionFile. The history is loaded on first use.
+    int historyLoaded;
+    TransactionEntry **transactionChunks;
+    int transactionChunkCount;       // chunks currently in memory
+    int transactionChunkCapacity;    // size of the chunk directory
+    int transactionCount;            // total records, including evicted ones
+    int transactionBase;             // index of the first in-memory record
+    HistoryIndex historyIndex;       // symbol and date lookups over all records
+    LotBook lots;                    // open lots and realized P&L per symbol
+    // Record count of the transaction snapshot when it is known to be a
+    // prefix of the journal, or -1
+    int transactionSnapshotCount;
+    long *journalMarks;              // offsets of every JOURNAL_MARK_STRIDE-th record
+    int journalMarkCount;            // marks found so far; 0 after a reload or rewrite
+    int journalMarkCapacity;
+
+    FILE *journal;                   // append-only journal, opened on demand
+    int journalPending;
+    unsigned long long journalUsed;  // journalClock at its last write
+
+    // Holdings persistence: holdingsFile is a checkpoint and the holdings
+    // journal has every slot change since (see HOLDINGS JOURNAL)
+    FILE *holdingJournal;
+    int holdingJournalPending;       // records not yet fsynced
+    unsigned long long holdingJournalUsed;
+    int holdingDeltas;               // records since the last checkpoint
+    pthread_t checkpointThread;      // background checkpoint, if running
+    int checkpointRunning;
+    _Atomic int checkpointFinished;
+} Account;
+
 // Global tables
-MarketEntry  marketTable[TABLE_SIZE];
-HoldingEntry holdingTable[TABLE_SIZE];
-TransactionEntry transactionHistory[MAX_TRANSACTIONS];
-int transactionCount = 0;
+// Market rows are stored densely as columns indexed by row id (row ids never
+// change), so scans read only the columns they use. marketIndex maps symbols
+// to rows and grows by doubling once the load factor is exceeded.
+char (*marketSymbols)[MAX_SYMBOL_LEN] = NULL;
+double *marketPrices = NULL;
+int *marketSectorIds = NULL;          // ids in the sector dictionary
+unsigned char *marketStatus = NULL;   // EntryStatus per row
+_Atomic unsigned int *marketRowSeq = NULL;   // per row seqlock (see CONCURRENT MARKET READS)
+SymbolKey *marketKeys = NULL;         // per row symbol key (writer only)
+int marketCount = 0;
+int marketRowCapacity = 0;
+MarketSlot *marketIndex = NULL;
+unsigned int marketIndexCapacity = 0;
+_Atomic unsigned int marketStructSeq = 0;    // seqlock over marketIndex changes
+
+// Symbol prefix index: every market row id, sorted by symbol, so a prefix maps
+// to one contiguous range found by binary search.
+int *marketSymbolOrder = NULL;
+int marketSymbolOrderCapacity = 0;
+
+// Price index: market rows ordered by price for range, top-N and count
+// queries in O(log n). Secondary indexes are not maintained during bulk
+// loads (marketIndexesDeferred) and are rebuilt once at the end.
+OrderIndex marketPriceIndex = { NULL, NULL, NULL, NULL, -1, 0 };
+int marketIndexesDeferred = 0;
+
+// Set when the market text file was only read up to a malformed line;
+// saveMarketToFile then leaves the file alone instead of truncating it.
+int marketLoadIncomplete = 0;
+
+// Sector dictionary: interned names, a hash lookup from name to id, and per
+// sector the market rows in it (see SECTOR DICTIONARY). Each account keeps
+// its own per-sector holding lists.
+char (*sectorNames)[MAX_SECTOR_LEN] = NULL;
+int sectorNameCount = 0;
+int sectorNameCapacity = 0;
+int *sectorLookup = NULL;
+int sectorLookupCapacity = 0;
+SectorMembers *marketSectorMembers = NULL;
+int *marketSectorPos = NULL;          // per market row: position in its list
+
+// Long symbol table: symbols that do not pack into a SymbolKey, by id, with
+// an open-addressing lookup from the uppercased name (see SYMBOL KEYS)
+char (*longSymbols)[MAX_SYMBOL_LEN] = NULL;
+int longSymbolCount = 0;
+int longSymbolCapacity = 0;
+LongSymbolLookup *longSymbolLookup = NULL;
+
+#ifdef TABLE_STATS
+// Probe counts of writer-side lookups since startup (lock-free readers are
+// not counted)
+ProbeStats marketLookupStats;
+ProbeStats holdingLookupStats;
+#define COUNT_PROBES(stats, probes, hit) recordProbes(&(stats), (probes), (hit))
+#else
+#define COUNT_PROBES(stats, probes, hit) ((void)0)
+#endif
+
+// Per market row, the account holdings priced against it, so a price change
+// revalues exactly those holdings (see PORTFOLIO AGGREGATES)
+MarketHolders *marketHolders = NULL;
+
+// Priced holdings of every account ordered by profit, by id
+// account * TABLE_SIZE + slot; kept with each account's profitIndex
+OrderIndex bookLeaderboard = { NULL, NULL, NULL, NULL, -1, 0 };
+
+// Accounts, looked up by name through an open-addressing table of ids.
+// activeAccount is the one the menu and batch orders trade on.
+Account **accounts = NULL;
+int accountCount = 0;
+int accountCapacity = 0;
+int *accountLookup = NULL;
+int accountLookupCapacity = 0;
+Account *activeAccount = NULL;
+int openJournalCount = 0;
+unsigned long long journalClock = 0;  // counts journal writes, for makeRoomForJournal
+int poolThreads = 0;                  // --threads; 0 = one per online CPU
+
+int simdKernelsEnabled = 1;           // cleared by --no-simd
+
+// In-memory transaction history per account (see Account)
+int historyWindow = 0;              // 0 = keep full history in memory
+
+// Binary snapshots are on by default; --no-snapshots forces text import.
+int useSnapshots = 1;
+
+// Lot relief of sells that do not name one (--cost-basis)
+int defaultRelief = RELIEF_AVERAGE;
+
+// Transaction journal: each account's trades are appended to its transaction
+// file as they happen. journalGroupCommit = N fsyncs once every N records
+// (0 = never fsync). In deferred mode (batch runs) records are only buffered
+// until the next syncTransactionJournal() checkpoint.
+int journalGroupCommit = 1;
+int journalDeferred = 0;
 
 // ---------- Utility Prototypes ----------
 void clearInputBuffer();
 void toUpperStr(char *s);
 int equalsIgnoreCase(const char *a, const char *b);
 int startsWithIgnoreCase(const char *text, const char *prefix);
-void getCurrentDateTime(char *buffer);
+int isValidPrice(double price);
+Timestamp currentTimestamp();
+int parseTimestamp(const char *text, Timestamp *out, Timestamp *span);
+int formatTimestamp(Timestamp t, char *out);
 
 // Hash & common
 unsigned int hash(const char *symbol);
 
+// Symbol keys
+SymbolKey symbolKey(const char *symbol);
+SymbolKey internSymbolKey(const char *symbol);
+
+// Sector dictionary
+int findSectorId(const char *name);
+int internSector(const char *name);
+const char *sectorName(int id);
+void rebuildMarketSectorMembers();
+void rebuildHoldingSectorMembers(Account *acct);
+
 // Market functions
 void initMarketTable();
 int findMarketSlot(const char *symbol, int *found);
+int findMarketRowByKey(SymbolKey key);
+int upsertMarketStock(const char *symbol, const char *sector, double price, int *found);
+void setMarketPrice(int row, double price);
+void rebuildSymbolIndex();
+void rebuildPriceIndex();
+void rebuildMarketIndexes(int withSymbolOrder);
+int searchMarketByPrefix(const char *prefix, int offset, int limit, int *rowsOut);
 int searchMarketStockExact(const char *symbolRaw, double *priceOut, char *sectorOut);
+int marketReadBegin();
+void marketReadEnd(int phase);
+int marketVisibleCount();
+int lookupMarketRow(const char *symbol);
+int readMarketQuote(int row, MarketQuote *out);
+double loadMarketPrice(int row);
 void searchMarketStocksInteractive();
 void filterMarketByPriceInteractive();
+int countMarketInPriceRange(double lo, double hi);
 void filterMarketBySectorInteractive();
 void displayAllMarketStocksInteractive();
 int insertMarketStockInteractive();  // NEW: Add market stock
 int saveMarketToFile(const char *filename);
+static int saveMarketSnapshot(const char *textFile);
 int loadMarketFromFile(const char *filename);
 void showMarketStatistics();
 
+// Accounts
+Account *findAccount(const char *name);
+Account *openAccount(const char *name);
+int activateAccount(Account *acct);
+int ensureAccountDirectory(const Account *acct);
+int loadAllAccounts();
+void saveDirtyAccounts();
+void closeAllAccounts();
+void switchAccountInteractive();
+void revalueAllAccounts(BookTotals *book);
+void showBookSummary();
+
 // Holding (user) functions
-void initHoldingTable();
-int findHoldingSlot(const char *symbol, int *found);
+void initHoldingTable(Account *acct);
+int findHoldingSlot(Account *acct, const char *symbol, int *found);
+int findHoldingSlotByKey(Account *acct, SymbolKey key, int *found);
+int executeBuy(Account *acct, const char *symbol, const char *sector, int qty, double buyPrice,
+               Timestamp time, int *found);
+int executeSell(Account *acct, const char *symbol, int qty, double price, Timestamp time, int relief);
 int buyStockInteractive();
 int sellStockInteractive();
 void displayUserPortfolioInteractive();
-int saveHoldingsToFile(const char *filename);
-int loadHoldingsFromFile(const char *filename);
+int saveHoldingsToFile(Account *acct);
+static int saveHoldingsSnapshot(Account *acct);
+int loadHoldingsFromFile(Account *acct);
+int openHoldingJournal(Account *acct);
+void recordHoldingChange(Account *acct, int slot);
+void syncHoldingJournal(Account *acct);
+void closeHoldingJournal(Account *acct);
+void finishHoldingsCheckpoint(Account *acct);
 void showPortfolioStatistics();
+void showTableHealth();
+
+// Portfolio aggregates
+void refreshHoldingAggregate(Account *acct, int slot);
+void marketPriceChanged(int row, int isNew);
+void rebuildAccountAggregates(Account *acct);
+void rebuildPortfolioAggregates();
+int bestHoldingSlot(Account *acct);
+int worstHoldingSlot(Account *acct);
+void showLeaderboard(int k);
+void showLeaderboardInteractive();
+
+// Valuation kernels
+void computePriceStats(const double *price, int n, PriceStats *out);
+void valueBook(const int *qty, const double *avg, const double *price,
+               int n, double *pnl, BookTotals *out);
 
 // Transaction functions
-void addTransaction(const char *symbol, int quantity, double price, const char *date, int type);
-void saveTransactionsToFile(const char *filename);
-void loadTransactionsFromFile(const char *filename);
+void initTransactionHistory(Account *acct);
+TransactionEntry *getTransaction(Account *acct, int index);
+void addTransaction(Account *acct, const char *symbol, int quantity, double price, Timestamp time, int type, int relief);
+int saveTransactionsToFile(Account *acct, const char *filename);
+int openTransactionJournal(Account *acct);
+void appendTransactionToJournal(Account *acct, const char *symbol, int quantity, double price, Timestamp time, int type, int relief);
+void syncTransactionJournal(Account *acct);
+void closeTransactionJournal(Account *acct);
+int compactTransactionJournal(Account *acct);
+void loadTransactionsFromFile(Account *acct);
 void viewTransactionHistory();
 
+// History index
+void resetHistoryIndex(HistoryIndex *hi);
+void indexTransactions(HistoryIndex *hi, const TransactionEntry *records, int n);
+int queryTransactionHistory(Account *acct, const HistoryQuery *q, int offset, int limit, int *recordsOut);
+int readTransactionRecords(Account *acct, const int *records, int n, TransactionEntry *out);
+void queryTransactionHistoryInteractive();
+
+// Tax lots
+int parseRelief(const char *text, int *out);
+void resetLotBook(LotBook *book);
+void applyLotRecords(LotBook *book, int first, const TransactionEntry *records, int n);
+void reconcileLots(Account *acct);
+void showTaxLots(Account *acct);
+int checkTaxLots(Account *acct);
+
+// Holdings rebuild
+int verifyHoldings(Account *acct, int rebuild);
+
+// Binary snapshots
+void snapshotPathFor(const char *textFile, char *out, size_t outSize);
+int saveTransactionSnapshot(Account *acct);
+
+// Batch mode
+int runBatchOrders(const char *filename, int checkpointEvery);
+
+// Price ticks
+int runPriceTicks(const char *filename, int follow);
+int generatePriceTicks(long count, long ratePerSec);
+
+// Benchmarks
+void benchmarkTextParsers();
+void benchmarkMarketLayout(int n);
+void benchmarkValuation(int n);
+void benchmarkBookRevaluation(int accountsWanted);
+void benchmarkConcurrentReads(int n);
+int generateDataSet(long rows, const char *dir);
+int runBenchmarkSuite(long rows);
+
 // Menus
 void userMenu();
 
@@ -133,13 +637,175 @@ int startsWithIgnoreCase(const char *text, const char *prefix) {
     return 1;
 }
 
-void getCurrentDateTime(char *buffer) {
-    time_t now = time(NULL);
-    struct tm *t = localtime(&now);
-    strftime(buffer, MAX_DATE_LEN, "%Y-%m-%d_%H:%M", t);
+// A price the market file can carry: finite, and not so small that its
+// saved "%.10f" text reads back as 0
+int isValidPrice(double price) {
+    return isfinite(price) && price >= 0.5e-10;
+}
+
+static double monotonicSeconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// ---------- Timestamps ----------
+// Dates are kept as 64-bit nanoseconds of local wall-clock time, the clock
+// the user reads, so the stored text needs no time zone to load or save.
+// Text is "YYYY-MM-DD_HH:MM", extended with ":SS" and ".nnnnnnnnn" only when
+// the time has them, so minute times keep the original format. Parsing and
+// formatting are plain arithmetic; nothing calls strftime or mktime.
+
+// Days from 1970-01-01 to a proleptic Gregorian date, and back
+static long long daysFromCivil(int year, int month, int day) {
+    year -= month <= 2;
+    long long era = (year >= 0 ? year : year - 399) / 400;
+    int yearOfEra = year - (int)(era * 400);
+    int dayOfYear = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    int dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+    return era * 146097 + dayOfEra - 719468;
+}
+
+static void civilFromDays(long long days, int *year, int *month, int *day) {
+    days += 719468;
+    long long era = (days >= 0 ? days : days - 146096) / 146097;
+    int dayOfEra = (int)(days - era * 146097);
+    int yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+    int dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+    int shifted = (5 * dayOfYear + 2) / 153;
+    *day = dayOfYear - (153 * shifted + 2) / 5 + 1;
+    *month = shifted < 10 ? shifted + 3 : shifted - 9;
+    *year = (int)(yearOfEra + era * 400) + (*month <= 2);
+}
+
+static int daysInMonth(int year, int month) {
+    static const unsigned char days[12] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+    int leap = year % 4 == 0 && (year % 100 != 0 || year % 400 == 0);
+    return month == 2 && leap ? 29 : days[month - 1];
+}
+
+static int readDigits(const char *p, int n, int *out) {
+    int value = 0;
+    for (int i = 0; i < n; i++) {
+        if (p[i] < '0' || p[i] > '9') return 0;
+        value = value * 10 + (p[i] - '0');
+    }
+    *out = value;
+    return 1;
+}
+
+static char *putDigits(char *p, long long value, int width) {
+    for (int i = width - 1; i >= 0; i--) {
+        p[i] = (char)('0' + value % 10);
+        value /= 10;
+    }
+    return p + width;
+}
+
+// Parses the len bytes at p as "YYYY-MM-DD", "YYYY-MM-DD_HH:MM",
+// "YYYY-MM-DD_HH:MM:SS" or that with 1-9 fraction digits. *span, if given,
+// is how much time the text covers: a day, a minute, a second or the unit
+// of its last digit. Years outside what 64-bit nanoseconds hold are refused.
+static int parseTimestampText(const char *p, size_t len, Timestamp *out, Timestamp *span) {
+    int year, month, day, hour = 0, minute = 0, second = 0;
+    long long nanos = 0;
+    Timestamp unit = NS_PER_DAY;
+    if (len < 10 || !readDigits(p, 4, &year) || p[4] != '-' || !readDigits(p + 5, 2, &month) ||
+        p[7] != '-' || !readDigits(p + 8, 2, &day))
+        return 0;
+    if (len > 10) {
+        if (len < 16 || p[10] != '_' || !readDigits(p + 11, 2, &hour) || p[13] != ':' ||
+            !readDigits(p + 14, 2, &minute))
+            return 0;
+        unit = NS_PER_MINUTE;
+    }
+    if (len > 16) {
+        if (len < 19 || p[16] != ':' || !readDigits(p + 17, 2, &second)) return 0;
+        unit = NS_PER_SECOND;
+    }
+    if (len > 19) {
+        if (p[19] != '.' || len < 21 || len > 29) return 0;
+        for (size_t i = 20; i < len; i++) {
+            if (p[i] < '0' || p[i] > '9') return 0;
+            nanos = nanos * 10 + (p[i] - '0');
+            unit /= 10;
+        }
+        nanos *= unit;
+    }
+    if (year < 1678 || year > 2261 || month < 1 || month > 12 || day < 1 || day > daysInMonth(year, month) ||
+        hour > 23 || minute > 59 || second > 59)
+        return 0;
+    *out = ((daysFromCivil(year, month, day) * 24 + hour) * 60 + minute) * NS_PER_MINUTE +
+           second * NS_PER_SECOND + nanos;
+    if (span) *span = unit;
+    return 1;
+}
+
+int parseTimestamp(const char *text, Timestamp *out, Timestamp *span) {
+    return parseTimestampText(text, strlen(text), out, span);
+}
+
+// Writes t to out (MAX_DATE_LEN bytes) and returns the length
+int formatTimestamp(Timestamp t, char *out) {
+    if (t == TIMESTAMP_NONE) {
+        strcpy(out, "-");
+        return 1;
+    }
+    long long days = t / NS_PER_DAY;
+    Timestamp rest = t % NS_PER_DAY;
+    if (rest < 0) {
+        rest += NS_PER_DAY;
+        days--;
+    }
+    int year, month, day;
+    civilFromDays(days, &year, &month, &day);
+    long long minutes = rest / NS_PER_MINUTE, nanos = rest % NS_PER_MINUTE;
+
+    char *p = putDigits(out, year, 4);
+    *p++ = '-';
+    p = putDigits(p, month, 2);
+    *p++ = '-';
+    p = putDigits(p, day, 2);
+    *p++ = '_';
+    p = putDigits(p, minutes / 60, 2);
+    *p++ = ':';
+    p = putDigits(p, minutes % 60, 2);
+    if (nanos) {
+        *p++ = ':';
+        p = putDigits(p, nanos / NS_PER_SECOND, 2);
+        if (nanos % NS_PER_SECOND) {
+            *p++ = '.';
+            p = putDigits(p, nanos % NS_PER_SECOND, 9);
+        }
+    }
+    *p = '\0';
+    return (int)(p - out);
+}
+
+// The UTC offset changes only on quarter-hour boundaries, so localtime_r runs
+// once per quarter hour rather than on every trade
+static long long localOffsetNs;
+static long long localOffsetFrom = 1, localOffsetUntil = 0;   // UTC ns range it holds for
+
+Timestamp currentTimestamp() {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    long long utc = (long long)ts.tv_sec * NS_PER_SECOND + ts.tv_nsec;
+    if (utc < localOffsetFrom || utc >= localOffsetUntil) {
+        time_t now = ts.tv_sec;
+        struct tm local;
+        localtime_r(&now, &local);
+        long long wallSeconds = ((daysFromCivil(local.tm_year + 1900, local.tm_mon + 1, local.tm_mday) * 24 +
+                                  local.tm_hour) * 60 + local.tm_min) * 60 + local.tm_sec;
+        localOffsetNs = (wallSeconds - (long long)now) * NS_PER_SECOND;
+        localOffsetFrom = utc - utc % (15 * NS_PER_MINUTE);
+        localOffsetUntil = localOffsetFrom + 15 * NS_PER_MINUTE;
+    }
+    return utc + localOffsetNs;
 }
 
 // ---------- Hash ----------
+// Returns the full 32-bit hash; callers reduce it to their table size.
 unsigned int hash(const char *symbol) {
     unsigned long hashValue = 0;
     const unsigned int p = 31;
@@ -147,967 +813,6879 @@ unsigned int hash(const char *symbol) {
     for (int i = 0; symbol[i] != '\0'; i++) {
         hashValue = hashValue * p + (unsigned char)symbol[i];
     }
-    return (unsigned int)(hashValue % TABLE_SIZE);
+    // Final avalanche so the low bits are usable with a power-of-two mask
+    unsigned int h = (unsigned int)(hashValue ^ (hashValue >> 32));
+    h ^= h >> 16;
+    h *= 0x85ebca6bU;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35U;
+    h ^= h >> 16;
+    return h;
 }
 
-// ================= MARKET TABLE =================
+// Probe length histogram bucket: 1, 2, 3, 4, 5-8, 9-16, 17-32, 33+
+static int probeBucket(unsigned long long probes) {
+    if (probes <= 4) return probes ? (int)probes - 1 : 0;
+    int bucket = 4;
+    for (unsigned long long limit = 8; probes > limit && bucket < PROBE_HISTOGRAM_BUCKETS - 1; limit *= 2)
+        bucket++;
+    return bucket;
+}
 
-void initMarketTable() 
-{
-    for (int i = 0; i < TABLE_SIZE; i++) {
-        marketTable[i].status = EMPTY;
-        marketTable[i].symbol[0] = '\0';
-        marketTable[i].sector[0] = '\0';
-        marketTable[i].price = 0.0;
-    }
+static void recordProbes(ProbeStats *stats, unsigned long long probes, int hit) {
+    stats->lookups++;
+    stats->hits += hit != 0;
+    stats->probes += probes;
+    if (probes > stats->maxProbe) stats->maxProbe = probes;
+    stats->histogram[probeBucket(probes)]++;
 }
 
-int findMarketSlot(const char *symbol, int *found) 
-{
-    unsigned int index = hash(symbol);
-    int firstDeletedIndex = -1;
+// Hash of a SymbolKey (see SYMBOL KEYS): multiplicative, and after the fold
+// the high half of the product depends on every byte of the key
+static inline unsigned int symbolKeyHash(SymbolKey key) {
+    key ^= key >> 32;
+    return (unsigned int)((key * 0x9e3779b97f4a7c15ULL) >> 32);
+}
 
-    if (found) *found = 0;
+// ================= BINARY SNAPSHOTS =================
 
-    for (int i = 0; i < TABLE_SIZE; i++) {
-        int current = (index + i) % TABLE_SIZE;
+// "market_data.txt" -> "market_data.bin"
+void snapshotPathFor(const char *textFile, char *out, size_t outSize) {
+    size_t len = strlen(textFile);
+    if (len > 4 && strcmp(textFile + len - 4, ".txt") == 0) len -= 4;
+    snprintf(out, outSize, "%.*s.bin", (int)len, textFile);
+}
+
+static int statTextFile(const char *textFile, long long *size, long long *mtimeNs, long long *inode) {
+    struct stat st;
+    if (stat(textFile, &st) != 0) return 0;
+    *size = (long long)st.st_size;
+    *mtimeNs = (long long)st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec;
+    *inode = (long long)st.st_ino;
+    return 1;
+}
 
-        if (marketTable[current].status == EMPTY) {
-            // Return first deleted slot if found, otherwise empty slot
-            if (firstDeletedIndex != -1) {
-                // Reuse deleted slot
-                return firstDeletedIndex;
+#define SNAPSHOT_CHECK_BYTES (64 * 1024)   // checksummed at each end of a journal prefix
+
+// FNV-1a over the first and last SNAPSHOT_CHECK_BYTES of the first size
+// bytes of textFile. Appends leave it alone; a journal that was replaced
+// has a new inode, and one edited in place almost always changes one of
+// the two ends (the last line at least, which every edit tool rewrites).
+static int prefixChecksum(const char *textFile, long long size, unsigned long long *sum) {
+    FILE *fp = fopen(textFile, "rb");
+    if (!fp) return 0;
+    unsigned long long h = 0xcbf29ce484222325ULL;
+    long long tailFrom = size - SNAPSHOT_CHECK_BYTES;
+    long long ranges[2][2] = {
+        { 0, size < SNAPSHOT_CHECK_BYTES ? size : SNAPSHOT_CHECK_BYTES },
+        { tailFrom > SNAPSHOT_CHECK_BYTES ? tailFrom : SNAPSHOT_CHECK_BYTES, size },
+    };
+    unsigned char buf[8192];
+    int ok = 1;
+    for (int r = 0; ok && r < 2; r++) {
+        long long left = ranges[r][1] - ranges[r][0];
+        if (left <= 0) continue;
+        ok = fseek(fp, (long)ranges[r][0], SEEK_SET) == 0;
+        while (ok && left > 0) {
+            size_t want = left < (long long)sizeof(buf) ? (size_t)left : sizeof(buf);
+            size_t got = fread(buf, 1, want, fp);
+            for (size_t i = 0; i < got; i++) {
+                h ^= buf[i];
+                h *= 0x100000001b3ULL;
             }
-            return current;
+            ok = got == want;
+            left -= got;
         }
+    }
+    fclose(fp);
+    *sum = h;
+    return ok;
+}
 
-        if (marketTable[current].status == DELETED) {
-            if (firstDeletedIndex == -1)
-                firstDeletedIndex = current;
-            // Continue probing to find existing entry
-        } else if (marketTable[current].status == OCCUPIED &&
-                   equalsIgnoreCase(marketTable[current].symbol, symbol)) {
-            if (found) *found = 1;
-            return current;
-        }
+// Opens a snapshot for writing at a temporary path; the header is written
+// by finishSnapshot once the record count is known.
+static FILE *beginSnapshot(const char *tmpPath) {
+    FILE *fp = fopen(tmpPath, "wb");
+    if (!fp) {
+        perror("Error opening snapshot for saving");
+        return NULL;
     }
-    // Table is full, return first deleted slot or -1
-    return (firstDeletedIndex != -1) ? firstDeletedIndex : -1;
+    SnapshotHeader blank;
+    memset(&blank, 0, sizeof(blank));
+    fwrite(&blank, sizeof(blank), 1, fp);
+    return fp;
 }
 
-int searchMarketStockExact(const char *symbolRaw, double *priceOut, char *sectorOut) {
-    char symbol[MAX_SYMBOL_LEN];
-    strncpy(symbol, symbolRaw, MAX_SYMBOL_LEN - 1);
-    symbol[MAX_SYMBOL_LEN - 1] = '\0';
-    toUpperStr(symbol);
+// Writes the header, stamps it with the text file's current size, mtime and
+// inode (and, for a journal, its prefix checksum) and atomically renames the
+// snapshot into place.
+static int finishSnapshot(FILE *fp, const char *tmpPath, const char *path,
+                          unsigned int kind, unsigned int recordSize,
+                          long long count, long long extra, const char *textFile) {
+    SnapshotHeader h;
+    memset(&h, 0, sizeof(h));
+    h.magic = SNAPSHOT_MAGIC;
+    h.version = SNAPSHOT_VERSION;
+    h.kind = kind;
+    h.recordSize = recordSize;
+    h.count = count;
+    h.extra = extra;
+    statTextFile(textFile, &h.sourceSize, &h.sourceMtimeNs, &h.sourceInode);
+    if (kind == SNAPSHOT_TRANSACTIONS) prefixChecksum(textFile, h.sourceSize, &h.sourceChecksum);
+
+    int ok = fseek(fp, 0, SEEK_SET) == 0 && fwrite(&h, sizeof(h), 1, fp) == 1;
+    if (fclose(fp) != 0) ok = 0;
+    if (ok && rename(tmpPath, path) != 0) ok = 0;
+    if (!ok) {
+        perror("Error writing snapshot");
+        remove(tmpPath);
+    }
+    return ok;
+}
 
-    unsigned int index = hash(symbol);
+// Maps a snapshot read-only and validates its header. Returns the mapping
+// (header first, records after) or NULL; *mapSize receives the length.
+static const SnapshotHeader *mapSnapshot(const char *path, unsigned int kind,
+                                         unsigned int recordSize, size_t *mapSize) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return NULL;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(SnapshotHeader)) {
+        close(fd);
+        return NULL;
+    }
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return NULL;
+
+    const SnapshotHeader *h = map;
+    if (h->magic != SNAPSHOT_MAGIC || h->version != SNAPSHOT_VERSION ||
+        h->kind != kind || h->recordSize != recordSize || h->count < 0 ||
+        (size_t)st.st_size < sizeof(SnapshotHeader) + (size_t)h->count * recordSize) {
+        munmap(map, st.st_size);
+        return NULL;
+    }
+    *mapSize = st.st_size;
+    return h;
+}
 
-    for (int i = 0; i < TABLE_SIZE; i++) {
-        int current = (index + i) % TABLE_SIZE;
+// A snapshot of a whole-file save is only usable while the text file is
+// byte-for-byte the one it was taken with (same size and mtime).
+static int snapshotMatchesText(const SnapshotHeader *h, const char *textFile) {
+    long long size, mtimeNs, inode;
+    if (!statTextFile(textFile, &size, &mtimeNs, &inode)) return 0;
+    return h->sourceSize == size && h->sourceMtimeNs == mtimeNs && h->sourceInode == inode;
+}
 
-        if (marketTable[current].status == EMPTY)
-            return 0;
+// ================= FAST TEXT LOADER =================
+// Replaces the fscanf loops for the text formats. The file is mapped in one
+// piece, split into line-aligned ranges that are parsed on separate threads,
+// and the parsed rows are merged back in file order. Numbers are parsed by
+// hand (no locale-aware stdio); like the fscanf loops, parsing stops at the
+// first malformed record.
 
-        if (marketTable[current].status == OCCUPIED &&
-            equalsIgnoreCase(marketTable[current].symbol, symbol)) {
-            if (priceOut) *priceOut = marketTable[current].price;
-            if (sectorOut) strcpy(sectorOut, marketTable[current].sector);
-            return 1;
+#define PARSE_MIN_CHUNK_BYTES (1 << 20)   // Don't spawn a thread for less
+#define PARSE_MAX_THREADS     64
+
+typedef int (*LineParser)(const char *line, const char *end, void *row);
+
+typedef struct {
+    const char *begin, *end;    // whole lines only
+    LineParser parseLine;
+    size_t rowSize;
+    char *rows;
+    size_t count, capacity;
+    int failed;                 // stopped early at a malformed line
+    const char *stopAt;         // start of that line
+} ParseChunk;
+
+// Finds the next '\n' in [p, end), or end. SSE2 compares 16 bytes at a time.
+static const char *findNewline(const char *p, const char *end) {
+#ifdef __SSE2__
+    const __m128i nl = _mm_set1_epi8('\n');
+    while (end - p >= 16) {
+        __m128i block = _mm_loadu_si128((const __m128i *)p);
+        int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(block, nl));
+        if (mask) return p + __builtin_ctz(mask);
+        p += 16;
+    }
+#endif
+    const char *hit = memchr(p, '\n', end - p);
+    return hit ? hit : end;
+}
+
+static int isFieldSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+static const char *skipFieldSpace(const char *p, const char *end) {
+    while (p < end && isFieldSpace(*p)) p++;
+    return p;
+}
+
+// Copies one whitespace-delimited token; fails if it does not fit in size-1
+static const char *parseTokenField(const char *p, const char *end, char *out, size_t size) {
+    p = skipFieldSpace(p, end);
+    const char *start = p;
+    while (p < end && !isFieldSpace(*p)) p++;
+    size_t len = p - start;
+    if (len == 0 || len >= size) return NULL;
+    memcpy(out, start, len);
+    out[len] = '\0';
+    return p;
+}
+
+// A date that does not parse loads as TIMESTAMP_NONE instead of ending the
+// file at that line
+static const char *parseTimestampField(const char *p, const char *end, Timestamp *out) {
+    p = skipFieldSpace(p, end);
+    const char *start = p;
+    while (p < end && !isFieldSpace(*p)) p++;
+    if (p == start || p - start >= MAX_DATE_LEN) return NULL;
+    if (!parseTimestampText(start, p - start, out, NULL)) *out = TIMESTAMP_NONE;
+    return p;
+}
+
+static const char *parseIntField(const char *p, const char *end, int *out) {
+    p = skipFieldSpace(p, end);
+    int neg = 0;
+    if (p < end && (*p == '-' || *p == '+')) neg = (*p++ == '-');
+    long long value = 0;
+    const char *digits = p;
+    while (p < end && *p >= '0' && *p <= '9' && value <= 0x7fffffff) {
+        value = value * 10 + (*p++ - '0');
+    }
+    if (p == digits || value > 0x7fffffff || (p < end && !isFieldSpace(*p))) return NULL;
+    *out = (int)(neg ? -value : value);
+    return p;
+}
+
+// strtod over a bounded copy of [start, stop): mapped text has no NUL.
+// Wide enough for any double printed with %.10f.
+static int parseDoubleCopy(const char *start, const char *stop, double *out) {
+    char buf[400];
+    size_t len = stop - start;
+    if (len >= sizeof(buf)) return 0;
+    memcpy(buf, start, len);
+    buf[len] = '\0';
+    char *tail;
+    *out = strtod(buf, &tail);
+    return *tail == '\0';
+}
+
+// Accepts decimal text with an optional exponent, plus the inf/nan spellings
+// printf gives for non-finite values, so every price saveMarketToFile writes
+// reads back. Hex floats are rejected; the program never calls setlocale, so
+// strtod's decimal point is always '.'.
+// Fast path: with at most 19 significant digits below 2^53 and at most 22
+// fraction digits, mantissa / 10^frac is correctly rounded, i.e. the same
+// double strtod would give. Longer numbers and exponents go to strtod.
+static const char *parseDoubleField(const char *p, const char *end, double *out) {
+    static const double pow10[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+    p = skipFieldSpace(p, end);
+    const char *start = p;
+    int neg = 0;
+    if (p < end && (*p == '-' || *p == '+')) neg = (*p++ == '-');
+
+    if (end - p >= 3 && (p + 3 == end || isFieldSpace(p[3]))) {
+        if (strncasecmp(p, "inf", 3) == 0) {
+            *out = neg ? -INFINITY : INFINITY;
+            return p + 3;
+        }
+        if (strncasecmp(p, "nan", 3) == 0) {
+            *out = neg ? -NAN : NAN;
+            return p + 3;
         }
     }
-    return 0;
+
+    unsigned long long mantissa = 0;
+    int digits = 0, fracDigits = 0, sawDigit = 0;
+    while (p < end && *p >= '0' && *p <= '9') {
+        mantissa = mantissa * 10 + (*p++ - '0');
+        if (mantissa) digits++;
+        sawDigit = 1;
+    }
+    if (p < end && *p == '.') {
+        p++;
+        while (p < end && *p >= '0' && *p <= '9') {
+            mantissa = mantissa * 10 + (*p++ - '0');
+            if (mantissa) digits++;
+            fracDigits++;
+            sawDigit = 1;
+        }
+    }
+    if (!sawDigit) return NULL;
+
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        const char *q = p + 1;
+        if (q < end && (*q == '-' || *q == '+')) q++;
+        const char *expDigits = q;
+        while (q < end && *q >= '0' && *q <= '9') q++;
+        if (q == expDigits || (q < end && !isFieldSpace(*q))) return NULL;
+        return parseDoubleCopy(start, q, out) ? q : NULL;
+    }
+    if (p < end && !isFieldSpace(*p)) return NULL;
+    if (digits > 19 || fracDigits > 22 || mantissa > (1ULL << 53)) {
+        return parseDoubleCopy(start, p, out) ? p : NULL;
+    }
+    double value = (double)mantissa / pow10[fracDigits];
+    *out = neg ? -value : value;
+    return p;
 }
 
-//Insert market stock
-int insertMarketStockInteractive() {
+static int atLineEnd(const char *p, const char *end) {
+    return p && skipFieldSpace(p, end) == end;
+}
+
+// Parsed text rows keep the sector name; it is interned when the rows are
+// inserted, since the dictionary is not shared between parser threads.
+typedef struct {
     char symbol[MAX_SYMBOL_LEN];
     char sector[MAX_SECTOR_LEN];
     double price;
-    
-    printf("Enter stock symbol: ");
-    if (scanf("%15s", symbol) != 1) {
-        printf("Invalid input.\n");
-        clearInputBuffer();
-        return 0;
+} MarketTextRow;
+
+typedef struct {
+    char symbol[MAX_SYMBOL_LEN];
+    char sector[MAX_SECTOR_LEN];
+    int  quantity;
+    double avgBuyPrice;
+    Timestamp lastBuyTime;
+} HoldingTextRow;
+
+// "%15s %19s %lf" -> MarketTextRow (symbol and sector uppercased)
+static int parseMarketLine(const char *p, const char *end, void *row) {
+    MarketTextRow *m = row;
+    p = parseTokenField(p, end, m->symbol, MAX_SYMBOL_LEN);
+    if (p) p = parseTokenField(p, end, m->sector, MAX_SECTOR_LEN);
+    if (p) p = parseDoubleField(p, end, &m->price);
+    if (!atLineEnd(p, end)) return 0;
+    toUpperStr(m->symbol);
+    toUpperStr(m->sector);
+    return 1;
+}
+
+// "%15s %19s %d %lf %31s" -> HoldingTextRow (symbol uppercased)
+static int parseHoldingLine(const char *p, const char *end, void *row) {
+    HoldingTextRow *h = row;
+    p = parseTokenField(p, end, h->symbol, MAX_SYMBOL_LEN);
+    if (p) p = parseTokenField(p, end, h->sector, MAX_SECTOR_LEN);
+    if (p) p = parseIntField(p, end, &h->quantity);
+    if (p) p = parseDoubleField(p, end, &h->avgBuyPrice);
+    if (p) p = parseTimestampField(p, end, &h->lastBuyTime);
+    if (!atLineEnd(p, end)) return 0;
+    toUpperStr(h->symbol);
+    return 1;
+}
+
+// "%15s %d %lf %31s %d [relief]" -> TransactionEntry
+static int parseTransactionLine(const char *p, const char *end, void *row) {
+    TransactionEntry *t = row;
+    p = parseTokenField(p, end, t->symbol, MAX_SYMBOL_LEN);
+    if (p) p = parseIntField(p, end, &t->quantity);
+    if (p) p = parseDoubleField(p, end, &t->pricePerShare);
+    if (p) p = parseTimestampField(p, end, &t->time);
+    if (p) p = parseIntField(p, end, &t->type);
+    t->relief = RELIEF_AVERAGE;   // sells journaled before lots, and every buy
+    if (p && skipFieldSpace(p, end) != end) {
+        char relief[16];
+        p = parseTokenField(p, end, relief, sizeof(relief));
+        if (p && !parseRelief(relief, &t->relief)) p = NULL;
     }
-    clearInputBuffer();
-    
-    
-    toUpperStr(symbol);
-    
-    // Check if already exists
-    double existingPrice;
-    char existingSector[MAX_SECTOR_LEN];
-    if (searchMarketStockExact(symbol, &existingPrice, existingSector)) {
-        printf("Stock %s already exists. Update price and sector? (y/n): ", symbol);
-        char choice;
-        scanf("%c", &choice);
-        clearInputBuffer();
-        
-        if (choice != 'y' && choice != 'Y') {
-            return 0;
+    return atLineEnd(p, end);
+}
+
+static void *parseChunkWorker(void *arg) {
+    ParseChunk *c = arg;
+    const char *p = c->begin;
+
+    // Size the row array once: a newline count is far cheaper than regrowing
+    size_t lines = 1;
+    for (const char *q = p; (q = findNewline(q, c->end)) < c->end; q++) lines++;
+    c->rows = malloc(lines * c->rowSize);
+    c->capacity = c->rows ? lines : 0;
+
+    while (p < c->end) {
+        const char *nl = findNewline(p, c->end);
+        if (skipFieldSpace(p, nl) != nl) {   // blank lines are skipped, as by fscanf
+            if (c->count == c->capacity) {
+                size_t newCapacity = c->capacity ? c->capacity * 2 : 1024;
+                char *rows = realloc(c->rows, newCapacity * c->rowSize);
+                if (!rows) {
+                    c->failed = 1;
+                    c->stopAt = p;
+                    break;
+                }
+                c->rows = rows;
+                c->capacity = newCapacity;
+            }
+            if (!c->parseLine(p, nl, c->rows + c->count * c->rowSize)) {
+                c->failed = 1;
+                c->stopAt = p;
+                break;
+            }
+            c->count++;
         }
+        p = nl + 1;
     }
-    
-    printf("Enter sector: ");
-    fgets(sector, MAX_SECTOR_LEN, stdin);
-    toUpperStr(sector);
-    sector[strcspn(sector, "\n")] = '\0';  
-    
-    printf("Enter current price: ");
-    if (scanf("%lf", &price) != 1 || price <= 0) {
-        printf("Invalid price.\n");
-        clearInputBuffer();
+    return NULL;
+}
+
+static int parseThreadCount() {
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    if (n < 1) n = 1;
+    if (n > PARSE_MAX_THREADS) n = PARSE_MAX_THREADS;
+    return (int)n;
+}
+
+// Parses filename from byte offset on into a contiguous array of rows (in
+// file order, up to the first malformed line). Returns 1 on success; *rowsOut
+// must be freed by the caller. Returns 0 if the file cannot be read. If
+// stopLineOut is given it receives the 1-based file line parsing stopped
+// at, or 0 if every line was parsed.
+static int parseTextFileParallel(const char *filename, long offset, LineParser parseLine,
+                                 size_t rowSize, void **rowsOut, size_t *countOut,
+                                 long *stopLineOut) {
+    *rowsOut = NULL;
+    *countOut = 0;
+    if (stopLineOut) *stopLineOut = 0;
+
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) return 0;
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
         return 0;
     }
-    clearInputBuffer();
-    
-    // Find slot and insert/update
-    int found = 0;
-    int slot = findMarketSlot(symbol, &found);
-    if (slot == -1) {
-        printf("Error: Market table is full.\n");
+    if (offset < 0 || st.st_size <= offset) {
+        close(fd);
+        return 1;
+    }
+
+    size_t size = st.st_size;
+    char *map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return 0;
+    madvise(map, size, MADV_SEQUENTIAL);
+
+    const char *begin = map + offset, *end = map + size;
+    int threads = parseThreadCount();
+    size_t perThread = (end - begin) / threads;
+    if (perThread < PARSE_MIN_CHUNK_BYTES) {
+        threads = (int)((end - begin) / PARSE_MIN_CHUNK_BYTES) + 1;
+        if (threads > parseThreadCount()) threads = parseThreadCount();
+        perThread = (end - begin) / threads;
+    }
+
+    // Split into line-aligned ranges
+    ParseChunk chunks[PARSE_MAX_THREADS];
+    const char *p = begin;
+    for (int i = 0; i < threads; i++) {
+        const char *stop = (i == threads - 1) ? end : p + perThread;
+        if (stop < p) stop = p;
+        if (stop > end) stop = end;
+        if (stop < end) stop = findNewline(stop, end);
+        if (stop < end) stop++;
+        memset(&chunks[i], 0, sizeof(chunks[i]));
+        chunks[i].begin = p;
+        chunks[i].end = stop;
+        chunks[i].parseLine = parseLine;
+        chunks[i].rowSize = rowSize;
+        p = stop;
+    }
+
+    pthread_t tids[PARSE_MAX_THREADS];
+    int started[PARSE_MAX_THREADS] = {0};
+    for (int i = 1; i < threads; i++) {
+        started[i] = pthread_create(&tids[i], NULL, parseChunkWorker, &chunks[i]) == 0;
+    }
+    parseChunkWorker(&chunks[0]);
+    for (int i = 1; i < threads; i++) {
+        if (started[i]) pthread_join(tids[i], NULL);
+        else parseChunkWorker(&chunks[i]);
+    }
+
+    // Merge in file order, stopping after the first chunk that failed
+    size_t total = 0;
+    int usable = 0;
+    while (usable < threads) {
+        total += chunks[usable].count;
+        if (chunks[usable++].failed) break;
+    }
+    char *rows;
+    int copy = 1;
+    if (usable == 1 && chunks[0].rows) {
+        // Single range: hand its array over without copying
+        rows = chunks[0].rows;
+        chunks[0].rows = NULL;
+        copy = 0;
+    } else {
+        rows = malloc(total ? total * rowSize : 1);
+    }
+    int ok = rows != NULL;
+    if (ok) {
+        size_t at = 0;
+        for (int i = 0; copy && i < usable; i++) {
+            memcpy(rows + at * rowSize, chunks[i].rows, chunks[i].count * rowSize);
+            at += chunks[i].count;
+        }
+        *rowsOut = rows;
+        *countOut = total;
+    }
+    if (stopLineOut && chunks[usable - 1].failed) {
+        const char *stop = chunks[usable - 1].stopAt;
+        long line = 1;
+        for (const char *q = map; (q = findNewline(q, stop)) < stop; q++) line++;
+        *stopLineOut = line;
+    }
+    for (int i = 0; i < threads; i++) free(chunks[i].rows);
+    munmap(map, size);
+    return ok;
+}
+
+// ================= ORDERED INDEX =================
+// Treap over dense ids ordered by (key, id), with subtree sizes for rank and
+// select. Nodes live in parallel arrays indexed by id, so an entry is
+// re-keyed in place (remove + insert) without allocating.
+
+static int orderIndexReserve(OrderIndex *oi, int capacity) {
+    if (capacity <= oi->capacity) return 1;
+    int newCapacity = oi->capacity ? oi->capacity : 64;
+    while (newCapacity < capacity) newCapacity *= 2;
+
+    double *key = realloc(oi->key, sizeof(double) * newCapacity);
+    if (key) oi->key = key;
+    int *left = realloc(oi->left, sizeof(int) * newCapacity);
+    if (left) oi->left = left;
+    int *right = realloc(oi->right, sizeof(int) * newCapacity);
+    if (right) oi->right = right;
+    int *size = realloc(oi->size, sizeof(int) * newCapacity);
+    if (size) oi->size = size;
+    if (!key || !left || !right || !size) {
+        perror("Error growing ordered index");
         return 0;
     }
-    
-    strcpy(marketTable[slot].symbol, symbol);
-    strcpy(marketTable[slot].sector, sector);
-    marketTable[slot].price = price;
-    marketTable[slot].status = OCCUPIED;
-    
-    printf("Stock %s %s at price %.2f\n", 
-           found ? "updated" : "added", symbol, price);
-    saveMarketToFile(MARKET_FILE);       
+    for (int i = oi->capacity; i < newCapacity; i++) oi->size[i] = 0;
+    oi->capacity = newCapacity;
     return 1;
 }
 
-void searchMarketStocksInteractive() {
-    int choice;
-    char input[MAX_SYMBOL_LEN];
-    
-    printf("\n----- Search Options -----\n");
-    printf("1. Exact symbol match\n");
-    printf("2. Prefix search (starts with)\n");
-    printf("Enter choice: ");
-    
-    if (scanf("%d", &choice) != 1) {
-        printf("Invalid input.\n");
-        clearInputBuffer();
+// Deterministic pseudo-random heap priority per id
+static unsigned int orderPriority(int id) {
+    unsigned int h = (unsigned int)id * 0x9E3779B1U;
+    h ^= h >> 15;
+    h *= 0x85ebca6bU;
+    h ^= h >> 13;
+    return h;
+}
+
+static int orderLess(const OrderIndex *oi, int a, int b) {
+    return oi->key[a] < oi->key[b] || (oi->key[a] == oi->key[b] && a < b);
+}
+
+static int nodeSize(const OrderIndex *oi, int t) {
+    return t < 0 ? 0 : oi->size[t];
+}
+
+static void updateNodeSize(OrderIndex *oi, int t) {
+    oi->size[t] = 1 + nodeSize(oi, oi->left[t]) + nodeSize(oi, oi->right[t]);
+}
+
+static int treapMerge(OrderIndex *oi, int a, int b) {
+    if (a < 0) return b;
+    if (b < 0) return a;
+    if (orderPriority(a) > orderPriority(b)) {
+        oi->right[a] = treapMerge(oi, oi->right[a], b);
+        updateNodeSize(oi, a);
+        return a;
+    }
+    oi->left[b] = treapMerge(oi, a, oi->left[b]);
+    updateNodeSize(oi, b);
+    return b;
+}
+
+// Splits t into ids ordered before id (*l) and the rest (*r)
+static void treapSplit(OrderIndex *oi, int t, int id, int *l, int *r) {
+    if (t < 0) {
+        *l = *r = -1;
+        return;
+    }
+    if (orderLess(oi, t, id)) {
+        treapSplit(oi, oi->right[t], id, &oi->right[t], r);
+        *l = t;
+    } else {
+        treapSplit(oi, oi->left[t], id, l, &oi->left[t]);
+        *r = t;
+    }
+    updateNodeSize(oi, t);
+}
+
+static int treapInsert(OrderIndex *oi, int t, int id) {
+    if (t < 0) return id;
+    if (orderPriority(id) > orderPriority(t)) {
+        treapSplit(oi, t, id, &oi->left[id], &oi->right[id]);
+        updateNodeSize(oi, id);
+        return id;
+    }
+    if (orderLess(oi, id, t)) oi->left[t] = treapInsert(oi, oi->left[t], id);
+    else oi->right[t] = treapInsert(oi, oi->right[t], id);
+    updateNodeSize(oi, t);
+    return t;
+}
+
+static int treapRemove(OrderIndex *oi, int t, int id) {
+    if (t < 0) return -1;
+    if (t == id) return treapMerge(oi, oi->left[t], oi->right[t]);
+    if (orderLess(oi, id, t)) oi->left[t] = treapRemove(oi, oi->left[t], id);
+    else oi->right[t] = treapRemove(oi, oi->right[t], id);
+    updateNodeSize(oi, t);
+    return t;
+}
+
+static int orderIndexContains(const OrderIndex *oi, int id) {
+    return id < oi->capacity && oi->size[id] > 0;
+}
+
+static void orderIndexRemove(OrderIndex *oi, int id) {
+    if (!orderIndexContains(oi, id)) return;
+    oi->root = treapRemove(oi, oi->root, id);
+    oi->size[id] = 0;
+}
+
+// A NaN key (a hand-edited "nan" price) would make orderLess inconsistent,
+// so it is stored as +inf and orders last.
+static double orderKey(double key) {
+    return isnan(key) ? INFINITY : key;
+}
+
+// Inserts id with key, or re-keys it if already present; O(log n) expected
+static int orderIndexSet(OrderIndex *oi, int id, double key) {
+    key = orderKey(key);
+    if (orderIndexContains(oi, id)) {
+        if (oi->key[id] == key) return 1;
+        orderIndexRemove(oi, id);
+    }
+    if (!orderIndexReserve(oi, id + 1)) return 0;
+    oi->key[id] = key;
+    oi->left[id] = oi->right[id] = -1;
+    oi->size[id] = 1;
+    oi->root = treapInsert(oi, oi->root, id);
+    return 1;
+}
+
+// Rebuilds from ids[0..n) with keys in O(n log n): sort, then build the
+// Cartesian tree on priorities with a stack in one linear pass. The sort
+// carries each key with its id, so no comparator context is shared between
+// threads.
+typedef struct {
+    double key;
+    int id;
+} OrderBuildEntry;
+
+static int cmpOrderBuild(const void *a, const void *b) {
+    const OrderBuildEntry *x = a, *y = b;
+    if (x->key != y->key) return x->key < y->key ? -1 : 1;
+    return (x->id > y->id) - (x->id < y->id);
+}
+
+static int orderIndexBuild(OrderIndex *oi, int *ids, const double *keys, int n) {
+    int maxId = -1;
+    for (int i = 0; i < n; i++) if (ids[i] > maxId) maxId = ids[i];
+    if (!orderIndexReserve(oi, maxId + 1)) return 0;
+    for (int i = 0; i < oi->capacity; i++) oi->size[i] = 0;
+    oi->root = -1;
+    if (n == 0) return 1;
+
+    OrderBuildEntry *entries = malloc(sizeof(OrderBuildEntry) * n);
+    if (!entries) return 0;
+    for (int i = 0; i < n; i++) {
+        entries[i].key = oi->key[ids[i]] = orderKey(keys[i]);
+        entries[i].id = ids[i];
+    }
+    qsort(entries, n, sizeof(OrderBuildEntry), cmpOrderBuild);
+    for (int i = 0; i < n; i++) ids[i] = entries[i].id;
+    free(entries);
+
+    int *stack = malloc(sizeof(int) * n);
+    if (!stack) return 0;
+    // The stack holds the right spine; a node's subtree is final once it is
+    // popped, so sizes are filled in as nodes leave the stack.
+    int top = 0;
+    for (int i = 0; i < n; i++) {
+        int id = ids[i], last = -1;
+        oi->left[id] = oi->right[id] = -1;
+        while (top > 0 && orderPriority(stack[top - 1]) < orderPriority(id)) {
+            last = stack[--top];
+            updateNodeSize(oi, last);
+        }
+        oi->left[id] = last;
+        if (top > 0) oi->right[stack[top - 1]] = id;
+        stack[top++] = id;
+    }
+    oi->root = top > 0 ? stack[0] : -1;
+    while (top > 0) updateNodeSize(oi, stack[--top]);
+    free(stack);
+    return 1;
+}
+
+static int orderIndexCount(const OrderIndex *oi) {
+    return nodeSize(oi, oi->root);
+}
+
+// Number of entries with key < value (inclusive = 0) or key <= value (1)
+static int orderIndexRank(const OrderIndex *oi, double value, int inclusive) {
+    int rank = 0, t = oi->root;
+    while (t >= 0) {
+        int goRight = inclusive ? (oi->key[t] <= value) : (oi->key[t] < value);
+        if (goRight) {
+            rank += nodeSize(oi, oi->left[t]) + 1;
+            t = oi->right[t];
+        } else {
+            t = oi->left[t];
+        }
+    }
+    return rank;
+}
+
+// The id at 0-based position k in ascending order, or -1
+static int orderIndexSelect(const OrderIndex *oi, int k) {
+    int t = oi->root;
+    while (t >= 0) {
+        int leftSize = nodeSize(oi, oi->left[t]);
+        if (k < leftSize) {
+            t = oi->left[t];
+        } else if (k == leftSize) {
+            return t;
+        } else {
+            k -= leftSize + 1;
+            t = oi->right[t];
+        }
+    }
+    return -1;
+}
+
+// ---------- Top-K Selection ----------
+// Keeps the k best (key, id) pairs of a stream in a bounded heap whose root
+// is the worst of them, so a candidate that does not beat the root costs one
+// comparison and the whole stream O(n log k), without copying or sorting
+// it. Best is the highest key (or the lowest with lowest set); ties go to
+// the smaller id.
+
+typedef struct {
+    double key;
+    int id;
+} TopKEntry;
+
+typedef struct {
+    TopKEntry *entries;     // caller's array of k entries
+    int count;
+    int k;
+    int lowest;
+} TopK;
+
+// Whether a ranks before b
+static int topKBefore(const TopK *t, const TopKEntry *a, const TopKEntry *b) {
+    if (a->key != b->key) return t->lowest ? a->key < b->key : a->key > b->key;
+    return a->id < b->id;
+}
+
+// Restores the heap below pos (worst entry at the root) over n entries
+static void topKSiftDown(TopK *t, int pos, int n) {
+    TopKEntry *e = t->entries;
+    for (;;) {
+        int worst = pos, l = 2 * pos + 1, r = l + 1;
+        if (l < n && topKBefore(t, &e[worst], &e[l])) worst = l;
+        if (r < n && topKBefore(t, &e[worst], &e[r])) worst = r;
+        if (worst == pos) return;
+        TopKEntry tmp = e[pos];
+        e[pos] = e[worst];
+        e[worst] = tmp;
+        pos = worst;
+    }
+}
+
+static void topKOffer(TopK *t, double key, int id) {
+    TopKEntry c = { key, id };
+    TopKEntry *e = t->entries;
+    if (t->count < t->k) {
+        int pos = t->count++;
+        while (pos > 0 && topKBefore(t, &e[(pos - 1) / 2], &c)) {
+            e[pos] = e[(pos - 1) / 2];
+            pos = (pos - 1) / 2;
+        }
+        e[pos] = c;
+    } else if (t->k > 0 && topKBefore(t, &c, &e[0])) {
+        e[0] = c;
+        topKSiftDown(t, 0, t->count);
+    }
+}
+
+// Orders the kept entries best first (heapsort in place); returns the count
+static int topKFinish(TopK *t) {
+    for (int n = t->count - 1; n > 0; n--) {
+        TopKEntry tmp = t->entries[0];
+        t->entries[0] = t->entries[n];
+        t->entries[n] = tmp;
+        topKSiftDown(t, 0, n);
+    }
+    return t->count;
+}
+
+// ================= VALUATION KERNELS =================
+// Price statistics and position valuation over contiguous arrays. Each
+// kernel has a scalar and an AVX2 version; the AVX2 one is chosen at runtime
+// when the CPU supports it and --no-simd was not given.
+
+static void priceStatsScalar(const double *price, int n, PriceStats *out) {
+    double sum = 0, min = n > 0 ? price[0] : 0, max = min;
+    for (int i = 0; i < n; i++) {
+        sum += price[i];
+        if (price[i] < min) min = price[i];
+        if (price[i] > max) max = price[i];
+    }
+    out->sum = sum;
+    out->min = min;
+    out->max = max;
+}
+
+static void valueBookScalar(const int *qty, const double *avg, const double *price,
+                            int n, double *pnl, BookTotals *out) {
+    double cost = 0, value = 0;
+    for (int i = 0; i < n; i++) {
+        cost += qty[i] * avg[i];
+        value += qty[i] * price[i];
+        if (pnl) pnl[i] = (price[i] - avg[i]) * qty[i];
+    }
+    out->cost = cost;
+    out->value = value;
+}
+
+#ifdef HAVE_AVX2_KERNELS
+// Two independent accumulators per quantity hide the add latency
+__attribute__((target("avx2")))
+static void priceStatsAvx2(const double *price, int n, PriceStats *out) {
+    if (n < 8) {
+        priceStatsScalar(price, n, out);
+        return;
+    }
+    __m256d sum0 = _mm256_setzero_pd(), sum1 = _mm256_setzero_pd();
+    __m256d min0 = _mm256_set1_pd(price[0]), min1 = min0, max0 = min0, max1 = min0;
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256d a = _mm256_loadu_pd(price + i);
+        __m256d b = _mm256_loadu_pd(price + i + 4);
+        sum0 = _mm256_add_pd(sum0, a);
+        sum1 = _mm256_add_pd(sum1, b);
+        min0 = _mm256_min_pd(min0, a);
+        min1 = _mm256_min_pd(min1, b);
+        max0 = _mm256_max_pd(max0, a);
+        max1 = _mm256_max_pd(max1, b);
+    }
+    double s[4], lo[4], hi[4];
+    _mm256_storeu_pd(s, _mm256_add_pd(sum0, sum1));
+    _mm256_storeu_pd(lo, _mm256_min_pd(min0, min1));
+    _mm256_storeu_pd(hi, _mm256_max_pd(max0, max1));
+
+    PriceStats tail;
+    priceStatsScalar(price + i, n - i, &tail);
+    out->sum = (s[0] + s[1]) + (s[2] + s[3]) + tail.sum;
+    out->min = out->max = price[0];
+    for (int k = 0; k < 4; k++) {
+        if (lo[k] < out->min) out->min = lo[k];
+        if (hi[k] > out->max) out->max = hi[k];
+    }
+    if (i < n && tail.min < out->min) out->min = tail.min;
+    if (i < n && tail.max > out->max) out->max = tail.max;
+}
+
+__attribute__((target("avx2")))
+static void valueBookAvx2(const int *qty, const double *avg, const double *price,
+                          int n, double *pnl, BookTotals *out) {
+    __m256d cost = _mm256_setzero_pd(), value = _mm256_setzero_pd();
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256d q = _mm256_cvtepi32_pd(_mm_loadu_si128((const __m128i *)(qty + i)));
+        __m256d a = _mm256_loadu_pd(avg + i);
+        __m256d p = _mm256_loadu_pd(price + i);
+        cost = _mm256_add_pd(cost, _mm256_mul_pd(q, a));
+        value = _mm256_add_pd(value, _mm256_mul_pd(q, p));
+        if (pnl) _mm256_storeu_pd(pnl + i, _mm256_mul_pd(_mm256_sub_pd(p, a), q));
+    }
+    double c[4], v[4];
+    _mm256_storeu_pd(c, cost);
+    _mm256_storeu_pd(v, value);
+
+    BookTotals tail;
+    valueBookScalar(qty + i, avg + i, price + i, n - i, pnl ? pnl + i : NULL, &tail);
+    out->cost = (c[0] + c[1]) + (c[2] + c[3]) + tail.cost;
+    out->value = (v[0] + v[1]) + (v[2] + v[3]) + tail.value;
+}
+#endif
+
+static void (*priceStatsKernel)(const double *, int, PriceStats *) = NULL;
+static void (*valueBookKernel)(const int *, const double *, const double *,
+                               int, double *, BookTotals *) = NULL;
+static const char *valuationKernelName = "scalar";
+
+static void selectValuationKernels() {
+    priceStatsKernel = priceStatsScalar;
+    valueBookKernel = valueBookScalar;
+    valuationKernelName = "scalar";
+#ifdef HAVE_AVX2_KERNELS
+    if (simdKernelsEnabled && __builtin_cpu_supports("avx2")) {
+        priceStatsKernel = priceStatsAvx2;
+        valueBookKernel = valueBookAvx2;
+        valuationKernelName = "avx2";
+    }
+#endif
+}
+
+// Sum, min and max of price[0..n); min = max = 0 when n is 0
+void computePriceStats(const double *price, int n, PriceStats *out) {
+    if (!priceStatsKernel) selectValuationKernels();
+    priceStatsKernel(price, n, out);
+}
+
+// Cost (qty * avg) and value (qty * price) of n positions; when pnl is not
+// NULL it receives each position's (price - avg) * qty
+void valueBook(const int *qty, const double *avg, const double *price,
+               int n, double *pnl, BookTotals *out) {
+    if (!valueBookKernel) selectValuationKernels();
+    valueBookKernel(qty, avg, price, n, pnl, out);
+}
+
+// ================= CONCURRENT MARKET READS =================
+// Market readers never take a lock. Three mechanisms cover the writer's
+// changes:
+//  - Per-row seqlocks (marketRowSeq) guard a row's price and sector: the
+//    writer makes the sequence odd, updates, and makes it even again; a
+//    reader retries if it saw an odd or changed sequence.
+//  - One structure seqlock (marketStructSeq) guards the symbol index while a
+//    row is inserted or the index is rehashed.
+//  - Arrays readers can see are never realloc'd in place. A grown array is
+//    copied, published by pointer, and the old one is freed only after every
+//    reader that might still hold it has left (an RCU-style grace period).
+// Symbols never change once a row is published, and marketCount is
+// published after the row it counts. Bulk loads and the secondary indexes
+// (symbol order, price index, sector lists) remain writer-side only.
+
+static struct {
+    _Alignas(64) _Atomic int readers;
+} marketPhaseReaders[2];
+static _Atomic unsigned int marketReadPhase = 0;
+
+// Enters a read-side section; returns the token for marketReadEnd()
+int marketReadBegin() {
+    for (;;) {
+        unsigned int phase = atomic_load(&marketReadPhase) & 1;
+        atomic_fetch_add(&marketPhaseReaders[phase].readers, 1);
+        // A writer may have flipped the phase in between; then register again
+        if ((atomic_load(&marketReadPhase) & 1) == phase) return (int)phase;
+        atomic_fetch_sub(&marketPhaseReaders[phase].readers, 1);
+    }
+}
+
+void marketReadEnd(int phase) {
+    atomic_fetch_sub_explicit(&marketPhaseReaders[phase].readers, 1, memory_order_release);
+}
+
+// Writer side: waits until no reader can still hold an array that was
+// unpublished before this call. Readers that start later see the new ones.
+static void synchronizeMarketReaders() {
+    unsigned int old = atomic_fetch_add(&marketReadPhase, 1) & 1;
+    while (atomic_load_explicit(&marketPhaseReaders[old].readers, memory_order_acquire) > 0)
+        sched_yield();
+}
+
+// New allocation holding a copy of the first keepBytes of old
+static void *copyIntoLarger(const void *old, size_t keepBytes, size_t newBytes) {
+    void *p = malloc(newBytes ? newBytes : 1);
+    if (p && old && keepBytes) memcpy(p, old, keepBytes);
+    return p;
+}
+
+static void beginSeqWrite(_Atomic unsigned int *seq) {
+    atomic_store_explicit(seq, atomic_load_explicit(seq, memory_order_relaxed) + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+}
+
+static void endSeqWrite(_Atomic unsigned int *seq) {
+    atomic_store_explicit(seq, atomic_load_explicit(seq, memory_order_relaxed) + 1, memory_order_release);
+}
+
+// Waits out an in-progress write; returns the even sequence to validate with
+static unsigned int beginSeqRead(const _Atomic unsigned int *seq) {
+    unsigned int s;
+    while ((s = atomic_load_explicit(seq, memory_order_acquire)) & 1)
+        sched_yield();
+    return s;
+}
+
+static int seqReadValid(const _Atomic unsigned int *seq, unsigned int start) {
+    atomic_thread_fence(memory_order_acquire);
+    return atomic_load_explicit(seq, memory_order_relaxed) == start;
+}
+
+// Writer-side row updates; only price, sector and status ever change
+static void storeMarketPrice(int row, double price) {
+    __atomic_store(&marketPrices[row], &price, __ATOMIC_RELAXED);
+}
+
+static void storeMarketSector(int row, int sectorId) {
+    __atomic_store_n(&marketSectorIds[row], sectorId, __ATOMIC_RELAXED);
+}
+
+// A row's current price; a single aligned word, so it is never torn
+double loadMarketPrice(int row) {
+    const double *prices = __atomic_load_n(&marketPrices, __ATOMIC_ACQUIRE);
+    double price;
+    __atomic_load(&prices[row], &price, __ATOMIC_RELAXED);
+    return price;
+}
+
+// Rows published so far; rows below this count are fully written
+int marketVisibleCount() {
+    return __atomic_load_n(&marketCount, __ATOMIC_ACQUIRE);
+}
+
+// Consistent copy of one row. Call inside marketReadBegin/End.
+int readMarketQuote(int row, MarketQuote *out) {
+    if (row < 0 || row >= marketVisibleCount()) return 0;
+    const char (*symbols)[MAX_SYMBOL_LEN] = __atomic_load_n(&marketSymbols, __ATOMIC_ACQUIRE);
+    const double *prices = __atomic_load_n(&marketPrices, __ATOMIC_ACQUIRE);
+    const int *sectorIds = __atomic_load_n(&marketSectorIds, __ATOMIC_ACQUIRE);
+    const unsigned char *status = __atomic_load_n(&marketStatus, __ATOMIC_ACQUIRE);
+    _Atomic unsigned int *rowSeq = __atomic_load_n(&marketRowSeq, __ATOMIC_ACQUIRE);
+
+    memcpy(out->symbol, symbols[row], MAX_SYMBOL_LEN);
+    unsigned int s;
+    do {
+        s = beginSeqRead(&rowSeq[row]);
+        __atomic_load(&prices[row], &out->price, __ATOMIC_RELAXED);
+        out->sectorId = __atomic_load_n(&sectorIds[row], __ATOMIC_RELAXED);
+        out->listed = __atomic_load_n(&status[row], __ATOMIC_RELAXED) == OCCUPIED;
+    } while (!seqReadValid(&rowSeq[row], s));
+    return 1;
+}
+
+// Reader-side symbol lookup (exact, case-insensitive); returns the row or
+// -1. Call inside marketReadBegin/End.
+int lookupMarketRow(const char *symbol) {
+    SymbolKey key = symbolKey(symbol);
+    if (key == SYMBOL_KEY_NONE) return -1;
+    unsigned int h = symbolKeyHash(key);
+    for (;;) {
+        unsigned int s = beginSeqRead(&marketStructSeq);
+        // Capacity before pointer: the writer publishes the pointer first,
+        // so the array seen is never smaller than the capacity
+        unsigned int capacity = __atomic_load_n(&marketIndexCapacity, __ATOMIC_ACQUIRE);
+        const MarketSlot *index = __atomic_load_n(&marketIndex, __ATOMIC_ACQUIRE);
+        int result = -1;
+
+        if (index && capacity) {
+            unsigned int mask = capacity - 1;
+            unsigned int pos = h & mask;
+            for (unsigned int dist = 0; dist < capacity; dist++) {
+                int row = __atomic_load_n(&index[pos].row, __ATOMIC_ACQUIRE);
+                if (row < 0 || (unsigned int)__atomic_load_n(&index[pos].dist, __ATOMIC_RELAXED) < dist)
+                    break;
+                if (__atomic_load_n(&index[pos].key, __ATOMIC_RELAXED) == key) {
+                    result = row;
+                    break;
+                }
+                pos = (pos + 1) & mask;
+            }
+        }
+        if (seqReadValid(&marketStructSeq, s)) return result;
+    }
+}
+
+// ================= SYMBOL KEYS =================
+// Symbols are normalized once, where they enter a table or a lookup, into a
+// SymbolKey. Up to SYMBOL_KEY_PACKED_LEN ASCII characters are packed
+// uppercased (first character in the low byte, zero padded), so equal
+// symbols are equal integers and a probe is one compare. Longer symbols are
+// interned in the long symbol table and keyed SYMBOL_KEY_LONG | id. Market
+// readers look long symbols up while the writer interns new ones, so both
+// arrays are copied and published when they grow. Ids are per process:
+// files store symbol text and keys are recomputed on load.
+
+// Packs symbol, uppercased, into *key; returns 0 if it is too long or not
+// ASCII and needs the long symbol table instead
+static int packSymbolKey(const char *symbol, SymbolKey *key) {
+    SymbolKey k = 0;
+    int i = 0;
+    for (; i < SYMBOL_KEY_PACKED_LEN && symbol[i]; i++) {
+        unsigned int c = (unsigned char)symbol[i];
+        c -= (c - 'a' < 26u) << 5;   // ASCII uppercase without a locale call
+        k |= (SymbolKey)c << (8 * i);
+    }
+    *key = k;
+    return symbol[i] == '\0' && (k & 0x8080808080808080ULL) == 0;
+}
+
+// Uppercased copy of a long symbol; 0 if it cannot be a symbol at all
+static int longSymbolName(const char *symbol, char *out) {
+    for (int i = 0; i < MAX_SYMBOL_LEN; i++) {
+        unsigned int c = (unsigned char)symbol[i];
+        out[i] = (char)(c - ((c - 'a' < 26u) << 5));
+        if (c == '\0') return 1;
+    }
+    return 0;
+}
+
+// Id of an uppercased long symbol, or -1. Safe for market readers.
+static int findLongSymbol(const char *name) {
+    const LongSymbolLookup *lookup = __atomic_load_n(&longSymbolLookup, __ATOMIC_ACQUIRE);
+    if (!lookup) return -1;
+    unsigned int mask = lookup->capacity - 1;
+    unsigned int pos = hash(name) & mask;
+    for (;;) {
+        int id = __atomic_load_n(&lookup->slots[pos], __ATOMIC_ACQUIRE);
+        if (id < 0) return -1;
+        if (strcmp(__atomic_load_n(&longSymbols, __ATOMIC_ACQUIRE)[id], name) == 0) return id;
+        pos = (pos + 1) & mask;
+    }
+}
+
+static void placeLongSymbol(LongSymbolLookup *lookup, int id) {
+    unsigned int mask = lookup->capacity - 1;
+    unsigned int pos = hash(longSymbols[id]) & mask;
+    while (lookup->slots[pos] >= 0) pos = (pos + 1) & mask;
+    __atomic_store_n(&lookup->slots[pos], id, __ATOMIC_RELEASE);
+}
+
+static int growLongSymbolTable() {
+    if ((unsigned int)(longSymbolCount + 1) * 2 > (longSymbolLookup ? longSymbolLookup->capacity : 0)) {
+        unsigned int capacity = longSymbolLookup ? longSymbolLookup->capacity * 2 : 64;
+        LongSymbolLookup *lookup = malloc(sizeof(LongSymbolLookup) + sizeof(int) * capacity);
+        if (!lookup) {
+            perror("Error growing long symbol table");
+            return 0;
+        }
+        lookup->capacity = capacity;
+        for (unsigned int i = 0; i < capacity; i++) lookup->slots[i] = -1;
+        for (int id = 0; id < longSymbolCount; id++) placeLongSymbol(lookup, id);
+
+        LongSymbolLookup *old = longSymbolLookup;
+        __atomic_store_n(&longSymbolLookup, lookup, __ATOMIC_RELEASE);
+        synchronizeMarketReaders();
+        free(old);
+    }
+    if (longSymbolCount == longSymbolCapacity) {
+        int capacity = longSymbolCapacity ? longSymbolCapacity * 2 : 16;
+        char (*names)[MAX_SYMBOL_LEN] = copyIntoLarger(longSymbols, sizeof(*names) * longSymbolCount,
+                                                       sizeof(*names) * capacity);
+        if (!names) {
+            perror("Error growing long symbol table");
+            return 0;
+        }
+        char (*old)[MAX_SYMBOL_LEN] = longSymbols;
+        __atomic_store_n(&longSymbols, names, __ATOMIC_RELEASE);
+        longSymbolCapacity = capacity;
+        synchronizeMarketReaders();
+        free(old);
+    }
+    return 1;
+}
+
+// Key of symbol for lookups: SYMBOL_KEY_NONE if it is a long symbol that was
+// never interned, so it cannot be in any table. Safe for market readers.
+SymbolKey symbolKey(const char *symbol) {
+    SymbolKey key;
+    if (packSymbolKey(symbol, &key)) return key;
+    char name[MAX_SYMBOL_LEN];
+    int id = longSymbolName(symbol, name) ? findLongSymbol(name) : -1;
+    return id < 0 ? SYMBOL_KEY_NONE : SYMBOL_KEY_LONG | (SymbolKey)id;
+}
+
+// Key of symbol for inserts, interning a long symbol if it is new;
+// SYMBOL_KEY_NONE on failure
+SymbolKey internSymbolKey(const char *symbol) {
+    SymbolKey key;
+    if (packSymbolKey(symbol, &key)) return key;
+    char name[MAX_SYMBOL_LEN];
+    if (!longSymbolName(symbol, name)) return SYMBOL_KEY_NONE;
+    int id = findLongSymbol(name);
+    if (id < 0) {
+        if (!growLongSymbolTable()) return SYMBOL_KEY_NONE;
+        id = longSymbolCount++;
+        strcpy(longSymbols[id], name);
+        placeLongSymbol(longSymbolLookup, id);
+    }
+    return SYMBOL_KEY_LONG | (SymbolKey)id;
+}
+
+// ================= SECTOR DICTIONARY =================
+// Sector names are interned (uppercased) to small integer ids. Each id keeps
+// a member list of market rows, and each account one of its holding slots; a
+// member's position in its list is tracked so removal is a swap with the last
+// element.
+
+static unsigned int sectorLookupHome(const char *name) {
+    return hash(name) & (sectorLookupCapacity - 1);
+}
+
+static int growSectorLookup() {
+    int newCapacity = sectorLookupCapacity ? sectorLookupCapacity * 2 : 64;
+    int *lookup = malloc(sizeof(int) * newCapacity);
+    if (!lookup) {
+        perror("Error growing sector dictionary");
+        return 0;
+    }
+    for (int i = 0; i < newCapacity; i++) lookup[i] = -1;
+    free(sectorLookup);
+    sectorLookup = lookup;
+    sectorLookupCapacity = newCapacity;
+
+    for (int id = 0; id < sectorNameCount; id++) {
+        unsigned int pos = sectorLookupHome(sectorNames[id]);
+        while (sectorLookup[pos] >= 0) pos = (pos + 1) & (sectorLookupCapacity - 1);
+        sectorLookup[pos] = id;
+    }
+    return 1;
+}
+
+// Returns the id of a sector name (case-insensitive), or -1 if unknown
+int findSectorId(const char *name) {
+    if (sectorLookupCapacity == 0) return -1;
+    char key[MAX_SECTOR_LEN];
+    strncpy(key, name, MAX_SECTOR_LEN - 1);
+    key[MAX_SECTOR_LEN - 1] = '\0';
+    toUpperStr(key);
+
+    unsigned int pos = sectorLookupHome(key);
+    while (sectorLookup[pos] >= 0) {
+        if (strcmp(sectorNames[sectorLookup[pos]], key) == 0) return sectorLookup[pos];
+        pos = (pos + 1) & (sectorLookupCapacity - 1);
+    }
+    return -1;
+}
+
+// Returns the id of a sector name, adding it to the dictionary if new
+int internSector(const char *name) {
+    int id = findSectorId(name);
+    if (id >= 0) return id;
+
+    if ((sectorNameCount + 1) * 2 > sectorLookupCapacity && !growSectorLookup())
+        return -1;
+    if (sectorNameCount == sectorNameCapacity) {
+        // Market readers resolve names and member counts, so both arrays are
+        // copied and published rather than realloc'd
+        int newCapacity = sectorNameCapacity ? sectorNameCapacity * 2 : 16;
+        char (*names)[MAX_SECTOR_LEN] = copyIntoLarger(sectorNames, sizeof(*names) * sectorNameCount,
+                                                       sizeof(*names) * newCapacity);
+        SectorMembers *market = copyIntoLarger(marketSectorMembers, sizeof(SectorMembers) * sectorNameCount,
+                                               sizeof(SectorMembers) * newCapacity);
+        if (!names || !market) {
+            perror("Error growing sector dictionary");
+            free(names);
+            free(market);
+            return -1;
+        }
+        char (*oldNames)[MAX_SECTOR_LEN] = sectorNames;
+        SectorMembers *oldMarket = marketSectorMembers;
+        __atomic_store_n(&sectorNames, names, __ATOMIC_RELEASE);
+        __atomic_store_n(&marketSectorMembers, market, __ATOMIC_RELEASE);
+        sectorNameCapacity = newCapacity;
+        synchronizeMarketReaders();
+        free(oldNames);
+        free(oldMarket);
+    }
+
+    id = sectorNameCount;
+    strncpy(sectorNames[id], name, MAX_SECTOR_LEN - 1);
+    sectorNames[id][MAX_SECTOR_LEN - 1] = '\0';
+    toUpperStr(sectorNames[id]);
+    memset(&marketSectorMembers[id], 0, sizeof(SectorMembers));
+    __atomic_store_n(&sectorNameCount, id + 1, __ATOMIC_RELEASE);
+
+    unsigned int pos = sectorLookupHome(sectorNames[id]);
+    while (sectorLookup[pos] >= 0) pos = (pos + 1) & (sectorLookupCapacity - 1);
+    sectorLookup[pos] = id;
+    return id;
+}
+
+// Safe for market readers: names are never changed once interned
+const char *sectorName(int id) {
+    if (id < 0 || id >= __atomic_load_n(&sectorNameCount, __ATOMIC_ACQUIRE)) return "";
+    return __atomic_load_n(&sectorNames, __ATOMIC_ACQUIRE)[id];
+}
+
+static void sectorMembersAdd(SectorMembers *list, int member, int *posOf) {
+    if (list->count == list->capacity) {
+        int newCapacity = list->capacity ? list->capacity * 2 : 8;
+        int *members = realloc(list->members, sizeof(int) * newCapacity);
+        if (!members) {
+            perror("Error growing sector members");
+            return;
+        }
+        list->members = members;
+        list->capacity = newCapacity;
+    }
+    posOf[member] = list->count;
+    list->members[list->count] = member;
+    __atomic_store_n(&list->count, list->count + 1, __ATOMIC_RELAXED);   // read by market readers
+}
+
+static void sectorMembersRemove(SectorMembers *list, int member, int *posOf) {
+    int pos = posOf[member];
+    if (pos < 0 || pos >= list->count || list->members[pos] != member) return;
+    int last = list->members[list->count - 1];
+    __atomic_store_n(&list->count, list->count - 1, __ATOMIC_RELAXED);
+    list->members[pos] = last;
+    posOf[last] = pos;
+    posOf[member] = -1;
+}
+
+// Moves a market row between sector lists when its sector changes
+static void setMarketSector(int row, int sectorId, int isNew) {
+    if (!isNew && marketSectorIds[row] == sectorId) return;
+    if (!isNew && !marketIndexesDeferred && marketSectorIds[row] >= 0)
+        sectorMembersRemove(&marketSectorMembers[marketSectorIds[row]], row, marketSectorPos);
+    storeMarketSector(row, sectorId);
+    if (!marketIndexesDeferred && sectorId >= 0)
+        sectorMembersAdd(&marketSectorMembers[sectorId], row, marketSectorPos);
+}
+
+void rebuildMarketSectorMembers() {
+    for (int id = 0; id < sectorNameCount; id++) marketSectorMembers[id].count = 0;
+    for (int row = 0; row < marketCount; row++) {
+        marketSectorPos[row] = -1;
+        if (marketSectorIds[row] >= 0)
+            sectorMembersAdd(&marketSectorMembers[marketSectorIds[row]], row, marketSectorPos);
+    }
+}
+
+// An account's holding list for a sector, grown on demand since accounts are
+// created independently of the dictionary; NULL if it cannot be grown
+static SectorMembers *accountSectorList(Account *acct, int id) {
+    if (id < 0) return NULL;
+    if (id >= acct->sectorMembersCapacity) {
+        int newCapacity = acct->sectorMembersCapacity ? acct->sectorMembersCapacity : 8;
+        while (newCapacity <= id) newCapacity *= 2;
+        SectorMembers *lists = realloc(acct->sectorMembers, sizeof(SectorMembers) * newCapacity);
+        if (!lists) {
+            perror("Error growing sector members");
+            return NULL;
+        }
+        memset(lists + acct->sectorMembersCapacity, 0,
+               sizeof(SectorMembers) * (newCapacity - acct->sectorMembersCapacity));
+        acct->sectorMembers = lists;
+        acct->sectorMembersCapacity = newCapacity;
+    }
+    return &acct->sectorMembers[id];
+}
+
+static void addHoldingToSector(Account *acct, int slot) {
+    SectorMembers *list = accountSectorList(acct, acct->holdings[slot].sectorId);
+    if (list) sectorMembersAdd(list, slot, acct->sectorPos);
+}
+
+static void removeHoldingFromSector(Account *acct, int slot) {
+    SectorMembers *list = accountSectorList(acct, acct->holdings[slot].sectorId);
+    if (list) sectorMembersRemove(list, slot, acct->sectorPos);
+}
+
+void rebuildHoldingSectorMembers(Account *acct) {
+    for (int id = 0; id < acct->sectorMembersCapacity; id++) acct->sectorMembers[id].count = 0;
+    for (int slot = 0; slot < TABLE_SIZE; slot++) {
+        acct->sectorPos[slot] = -1;
+        if (acct->holdings[slot].status == OCCUPIED)
+            addHoldingToSector(acct, slot);
+    }
+}
+
+// Snapshots store ids, so each one carries the names it refers to. On load
+// the names are interned again and the stored ids remapped.
+static void writeSectorNames(FILE *fp) {
+    fwrite(&sectorNameCount, sizeof(int), 1, fp);
+    fwrite(sectorNames, MAX_SECTOR_LEN, sectorNameCount, fp);
+}
+
+// Reads the names at p (bounded by end) into a freshly allocated id remap
+static int *readSectorNames(const char *p, const char *end, int *countOut) {
+    int count;
+    if (end - p < (long)sizeof(int)) return NULL;
+    memcpy(&count, p, sizeof(int));
+    p += sizeof(int);
+    if (count < 0 || end - p < (long)count * MAX_SECTOR_LEN) return NULL;
+
+    int *remap = malloc(sizeof(int) * (count ? count : 1));
+    if (!remap) return NULL;
+    for (int i = 0; i < count; i++) {
+        char name[MAX_SECTOR_LEN];
+        memcpy(name, p + (size_t)i * MAX_SECTOR_LEN, MAX_SECTOR_LEN);
+        name[MAX_SECTOR_LEN - 1] = '\0';
+        remap[i] = internSector(name);
+    }
+    *countOut = count;
+    return remap;
+}
+
+// ================= MARKET TABLE =================
+
+void initMarketTable() 
+{
+    beginSeqWrite(&marketStructSeq);
+    __atomic_store_n(&marketCount, 0, __ATOMIC_RELEASE);
+    if (marketIndex == NULL) {
+        marketIndexCapacity = MARKET_INITIAL_CAPACITY;
+        marketIndex = malloc(sizeof(MarketSlot) * marketIndexCapacity);
+        if (!marketIndex) {
+            perror("Error allocating market index");
+            exit(1);
+        }
+    }
+    for (unsigned int i = 0; i < marketIndexCapacity; i++) {
+        marketIndex[i].key = SYMBOL_KEY_NONE;
+        marketIndex[i].row = -1;
+        marketIndex[i].dist = 0;
+    }
+    endSeqWrite(&marketStructSeq);
+}
+
+// Robin Hood placement: an entry that has travelled further from its home
+// slot takes the place of one that is closer to home, keeping chains short.
+// Slots are written field by field with atomic stores so that concurrent
+// readers see whole fields; the structure seqlock tells them to retry.
+static void storeMarketSlot(unsigned int pos, const MarketSlot *slot) {
+    __atomic_store_n(&marketIndex[pos].key, slot->key, __ATOMIC_RELAXED);
+    __atomic_store_n(&marketIndex[pos].dist, slot->dist, __ATOMIC_RELAXED);
+    __atomic_store_n(&marketIndex[pos].row, slot->row, __ATOMIC_RELEASE);
+}
+
+static void placeMarketIndexSlot(SymbolKey key, int row) {
+    unsigned int mask = marketIndexCapacity - 1;
+    unsigned int pos = symbolKeyHash(key) & mask;
+    MarketSlot cur = { key, row, 0 };
+
+    for (;;) {
+        if (marketIndex[pos].row < 0) {
+            storeMarketSlot(pos, &cur);
+            return;
+        }
+        if (marketIndex[pos].dist < cur.dist) {
+            MarketSlot tmp = marketIndex[pos];
+            storeMarketSlot(pos, &cur);
+            cur = tmp;
+        }
+        pos = (pos + 1) & mask;
+        cur.dist++;
+    }
+}
+
+static int growMarketIndex() {
+    unsigned int oldCapacity = marketIndexCapacity;
+    MarketSlot *oldIndex = marketIndex;
+    unsigned int newCapacity = oldCapacity * 2;
+    MarketSlot *newIndex = malloc(sizeof(MarketSlot) * newCapacity);
+    if (!newIndex) {
+        perror("Error growing market index");
+        return 0;
+    }
+    for (unsigned int i = 0; i < newCapacity; i++) {
+        newIndex[i].key = SYMBOL_KEY_NONE;
+        newIndex[i].row = -1;
+        newIndex[i].dist = 0;
+    }
+
+    // Readers retry until the rehash is complete; the old index is freed
+    // once none of them can still be probing it
+    beginSeqWrite(&marketStructSeq);
+    __atomic_store_n(&marketIndex, newIndex, __ATOMIC_RELEASE);
+    __atomic_store_n(&marketIndexCapacity, newCapacity, __ATOMIC_RELEASE);
+    for (unsigned int i = 0; i < oldCapacity; i++) {
+        if (oldIndex[i].row >= 0)
+            placeMarketIndexSlot(oldIndex[i].key, oldIndex[i].row);
+    }
+    endSeqWrite(&marketStructSeq);
+    synchronizeMarketReaders();
+    free(oldIndex);
+    return 1;
+}
+
+// Resizes every per-row market column together. The columns readers use are
+// copied and published (see CONCURRENT MARKET READS); the writer-only ones
+// are realloc'd. Columns that did grow are kept on failure;
+// marketRowCapacity only changes once all of them have.
+static int resizeMarketColumns(int newCapacity) {
+    size_t keep = (size_t)(marketRowCapacity < newCapacity ? marketRowCapacity : newCapacity);
+    char (*symbols)[MAX_SYMBOL_LEN] = copyIntoLarger(marketSymbols, keep * MAX_SYMBOL_LEN,
+                                                     (size_t)newCapacity * MAX_SYMBOL_LEN);
+    double *prices = copyIntoLarger(marketPrices, keep * sizeof(double), sizeof(double) * newCapacity);
+    int *sectorIds = copyIntoLarger(marketSectorIds, keep * sizeof(int), sizeof(int) * newCapacity);
+    unsigned char *status = copyIntoLarger(marketStatus, keep, newCapacity);
+    _Atomic unsigned int *rowSeq = copyIntoLarger((const void *)marketRowSeq, keep * sizeof(*rowSeq),
+                                                  sizeof(*rowSeq) * newCapacity);
+    if (!symbols || !prices || !sectorIds || !status || !rowSeq) {
+        perror("Error growing market table");
+        free(symbols);
+        free(prices);
+        free(sectorIds);
+        free(status);
+        free((void *)rowSeq);
+        return 0;
+    }
+    for (size_t i = keep; i < (size_t)newCapacity; i++) atomic_init(&rowSeq[i], 0);
+
+    void *retired[] = { marketSymbols, marketPrices, marketSectorIds, marketStatus, (void *)marketRowSeq };
+    __atomic_store_n(&marketSymbols, symbols, __ATOMIC_RELEASE);
+    __atomic_store_n(&marketPrices, prices, __ATOMIC_RELEASE);
+    __atomic_store_n(&marketSectorIds, sectorIds, __ATOMIC_RELEASE);
+    __atomic_store_n(&marketStatus, status, __ATOMIC_RELEASE);
+    __atomic_store_n(&marketRowSeq, rowSeq, __ATOMIC_RELEASE);
+    synchronizeMarketReaders();
+    for (size_t i = 0; i < sizeof(retired) / sizeof(retired[0]); i++) free(retired[i]);
+
+    int *sectorPos = realloc(marketSectorPos, sizeof(int) * newCapacity);
+    if (sectorPos) marketSectorPos = sectorPos;
+    SymbolKey *keys = realloc(marketKeys, sizeof(SymbolKey) * newCapacity);
+    if (keys) marketKeys = keys;
+    MarketHolders *holders = realloc(marketHolders, sizeof(MarketHolders) * newCapacity);
+    if (holders) {
+        if (newCapacity > marketRowCapacity)
+            memset(holders + marketRowCapacity, 0, sizeof(MarketHolders) * (newCapacity - marketRowCapacity));
+        marketHolders = holders;
+    }
+    if (!sectorPos || !keys || !holders) {
+        perror("Error growing market table");
+        return 0;
+    }
+    marketRowCapacity = newCapacity;
+    return 1;
+}
+
+static int growMarketRows() {
+    return resizeMarketColumns(marketRowCapacity ? marketRowCapacity * 2 : MARKET_INITIAL_CAPACITY);
+}
+
+// Returns the row holding symbol, or -1 (with *found = 0) if it is not listed.
+int findMarketSlot(const char *symbol, int *found) 
+{
+    int row = findMarketRowByKey(symbolKey(symbol));
+    if (found) *found = row >= 0;
+    return row;
+}
+
+// Same as findMarketSlot for an already normalized symbol: the probe reads
+// only index slots and compares whole keys
+int findMarketRowByKey(SymbolKey key) {
+    if (marketIndex == NULL || key == SYMBOL_KEY_NONE) return -1;
+
+    unsigned int mask = marketIndexCapacity - 1;
+    unsigned int pos = symbolKeyHash(key) & mask;
+
+    for (int dist = 0; ; dist++) {
+        const MarketSlot *s = &marketIndex[pos];
+        // An empty slot or a richer entry ends the chain: symbol is absent
+        if ((s->row < 0) | (s->dist < dist)) {
+            COUNT_PROBES(marketLookupStats, dist + 1, 0);
+            return -1;
+        }
+        if (s->key == key) {
+            COUNT_PROBES(marketLookupStats, dist + 1, 1);
+            return s->row;
+        }
+        pos = (pos + 1) & mask;
+    }
+}
+
+// ---------- Symbol Prefix Index ----------
+
+static int growSymbolIndex(int needed) {
+    if (needed <= marketSymbolOrderCapacity) return 1;
+    int newCapacity = marketSymbolOrderCapacity ? marketSymbolOrderCapacity : MARKET_INITIAL_CAPACITY;
+    while (newCapacity < needed) newCapacity *= 2;
+    int *order = realloc(marketSymbolOrder, sizeof(int) * newCapacity);
+    if (!order) {
+        perror("Error growing symbol index");
+        return 0;
+    }
+    marketSymbolOrder = order;
+    marketSymbolOrderCapacity = newCapacity;
+    return 1;
+}
+
+// First position in the symbol order whose symbol is >= key (first len chars)
+static int symbolLowerBound(const char *key, size_t len, int count) {
+    int lo = 0, hi = count;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (strncmp(marketSymbols[marketSymbolOrder[mid]], key, len) < 0) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+// First position whose symbol does not start with (and sorts after) prefix
+static int symbolPrefixEnd(const char *prefix, size_t len, int from, int count) {
+    int lo = from, hi = count;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (strncmp(marketSymbols[marketSymbolOrder[mid]], prefix, len) <= 0) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+// Called for each new row; the row is already counted in marketCount
+static void addToSymbolIndex(int row) {
+    if (marketIndexesDeferred) return;
+    int count = marketCount - 1;
+    if (!growSymbolIndex(marketCount)) return;
+
+    int pos = symbolLowerBound(marketSymbols[row], MAX_SYMBOL_LEN, count);
+    memmove(marketSymbolOrder + pos + 1, marketSymbolOrder + pos, sizeof(int) * (count - pos));
+    marketSymbolOrder[pos] = row;
+}
+
+static int cmpRowsBySymbol(const void *a, const void *b) {
+    return strcmp(marketSymbols[*(const int *)a], marketSymbols[*(const int *)b]);
+}
+
+void rebuildSymbolIndex() {
+    if (!growSymbolIndex(marketCount)) return;
+    for (int i = 0; i < marketCount; i++) marketSymbolOrder[i] = i;
+    qsort(marketSymbolOrder, marketCount, sizeof(int), cmpRowsBySymbol);
+}
+
+void rebuildPriceIndex() {
+    int *ids = malloc(sizeof(int) * (marketCount ? marketCount : 1));
+    double *prices = malloc(sizeof(double) * (marketCount ? marketCount : 1));
+    if (ids && prices) {
+        for (int i = 0; i < marketCount; i++) {
+            ids[i] = i;
+            prices[i] = marketPrices[i];
+        }
+        orderIndexBuild(&marketPriceIndex, ids, prices, marketCount);
+    }
+    free(ids);
+    free(prices);
+}
+
+// Ends a bulk load: rebuilds every secondary market index at once
+void rebuildMarketIndexes(int withSymbolOrder) {
+    marketIndexesDeferred = 0;
+    if (withSymbolOrder) rebuildSymbolIndex();
+    rebuildPriceIndex();
+    rebuildMarketSectorMembers();
+    rebuildPortfolioAggregates();
+}
+
+// Prefix query in O(log n + matches): fills rowsOut with up to limit rows
+// (in symbol order) starting at match number offset; returns the match count.
+int searchMarketByPrefix(const char *prefix, int offset, int limit, int *rowsOut) {
+    char key[MAX_SYMBOL_LEN];
+    strncpy(key, prefix, MAX_SYMBOL_LEN - 1);
+    key[MAX_SYMBOL_LEN - 1] = '\0';
+    toUpperStr(key);
+    size_t len = strlen(key);
+
+    int lo = symbolLowerBound(key, len, marketCount);
+    int hi = symbolPrefixEnd(key, len, lo, marketCount);
+
+    for (int i = 0; i < limit && lo + offset + i < hi; i++) {
+        rowsOut[i] = marketSymbolOrder[lo + offset + i];
+    }
+    return hi - lo;
+}
+
+// Inserts a new market row or updates an existing one; returns the row or -1.
+int upsertMarketStock(const char *symbol, const char *sector, double price, int *found) {
+    if (marketIndex == NULL) initMarketTable();
+
+    SymbolKey key = internSymbolKey(symbol);
+    if (key == SYMBOL_KEY_NONE) return -1;
+    int sectorId = internSector(sector);
+    int row = findMarketRowByKey(key);
+    if (found) *found = row >= 0;
+    int isNew = (row == -1);
+    if (row == -1) {
+        if ((unsigned long)(marketCount + 1) * 100 >
+            (unsigned long)marketIndexCapacity * MARKET_MAX_LOAD_PERCENT) {
+            if (!growMarketIndex()) return -1;
+        }
+        if (marketCount == marketRowCapacity && !growMarketRows())
+            return -1;
+
+        // The row is complete before the index and count publish it
+        row = marketCount;
+        strcpy(marketSymbols[row], symbol);
+        marketKeys[row] = key;
+        storeMarketPrice(row, price);
+        marketStatus[row] = OCCUPIED;
+        setMarketSector(row, sectorId, 1);
+
+        beginSeqWrite(&marketStructSeq);
+        placeMarketIndexSlot(key, row);
+        __atomic_store_n(&marketCount, row + 1, __ATOMIC_RELEASE);
+        endSeqWrite(&marketStructSeq);
+        addToSymbolIndex(row);
+    } else {
+        beginSeqWrite(&marketRowSeq[row]);
+        setMarketSector(row, sectorId, 0);
+        storeMarketPrice(row, price);
+        __atomic_store_n(&marketStatus[row], OCCUPIED, __ATOMIC_RELAXED);
+        endSeqWrite(&marketRowSeq[row]);
+    }
+
+    if (!marketIndexesDeferred) {
+        orderIndexSet(&marketPriceIndex, row, price);
+        marketPriceChanged(row, isNew);
+    }
+    return row;
+}
+
+// Re-prices a listed row: no dictionary or symbol lookups, just the price
+// index and the linked holding
+void setMarketPrice(int row, double price) {
+    beginSeqWrite(&marketRowSeq[row]);
+    storeMarketPrice(row, price);
+    endSeqWrite(&marketRowSeq[row]);
+    if (!marketIndexesDeferred) {
+        orderIndexSet(&marketPriceIndex, row, price);
+        marketPriceChanged(row, 0);
+    }
+}
+
+int searchMarketStockExact(const char *symbolRaw, double *priceOut, char *sectorOut) {
+    char symbol[MAX_SYMBOL_LEN];
+    strncpy(symbol, symbolRaw, MAX_SYMBOL_LEN - 1);
+    symbol[MAX_SYMBOL_LEN - 1] = '\0';
+    toUpperStr(symbol);
+
+    // Lock-free: safe while another thread updates the market
+    int phase = marketReadBegin();
+    MarketQuote quote;
+    int found = readMarketQuote(lookupMarketRow(symbol), &quote);
+    if (found) {
+        if (priceOut) *priceOut = quote.price;
+        if (sectorOut) strcpy(sectorOut, sectorName(quote.sectorId));
+    }
+    marketReadEnd(phase);
+    return found;
+}
+
+//Insert market stock
+int insertMarketStockInteractive() {
+    char symbol[MAX_SYMBOL_LEN];
+    char sector[MAX_SECTOR_LEN];
+    double price;
+    
+    printf("Enter stock symbol: ");
+    if (scanf("%15s", symbol) != 1) {
+        printf("Invalid input.\n");
+        clearInputBuffer();
+        return 0;
+    }
+    clearInputBuffer();
+    
+    
+    toUpperStr(symbol);
+    
+    // Check if already exists
+    double existingPrice;
+    char existingSector[MAX_SECTOR_LEN];
+    if (searchMarketStockExact(symbol, &existingPrice, existingSector)) {
+        printf("Stock %s already exists. Update price and sector? (y/n): ", symbol);
+        char choice;
+        scanf("%c", &choice);
+        clearInputBuffer();
+        
+        if (choice != 'y' && choice != 'Y') {
+            return 0;
+        }
+    }
+    
+    printf("Enter sector: ");
+    fgets(sector, MAX_SECTOR_LEN, stdin);
+    toUpperStr(sector);
+    sector[strcspn(sector, "\n")] = '\0';  
+    
+    printf("Enter current price: ");
+    if (scanf("%lf", &price) != 1 || !isValidPrice(price)) {
+        printf("Invalid price.\n");
+        clearInputBuffer();
+        return 0;
+    }
+    clearInputBuffer();
+    
+    // Insert or update; the table grows as needed
+    int found = 0;
+    if (upsertMarketStock(symbol, sector, price, &found) == -1) {
+        printf("Error: Could not grow market table.\n");
+        return 0;
+    }
+    
+    printf("Stock %s %s at price %.2f\n", 
+           found ? "updated" : "added", symbol, price);
+    saveMarketToFile(MARKET_FILE);       
+    return 1;
+}
+
+void searchMarketStocksInteractive() {
+    int choice;
+    char input[MAX_SYMBOL_LEN];
+    
+    printf("\n----- Search Options -----\n");
+    printf("1. Exact symbol match\n");
+    printf("2. Prefix search (starts with)\n");
+    printf("Enter choice: ");
+    
+    if (scanf("%d", &choice) != 1) {
+        printf("Invalid input.\n");
+        clearInputBuffer();
+        return;
+    }
+    clearInputBuffer();
+    
+    if (choice == 1) {
+        double price;
+        char sector[MAX_SECTOR_LEN];
+        
+        printf("Enter exact symbol to search: ");
+        if (scanf("%15s", input) != 1) {
+            printf("Invalid input.\n");
+            clearInputBuffer();
+            return;
+        }
+        clearInputBuffer();
+        
+        if (searchMarketStockExact(input, &price, sector)) {
+            printf("Found: %s | Sector: %s | Price: %.2f\n", input, sector, price);
+        } else {
+            printf("Stock %s not found in market.\n", input);
+        }
+        
+    } else if (choice == 2) {
+        printf("Enter symbol prefix (case-insensitive, no spaces): ");
+        if (scanf("%15s", input) != 1) {
+            printf("Invalid input.\n");
+            clearInputBuffer();
+            return;
+        }
+        clearInputBuffer();
+
+        int rows[MARKET_PAGE_SIZE];
+        int total = searchMarketByPrefix(input, 0, MARKET_PAGE_SIZE, rows);
+        printf("\n--- Stocks starting with \"%s\" (%d found) ---\n", input, total);
+
+        // Results come MARKET_PAGE_SIZE at a time
+        for (int offset = 0; offset < total; offset += MARKET_PAGE_SIZE) {
+            if (offset > 0) {
+                char more;
+                printf("Show next %d? (y/n): ", MARKET_PAGE_SIZE);
+                if (scanf(" %c", &more) != 1 || (more != 'y' && more != 'Y')) {
+                    clearInputBuffer();
+                    break;
+                }
+                clearInputBuffer();
+                searchMarketByPrefix(input, offset, MARKET_PAGE_SIZE, rows);
+            }
+            for (int i = 0; i < MARKET_PAGE_SIZE && offset + i < total; i++) {
+                printf("%-12s | %-10s | Price: %.2f\n",
+                       marketSymbols[rows[i]],
+                       sectorName(marketSectorIds[rows[i]]),
+                       marketPrices[rows[i]]);
+            }
+        }
+        if (total == 0) {
+            printf("No stocks found with prefix: %s\n", input);
+        }
+        
+    } else {
+        printf("Invalid choice.\n");
+    }
+}
+
+static void printMarketRow(int row) {
+    printf("%-12s | %-10s | Price: %.2f\n",
+           marketSymbols[row],
+           sectorName(marketSectorIds[row]),
+           marketPrices[row]);
+}
+
+// Number of listed stocks with lo <= price <= hi, in O(log n)
+int countMarketInPriceRange(double lo, double hi) {
+    if (hi < lo) return 0;
+    return orderIndexRank(&marketPriceIndex, hi, 1) - orderIndexRank(&marketPriceIndex, lo, 0);
+}
+
+static int readPriceArg(const char *prompt, double *out) {
+    printf("%s", prompt);
+    if (scanf("%lf", out) != 1) {
+        printf("Invalid price.\n");
+        clearInputBuffer();
+        return 0;
+    }
+    clearInputBuffer();
+    return 1;
+}
+
+// Price screens served from marketPriceIndex: ranges are located by rank in
+// O(log n) and listed in ascending price order.
+void filterMarketByPriceInteractive() {
+    int choice;
+
+    printf("1. Price >= target\n");
+    printf("2. Price <= target\n");
+    printf("3. Price between min and max\n");
+    printf("4. Top N most expensive\n");
+    printf("5. Top N cheapest\n");
+    printf("6. Count stocks in price range\n");
+    printf("Enter choice: ");
+    if (scanf("%d", &choice) != 1) {
+        printf("Invalid input.\n");
+        clearInputBuffer();
+        return;
+    }
+    clearInputBuffer();
+
+    int total = orderIndexCount(&marketPriceIndex);
+    int from = 0, to = 0;   // positions [from, to) in ascending price order
+    double lo, hi;
+    int n;
+
+    switch (choice) {
+        case 1:
+            if (!readPriceArg("Enter target price: ", &lo)) return;
+            from = orderIndexRank(&marketPriceIndex, lo, 0);
+            to = total;
+            break;
+        case 2:
+            if (!readPriceArg("Enter target price: ", &hi)) return;
+            to = orderIndexRank(&marketPriceIndex, hi, 1);
+            break;
+        case 3:
+        case 6:
+            if (!readPriceArg("Enter min price: ", &lo)) return;
+            if (!readPriceArg("Enter max price: ", &hi)) return;
+            if (choice == 6) {
+                printf("Stocks priced %.2f - %.2f: %d\n", lo, hi, countMarketInPriceRange(lo, hi));
+                return;
+            }
+            from = orderIndexRank(&marketPriceIndex, lo, 0);
+            to = hi < lo ? from : orderIndexRank(&marketPriceIndex, hi, 1);
+            break;
+        case 4:
+        case 5:
+            printf("Enter N: ");
+            if (scanf("%d", &n) != 1 || n <= 0) {
+                printf("Invalid input.\n");
+                clearInputBuffer();
+                return;
+            }
+            clearInputBuffer();
+            if (n > total) n = total;
+            printf("\n--- %s %d stocks by price ---\n", choice == 4 ? "Top" : "Cheapest", n);
+            for (int i = 0; i < n; i++) {
+                printMarketRow(orderIndexSelect(&marketPriceIndex, choice == 4 ? total - 1 - i : i));
+            }
+            if (n == 0) printf("No market stocks available.\n");
+            return;
+        default:
+            printf("Invalid choice.\n");
+            return;
+    }
+
+    printf("\n--- Market stocks by price filter (%d) ---\n", to > from ? to - from : 0);
+    for (int k = from; k < to; k++) {
+        printMarketRow(orderIndexSelect(&marketPriceIndex, k));
+    }
+    if (to <= from) {
+        printf("No stocks match the given price filter.\n");
+    }
+}
+
+void filterMarketBySectorInteractive() {
+    char sector[MAX_SECTOR_LEN];
+    printf("Enter sector name (e.g., IT, BANKING, AUTO): ");
+    if (scanf("%19s", sector) != 1) {
+        printf("Invalid input.\n");
+        clearInputBuffer();
+        return;
+    }
+    clearInputBuffer();
+
+    int id = findSectorId(sector);
+    printf("\n--- Market stocks in sector \"%s\" ---\n", sector);
+    if (id < 0 || marketSectorMembers[id].count == 0) {
+        printf("No stocks found in this sector.\n");
+    } else {
+        const SectorMembers *list = &marketSectorMembers[id];
+        for (int i = 0; i < list->count; i++) {
+            int row = list->members[i];
+            printf("%-12s | %-10s | Price: %.2f\n", marketSymbols[row], sectorName(id), marketPrices[row]);
+        }
+    }
+
+    Account *acct = activeAccount;
+    if (id >= 0 && id < acct->sectorMembersCapacity && acct->sectorMembers[id].count > 0) {
+        const SectorMembers *list = &acct->sectorMembers[id];
+        printf("\n--- Your holdings in sector \"%s\" ---\n", sector);
+        for (int i = 0; i < list->count; i++) {
+            const HoldingEntry *h = &acct->holdings[list->members[i]];
+            printf("%-12s | Qty: %d | Avg Buy: %.2f\n", h->symbol, h->quantity, h->avgBuyPrice);
+        }
+    }
+}
+
+typedef struct {
+    char symbol[MAX_SYMBOL_LEN];
+    char sector[MAX_SECTOR_LEN];
+    double price;
+} MarketView;
+
+int cmpMarketByPrice(const void *a, const void *b) {
+    const MarketView *x = (const MarketView *)a;
+    const MarketView *y = (const MarketView *)b;
+    if (x->price < y->price) return -1;
+    if (x->price > y->price) return  1;
+    return strcmp(x->symbol, y->symbol);
+}
+
+int cmpMarketBySector(const void *a, const void *b) {
+    const MarketView *x = (const MarketView *)a;
+    const MarketView *y = (const MarketView *)b;
+    int cmp = strcasecmp(x->sector, y->sector);
+    if (cmp != 0) return cmp;
+    return strcmp(x->symbol, y->symbol);
+}
+
+// Reads K for the top-K views; 0 if the input is not a positive number
+static int readTopKCount() {
+    int k;
+    printf("How many (K): ");
+    if (scanf("%d", &k) != 1 || k <= 0) {
+        printf("Invalid input.\n");
+        clearInputBuffer();
+        return 0;
+    }
+    clearInputBuffer();
+    return k;
+}
+
+// The k highest (or lowest) priced listed stocks, picked in one lock-free
+// pass over the rows; only the k winners are copied
+static void displayMarketTopK(int rows, int lowest) {
+    int k = readTopKCount();
+    if (k == 0) return;
+    if (k > rows) k = rows;
+    TopKEntry *best = malloc(sizeof(TopKEntry) * k);
+    MarketView *views = malloc(sizeof(MarketView) * k);
+    if (!best || !views) {
+        perror("Error allocating market view");
+        free(best);
+        free(views);
+        return;
+    }
+
+    TopK top = { best, 0, k, lowest };
+    int phase = marketReadBegin();
+    for (int i = 0; i < rows; i++) {
+        MarketQuote quote;
+        if (readMarketQuote(i, &quote) && quote.listed) topKOffer(&top, quote.price, i);
+    }
+    int n = topKFinish(&top);
+    for (int i = 0; i < n; i++) {
+        MarketQuote quote;
+        readMarketQuote(best[i].id, &quote);
+        strcpy(views[i].symbol, quote.symbol);
+        strcpy(views[i].sector, sectorName(quote.sectorId));
+        views[i].price = best[i].key;
+    }
+    marketReadEnd(phase);
+
+    if (n == 0) {
+        printf("No market stocks available.\n");
+    } else {
+        printf("\n----- %s %d Market Stocks by Price -----\n", lowest ? "Bottom" : "Top", n);
+        for (int i = 0; i < n; i++) {
+            printf("%-12s | %-10s | Price: %.2f\n", views[i].symbol, views[i].sector, views[i].price);
+        }
+        printf("---------------------------------\n");
+    }
+    free(best);
+    free(views);
+}
+
+void displayAllMarketStocksInteractive() {
+    int count = 0;
+    int rows = marketVisibleCount();
+    if (rows == 0) {
+        printf("No market stocks available.\n");
+        return;
+    }
+
+    int sortChoice;
+    printf("\nSort market stocks by:\n");
+    printf("1. No sorting\n");
+    printf("2. By price\n");
+    printf("3. By sector\n");
+    printf("4. Top K by price\n");
+    printf("5. Bottom K by price\n");
+    printf("Enter choice: ");
+    if (scanf("%d", &sortChoice) != 1) {
+        printf("Invalid input.\n");
+        clearInputBuffer();
+        return;
+    }
+    clearInputBuffer();
+    if (sortChoice == 4 || sortChoice == 5) {
+        displayMarketTopK(rows, sortChoice == 5);
+        return;
+    }
+
+    MarketView *temp = malloc(sizeof(MarketView) * rows);
+    if (!temp) {
+        perror("Error allocating market view");
+        return;
+    }
+
+    // Copy the rows out lock-free, then sort and print the private copy
+    int phase = marketReadBegin();
+    for (int i = 0; i < rows; i++) {
+        MarketQuote quote;
+        if (readMarketQuote(i, &quote) && quote.listed) {
+            strcpy(temp[count].symbol, quote.symbol);
+            strcpy(temp[count].sector, sectorName(quote.sectorId));
+            temp[count].price = quote.price;
+            count++;
+        }
+    }
+    marketReadEnd(phase);
+
+    if (count == 0) {
+        printf("No market stocks available.\n");
+        free(temp);
+        return;
+    }
+
+    if (sortChoice == 2) {
+        qsort(temp, count, sizeof(MarketView), cmpMarketByPrice);
+    } else if (sortChoice == 3) {
+        qsort(temp, count, sizeof(MarketView), cmpMarketBySector);
+    }
+
+    printf("\n----- Market Stocks -----\n");
+    for (int i = 0; i < count; i++) {
+        printf("%-12s | %-10s | Price: %.2f\n",
+               temp[i].symbol, temp[i].sector, temp[i].price);
+    }
+    printf("---------------------------------\n");
+    free(temp);
+}
+
+int saveMarketToFile(const char *filename) {
+    if (marketLoadIncomplete) {
+        printf("Market file not saved: it was only read up to a malformed line.\n");
+        return 0;
+    }
+    FILE *fp = fopen(filename, "w");
+    if (!fp) {
+        perror("Error opening market file for saving");
+        return 0;
+    }
+
+    for (int i = 0; i < marketCount; i++) {
+        if (marketStatus[i] == OCCUPIED) {
+            fprintf(fp, "%s %s %.10f\n",
+                    marketSymbols[i],
+                    sectorName(marketSectorIds[i]),
+                    marketPrices[i]);
+        }
+    }
+
+    fclose(fp);
+    if (useSnapshots) saveMarketSnapshot(filename);
+    return 1;
+}
+
+// Market snapshot: the row columns, the Robin Hood index, the symbol order
+// and the sector names, so a load is bulk copies with no rehashing or
+// sorting. Sections are ordered by alignment: symbols, prices, index,
+// sector ids, symbol order, status bytes, sector names.
+#define MARKET_SNAPSHOT_ROW_BYTES (MAX_SYMBOL_LEN + sizeof(double) + 2 * sizeof(int) + 1)
+
+static int saveMarketSnapshot(const char *textFile) {
+    char path[256], tmpPath[260];
+    snapshotPathFor(textFile, path, sizeof(path));
+    snprintf(tmpPath, sizeof(tmpPath), "%s.tmp", path);
+
+    FILE *fp = beginSnapshot(tmpPath);
+    if (!fp) return 0;
+    fwrite(marketSymbols, MAX_SYMBOL_LEN, marketCount, fp);
+    fwrite(marketPrices, sizeof(double), marketCount, fp);
+    fwrite(marketIndex, sizeof(MarketSlot), marketIndexCapacity, fp);
+    fwrite(marketSectorIds, sizeof(int), marketCount, fp);
+    fwrite(marketSymbolOrder, sizeof(int), marketCount, fp);
+    fwrite(marketStatus, 1, marketCount, fp);
+    writeSectorNames(fp);
+    return finishSnapshot(fp, tmpPath, path, SNAPSHOT_MARKET, MARKET_SNAPSHOT_ROW_BYTES,
+                          marketCount, marketIndexCapacity, textFile);
+}
+
+static int loadMarketSnapshot(const char *textFile) {
+    char path[256];
+    size_t mapSize;
+    snapshotPathFor(textFile, path, sizeof(path));
+
+    const SnapshotHeader *h = mapSnapshot(path, SNAPSHOT_MARKET, MARKET_SNAPSHOT_ROW_BYTES, &mapSize);
+    if (!h) return 0;
+
+    unsigned long long capacity = (unsigned long long)h->extra;
+    size_t count = (size_t)h->count;
+    // Every section, the per-row ones included, must lie inside the file
+    size_t need = sizeof(*h) + count * (MAX_SYMBOL_LEN + sizeof(double)) + capacity * sizeof(MarketSlot) +
+                  count * (2 * sizeof(int) + 1);
+    int ok = snapshotMatchesText(h, textFile) && capacity <= mapSize / sizeof(MarketSlot) && mapSize >= need &&
+             capacity >= MARKET_INITIAL_CAPACITY && (capacity & (capacity - 1)) == 0 &&
+             (unsigned long long)h->count < capacity;
+    if (ok) {
+        const char *symbols = (const char *)(h + 1);
+        const char *prices = symbols + count * MAX_SYMBOL_LEN;
+        const char *slots = prices + count * sizeof(double);
+        const char *sectorIds = slots + capacity * sizeof(MarketSlot);
+        const char *order = sectorIds + count * sizeof(int);
+        const char *status = order + count * sizeof(int);
+        MarketSlot *index = malloc(sizeof(MarketSlot) * capacity);
+        int *symbolOrder = malloc(sizeof(int) * (count ? count : 1));
+        int sectorCount = 0;
+        int *remap = readSectorNames(status + count, (const char *)h + mapSize, &sectorCount);
+        int valid = index && symbolOrder;
+        if (valid) {
+            // Lookups and prefix search index the rows with these unchecked
+            memcpy(index, slots, sizeof(MarketSlot) * capacity);
+            memcpy(symbolOrder, order, sizeof(int) * count);
+            for (unsigned long long i = 0; valid && i < capacity; i++)
+                valid = index[i].row >= -1 && index[i].row < (int)count;
+            for (size_t i = 0; valid && i < count; i++)
+                valid = symbolOrder[i] >= 0 && symbolOrder[i] < (int)count &&
+                        memchr(symbols + i * MAX_SYMBOL_LEN, '\0', MAX_SYMBOL_LEN) != NULL;
+        }
+        int rowsOk = valid && ((int)count <= marketRowCapacity ||
+                     resizeMarketColumns(count > MARKET_INITIAL_CAPACITY ? (int)count : MARKET_INITIAL_CAPACITY));
+        if (valid && remap && rowsOk) {
+            memcpy(marketSymbols, symbols, count * MAX_SYMBOL_LEN);
+            memcpy(marketPrices, prices, count * sizeof(double));
+            memcpy(marketSectorIds, sectorIds, count * sizeof(int));
+            memcpy(marketStatus, status, count);
+            int longKeys = 0;
+            for (size_t i = 0; i < count; i++) {
+                int id = marketSectorIds[i];
+                marketSectorIds[i] = (id >= 0 && id < sectorCount) ? remap[id] : -1;
+                marketKeys[i] = internSymbolKey(marketSymbols[i]);
+                longKeys |= (marketKeys[i] & SYMBOL_KEY_LONG) != 0 || marketKeys[i] == SYMBOL_KEY_NONE;
+            }
+            free(marketIndex);
+            free(marketSymbolOrder);
+            marketCount = (int)count;
+            marketIndex = index;
+            marketIndexCapacity = (unsigned int)capacity;
+            marketSymbolOrder = symbolOrder;
+            marketSymbolOrderCapacity = count ? (int)count : 1;
+            if (longKeys) {
+                // Long symbol ids are per process, so their slots are stale
+                for (unsigned int i = 0; i < marketIndexCapacity; i++) {
+                    marketIndex[i].key = SYMBOL_KEY_NONE;
+                    marketIndex[i].row = -1;
+                    marketIndex[i].dist = 0;
+                }
+                for (int row = 0; row < marketCount; row++) placeMarketIndexSlot(marketKeys[row], row);
+            }
+        } else {
+            free(index);
+            free(symbolOrder);
+            ok = 0;
+        }
+        free(remap);
+    }
+    munmap((void *)h, mapSize);
+    return ok;
+}
+
+int loadMarketFromFile(const char *filename) {
+    FILE *fp = fopen(filename, "r");
+    if (!fp) {
+        return 0;
+    }
+
+    if (useSnapshots && loadMarketSnapshot(filename)) {
+        fclose(fp);
+        marketLoadIncomplete = 0;
+        rebuildMarketIndexes(0);   // symbol order comes with the snapshot
+        return 1;
+    }
+
+    fclose(fp);
+    initMarketTable();
+
+    void *rows;
+    size_t count;
+    long stopLine;
+    if (!parseTextFileParallel(filename, 0, parseMarketLine, sizeof(MarketTextRow), &rows, &count, &stopLine)) {
+        return 0;
+    }
+    if (stopLine) {
+        // Saving now would drop every line from here on
+        fprintf(stderr, "%s:%ld: malformed market line; stocks after it are not loaded "
+                "and the file will not be overwritten.\n", filename, stopLine);
+    }
+    marketLoadIncomplete = stopLine != 0;
+    const MarketTextRow *m = rows;
+    marketIndexesDeferred = 1;
+    for (size_t i = 0; i < count; i++) {
+        if (upsertMarketStock(m[i].symbol, m[i].sector, m[i].price, NULL) == -1)
+            break;
+    }
+    rebuildMarketIndexes(1);
+    free(rows);
+    return 1;
+}
+
+// ================= HOLDINGS TABLE (User) =================
+
+void initHoldingTable(Account *acct) {
+    for (int i = 0; i < TABLE_SIZE; i++) {
+        acct->holdings[i].status = EMPTY;
+        acct->holdingKeys[i] = SYMBOL_KEY_NONE;
+        acct->holdings[i].symbol[0] = '\0';
+        acct->holdings[i].sectorId = -1;
+        acct->sectorPos[i] = -1;
+        acct->holdings[i].quantity = 0;
+        acct->holdings[i].avgBuyPrice = 0.0;
+        acct->holdings[i].lastBuyTime = TIMESTAMP_NONE;
+    }
+}
+
+// Home slot of a key: fast range reduction of the hash instead of % TABLE_SIZE
+static inline unsigned int holdingHomeSlot(SymbolKey key) {
+    return (unsigned int)(((unsigned long long)symbolKeyHash(key) * TABLE_SIZE) >> 32);
+}
+
+// Lookup by symbol text. A long symbol that was never interned is not
+// held, so this returns -1 for it; callers that insert use
+// findHoldingSlotByKey with internSymbolKey instead.
+int findHoldingSlot(Account *acct, const char *symbol, int *found) {
+    return findHoldingSlotByKey(acct, symbolKey(symbol), found);
+}
+
+// Returns the slot holding key, or (with *found = 0) the slot to insert it
+// in, or -1 if the table is full. Probes only the dense holdingKeys array.
+int findHoldingSlotByKey(Account *acct, SymbolKey key, int *found) {
+    const SymbolKey *keys = acct->holdingKeys;
+    unsigned int pos = holdingHomeSlot(key);
+
+    if (found) *found = 0;
+    if (key == SYMBOL_KEY_NONE) return -1;
+
+    for (int i = 0; i < TABLE_SIZE; i++) {
+        SymbolKey k = keys[pos];
+        if (k == key) {
+            COUNT_PROBES(holdingLookupStats, i + 1, 1);
+            if (found) *found = 1;
+            return pos;
+        }
+        if (k == SYMBOL_KEY_NONE) {
+            COUNT_PROBES(holdingLookupStats, i + 1, 0);
+            return pos;
+        }
+        pos = (pos + 1 < TABLE_SIZE) ? pos + 1 : 0;
+    }
+    COUNT_PROBES(holdingLookupStats, TABLE_SIZE, 0);
+    return -1;
+}
+
+// Slot state changes go through occupyHoldingSlot and removeHoldingSlot so
+// holdingKeys stays in step with the entries' status
+static void occupyHoldingSlot(Account *acct, int slot, SymbolKey key, const char *symbol) {
+    HoldingEntry *h = &acct->holdings[slot];
+    strcpy(h->symbol, symbol);
+    h->status = OCCUPIED;
+    acct->holdingKeys[slot] = key;
+}
+
+// Moves the holding in slot from to the free slot to, together with what is
+// kept per slot: its sector list entry, its aggregate with the market holder
+// reference, and its place in the profit index. With relink = 0 only the
+// entry moves; loads do that and rebuild the rest afterwards.
+static void moveHoldingSlot(Account *acct, int from, int to, int relink) {
+    acct->holdings[to] = acct->holdings[from];
+    acct->holdingKeys[to] = acct->holdingKeys[from];
+    acct->holdings[from].status = EMPTY;
+    acct->holdingKeys[from] = SYMBOL_KEY_NONE;
+    if (!relink) return;
+
+    int pos = acct->sectorPos[from];
+    SectorMembers *list = accountSectorList(acct, acct->holdings[to].sectorId);
+    if (list && pos >= 0 && pos < list->count) list->members[pos] = to;
+    acct->sectorPos[to] = pos;
+    acct->sectorPos[from] = -1;
+
+    HoldingAggregate *a = &acct->aggregates[to];
+    *a = acct->aggregates[from];
+    acct->aggregates[from].tracked = 0;
+    acct->aggregates[from].marketRow = -1;
+    if (a->marketRow >= 0) {
+        marketHolders[a->marketRow].refs[a->holderPos].slot = to;
+        if (a->tracked) {
+            orderIndexRemove(&acct->profitIndex, from);
+            orderIndexSet(&acct->profitIndex, to, a->value - a->cost);
+            orderIndexRemove(&bookLeaderboard, acct->id * TABLE_SIZE + from);
+            orderIndexSet(&bookLeaderboard, acct->id * TABLE_SIZE + to, a->value - a->cost);
+        }
+    }
+}
+
+// Frees a slot whose holding is closed (already out of its sector list and
+// aggregates when relink is set). Backward-shift deletion: each later entry
+// of the probe run moves into the gap if the gap lies between its home slot
+// and where it sits, so no tombstone is left and probe runs stay as short as
+// the live entries make them, however many positions open and close.
+static void removeHoldingSlot(Account *acct, int slot, int relink) {
+    const SymbolKey *keys = acct->holdingKeys;
+    int gap = slot;
+    acct->holdings[gap].status = EMPTY;
+    acct->holdingKeys[gap] = SYMBOL_KEY_NONE;
+
+    for (int pos = gap + 1 < TABLE_SIZE ? gap + 1 : 0; keys[pos] != SYMBOL_KEY_NONE;
+         pos = pos + 1 < TABLE_SIZE ? pos + 1 : 0) {
+        int home = (int)holdingHomeSlot(keys[pos]);
+        int distance = (pos - home + TABLE_SIZE) % TABLE_SIZE;
+        int gapDistance = (gap - home + TABLE_SIZE) % TABLE_SIZE;
+        if (gapDistance < distance) {
+            moveHoldingSlot(acct, pos, gap, relink);
+            gap = pos;
+        }
+    }
+}
+
+// ================= HOLDINGS JOURNAL =================
+// Holdings are persisted as a checkpoint (holdingsFile) plus a journal of
+// per-trade deltas since it ("x.txt" -> "x.delta"). A delta is the slot's
+// complete new state in the holdings line format, with quantity 0 for a
+// closed position, so replaying a delta twice is harmless. After
+// HOLDING_CHECKPOINT_DELTAS records the journal is rotated to "x.delta.old"
+// and a background thread writes a new checkpoint from a copy of the
+// holdings (temp file, fsync, rename), then removes the rotated journal.
+// Startup loads the checkpoint and replays "x.delta.old" and "x.delta".
+
+static void holdingJournalPath(const Account *acct, int rotated, char *out, size_t outSize) {
+    const char *textFile = acct->holdingsFile;
+    size_t len = strlen(textFile);
+    if (len > 4 && strcmp(textFile + len - 4, ".txt") == 0) len -= 4;
+    snprintf(out, outSize, "%.*s.delta%s", (int)len, textFile, rotated ? ".old" : "");
+}
+
+// Keeps at most MAX_OPEN_JOURNALS journal files open across accounts by
+// closing the least recently written one (never one of keep's)
+static void makeRoomForJournal(Account *keep) {
+    if (openJournalCount < MAX_OPEN_JOURNALS) return;
+    Account *oldest = NULL;
+    int oldestIsHoldings = 0;
+    unsigned long long oldestUse = ULLONG_MAX;
+    for (int i = 0; i < accountCount; i++) {
+        Account *acct = accounts[i];
+        if (acct == keep) continue;
+        if (acct->journal && acct->journalUsed < oldestUse) {
+            oldest = acct;
+            oldestIsHoldings = 0;
+            oldestUse = acct->journalUsed;
+        }
+        if (acct->holdingJournal && acct->holdingJournalUsed < oldestUse) {
+            oldest = acct;
+            oldestIsHoldings = 1;
+            oldestUse = acct->holdingJournalUsed;
+        }
+    }
+    if (!oldest) return;
+    if (oldestIsHoldings) closeHoldingJournal(oldest);
+    else closeTransactionJournal(oldest);
+}
+
+int openHoldingJournal(Account *acct) {
+    if (acct->holdingJournal) return 1;
+    makeRoomForJournal(acct);
+    if (!ensureAccountDirectory(acct)) return 0;
+
+    char path[MAX_PATH_LEN + 16];
+    holdingJournalPath(acct, 0, path, sizeof(path));
+    acct->holdingJournal = fopen(path, "a");
+    if (!acct->holdingJournal) {
+        perror("Error opening holdings journal");
+        return 0;
+    }
+    if (journalDeferred) setvbuf(acct->holdingJournal, NULL, _IOFBF, 1 << 16);
+    acct->holdingJournalPending = 0;
+    openJournalCount++;
+    return 1;
+}
+
+// Same commit policy as the transaction journal (journalGroupCommit)
+void syncHoldingJournal(Account *acct) {
+    if (!acct->holdingJournal) return;
+
+    fflush(acct->holdingJournal);
+    if (acct->holdingJournalPending > 0 && journalGroupCommit > 0) {
+        if (fsync(fileno(acct->holdingJournal)) != 0)
+            perror("Error syncing holdings journal");
+    }
+    acct->holdingJournalPending = 0;
+}
+
+void closeHoldingJournal(Account *acct) {
+    if (!acct->holdingJournal) return;
+
+    syncHoldingJournal(acct);
+    fclose(acct->holdingJournal);
+    acct->holdingJournal = NULL;
+    openJournalCount--;
+}
+
+// Copies the occupied slots, with sector names resolved, for a checkpoint
+static int collectHoldingRows(const Account *acct, HoldingTextRow *rows) {
+    int n = 0;
+    for (int i = 0; i < TABLE_SIZE; i++) {
+        const HoldingEntry *h = &acct->holdings[i];
+        if (h->status != OCCUPIED) continue;
+        strcpy(rows[n].symbol, h->symbol);
+        strcpy(rows[n].sector, sectorName(h->sectorId));
+        rows[n].quantity = h->quantity;
+        rows[n].avgBuyPrice = h->avgBuyPrice;
+        rows[n].lastBuyTime = h->lastBuyTime;
+        n++;
+    }
+    return n;
+}
+
+// Writes a checkpoint aside and renames it into place, so a crash leaves
+// either the old checkpoint or the new one
+static int writeHoldingsCheckpoint(const char *path, const HoldingTextRow *rows, int n) {
+    char tmpPath[MAX_PATH_LEN + 8];
+    snprintf(tmpPath, sizeof(tmpPath), "%s.tmp", path);
+    FILE *fp = fopen(tmpPath, "w");
+    if (!fp) {
+        perror("Error opening holdings file for saving");
+        return 0;
+    }
+    for (int i = 0; i < n; i++) {
+        char date[MAX_DATE_LEN];
+        formatTimestamp(rows[i].lastBuyTime, date);
+        fprintf(fp, "%s %s %d %.10f %s\n", rows[i].symbol, rows[i].sector,
+                rows[i].quantity, rows[i].avgBuyPrice, date);
+    }
+    int ok = fflush(fp) == 0 && fsync(fileno(fp)) == 0;
+    if (fclose(fp) != 0) ok = 0;
+    if (ok && rename(tmpPath, path) != 0) ok = 0;
+    if (!ok) {
+        perror("Error writing holdings checkpoint");
+        remove(tmpPath);
+    }
+    return ok;
+}
+
+typedef struct {
+    Account *acct;
+    char path[MAX_PATH_LEN];
+    char rotatedPath[MAX_PATH_LEN + 16];
+    int count;
+    HoldingTextRow rows[TABLE_SIZE];
+} HoldingsCheckpointJob;
+
+static void *holdingsCheckpointMain(void *arg) {
+    HoldingsCheckpointJob *job = arg;
+    // The rotated deltas are only dropped once the checkpoint covers them
+    if (writeHoldingsCheckpoint(job->path, job->rows, job->count))
+        remove(job->rotatedPath);
+    atomic_store(&job->acct->checkpointFinished, 1);
+    free(job);
+    return NULL;
+}
+
+// Waits for the account's background checkpoint, if one is running
+void finishHoldingsCheckpoint(Account *acct) {
+    if (!acct->checkpointRunning) return;
+    pthread_join(acct->checkpointThread, NULL);
+    acct->checkpointRunning = 0;
+}
+
+// Rotates the journal and checkpoints in the background. Falls back to a
+// foreground save if the previous rotation was never checkpointed.
+static void startHoldingsCheckpoint(Account *acct) {
+    if (acct->checkpointRunning) {
+        if (!atomic_load(&acct->checkpointFinished)) return;   // try again later
+        finishHoldingsCheckpoint(acct);
+    }
+
+    HoldingsCheckpointJob *job = malloc(sizeof(HoldingsCheckpointJob));
+    if (!job) {
+        saveHoldingsToFile(acct);
+        return;
+    }
+    job->acct = acct;
+    strcpy(job->path, acct->holdingsFile);
+    holdingJournalPath(acct, 1, job->rotatedPath, sizeof(job->rotatedPath));
+    if (access(job->rotatedPath, F_OK) == 0) {
+        free(job);
+        saveHoldingsToFile(acct);
+        return;
+    }
+
+    char path[MAX_PATH_LEN + 16];
+    holdingJournalPath(acct, 0, path, sizeof(path));
+    closeHoldingJournal(acct);
+    if (rename(path, job->rotatedPath) != 0) {
+        free(job);
+        saveHoldingsToFile(acct);
+        return;
+    }
+    job->count = collectHoldingRows(acct, job->rows);
+    acct->holdingDeltas = 0;
+    acct->dirty = 0;
+
+    atomic_store(&acct->checkpointFinished, 0);
+    if (pthread_create(&acct->checkpointThread, NULL, holdingsCheckpointMain, job) != 0) {
+        holdingsCheckpointMain(job);   // checkpoint inline instead
+        return;
+    }
+    acct->checkpointRunning = 1;
+}
+
+// Journals one slot's new state after a buy or sell
+void recordHoldingChange(Account *acct, int slot) {
+    const HoldingEntry *h = &acct->holdings[slot];
+    acct->dirty = 1;
+    if (!openHoldingJournal(acct)) return;
+    acct->holdingJournalUsed = ++journalClock;
+
+    char date[MAX_DATE_LEN];
+    formatTimestamp(h->lastBuyTime, date);
+    fprintf(acct->holdingJournal, "%s %s %d %.10f %s\n", h->symbol, sectorName(h->sectorId),
+            h->status == OCCUPIED ? h->quantity : 0, h->avgBuyPrice, date);
+    acct->holdingJournalPending++;
+    acct->holdingDeltas++;
+    if (!journalDeferred) {
+        fflush(acct->holdingJournal);
+        if (journalGroupCommit > 0 && acct->holdingJournalPending >= journalGroupCommit)
+            syncHoldingJournal(acct);
+    }
+    if (acct->holdingDeltas >= HOLDING_CHECKPOINT_DELTAS) startHoldingsCheckpoint(acct);
+}
+
+// Applies the deltas in one journal file; returns the number applied. A
+// record counts only with its newline, so a torn final write is ignored.
+static int replayHoldingJournal(Account *acct, const char *path) {
+    FILE *fp = fopen(path, "r");
+    if (!fp) return 0;
+
+    char line[256];
+    int applied = 0;
+    while (fgets(line, sizeof(line), fp)) {
+        size_t len = strlen(line);
+        HoldingTextRow r;
+        if (line[len - 1] != '\n' || !parseHoldingLine(line, line + len - 1, &r)) break;
+
+        int found = 0;
+        SymbolKey key = internSymbolKey(r.symbol);
+        int slot = findHoldingSlotByKey(acct, key, &found);
+        if (slot == -1) continue;
+        HoldingEntry *h = &acct->holdings[slot];
+        if (r.quantity > 0) {
+            occupyHoldingSlot(acct, slot, key, r.symbol);
+            h->sectorId = internSector(r.sector);
+            h->quantity = r.quantity;
+            h->avgBuyPrice = r.avgBuyPrice;
+            h->lastBuyTime = r.lastBuyTime;
+        } else if (found) {
+            removeHoldingSlot(acct, slot, 0);   // aggregates are rebuilt after replay
+        }
+        applied++;
+    }
+    fclose(fp);
+    return applied;
+}
+
+// ================= PORTFOLIO AGGREGATES =================
+// Running totals per account, updated by the slot that changed instead of
+// re-summing the table. Each slot remembers the cost and value it last
+// contributed, so an update subtracts the old numbers and adds the new ones.
+// A holding and the market row it is priced against are linked both ways:
+// every market row lists its holders across all accounts, so a price change
+// reaches exactly those holdings without a hash lookup. Subtracting and
+// adding doubles leaves rounding error behind, so every
+// TOTALS_RESUM_INTERVAL updates the sums are re-derived from the slots;
+// the error never grows past that many updates' worth.
+
+static void addMarketHolder(int row, Account *acct, int slot) {
+    MarketHolders *h = &marketHolders[row];
+    if (h->count == h->capacity) {
+        int newCapacity = h->capacity ? h->capacity * 2 : 2;
+        HolderRef *refs = realloc(h->refs, sizeof(HolderRef) * newCapacity);
+        if (!refs) {
+            perror("Error growing holder list");
+            acct->aggregates[slot].marketRow = -1;
+            return;
+        }
+        h->refs = refs;
+        h->capacity = newCapacity;
+    }
+    acct->aggregates[slot].holderPos = h->count;
+    h->refs[h->count].account = acct->id;
+    h->refs[h->count].slot = slot;
+    h->count++;
+}
+
+// Swap-with-last removal; the moved holder's position is patched
+static void removeMarketHolder(int row, Account *acct, int slot) {
+    MarketHolders *h = &marketHolders[row];
+    int pos = acct->aggregates[slot].holderPos;
+    HolderRef last = h->refs[--h->count];
+    if (pos < h->count) {
+        h->refs[pos] = last;
+        accounts[last.account]->aggregates[last.slot].holderPos = pos;
+    }
+}
+
+static void untrackHoldingAggregate(Account *acct, int slot) {
+    HoldingAggregate *a = &acct->aggregates[slot];
+    PortfolioTotals *t = &acct->totals;
+    if (!a->tracked) return;
+    t->holdings--;
+    t->investment -= a->cost;
+    if (a->marketRow >= 0) {
+        t->pricedHoldings--;
+        t->pricedInvestment -= a->cost;
+        t->currentValue -= a->value;
+        orderIndexRemove(&acct->profitIndex, slot);
+        orderIndexRemove(&bookLeaderboard, acct->id * TABLE_SIZE + slot);
+    }
+    a->tracked = 0;
+}
+
+// Re-sums the totals from what each slot contributed
+static void resumPortfolioTotals(Account *acct) {
+    PortfolioTotals *t = &acct->totals;
+    t->investment = t->pricedInvestment = t->currentValue = 0;
+    for (int slot = 0; slot < TABLE_SIZE; slot++) {
+        const HoldingAggregate *a = &acct->aggregates[slot];
+        if (!a->tracked) continue;
+        t->investment += a->cost;
+        if (a->marketRow >= 0) {
+            t->pricedInvestment += a->cost;
+            t->currentValue += a->value;
+        }
+    }
+    t->updates = 0;
+}
+
+static void trackHoldingAggregate(Account *acct, int slot) {
+    HoldingAggregate *a = &acct->aggregates[slot];
+    PortfolioTotals *t = &acct->totals;
+    const HoldingEntry *h = &acct->holdings[slot];
+    a->cost = h->avgBuyPrice * h->quantity;
+    a->value = a->marketRow >= 0 ? marketPrices[a->marketRow] * h->quantity : 0;
+    a->tracked = 1;
+    t->holdings++;
+    t->investment += a->cost;
+    if (a->marketRow >= 0) {
+        t->pricedHoldings++;
+        t->pricedInvestment += a->cost;
+        t->currentValue += a->value;
+        orderIndexSet(&acct->profitIndex, slot, a->value - a->cost);
+        orderIndexSet(&bookLeaderboard, acct->id * TABLE_SIZE + slot, a->value - a->cost);
+    }
+    if (++t->updates >= TOTALS_RESUM_INTERVAL) resumPortfolioTotals(acct);
+}
+
+// Re-applies one holding slot after a buy or sell; O(log n)
+void refreshHoldingAggregate(Account *acct, int slot) {
+    HoldingAggregate *a = &acct->aggregates[slot];
+    int wasTracked = a->tracked;
+    untrackHoldingAggregate(acct, slot);
+
+    if (acct->holdings[slot].status != OCCUPIED) {
+        if (a->marketRow >= 0) removeMarketHolder(a->marketRow, acct, slot);
+        a->marketRow = -1;
+        return;
+    }
+    if (!wasTracked) {
+        // New position: find its market row once
+        a->marketRow = findMarketRowByKey(acct->holdingKeys[slot]);
+        if (a->marketRow >= 0) addMarketHolder(a->marketRow, acct, slot);
+    }
+    trackHoldingAggregate(acct, slot);
+}
+
+// Called after a market row's price changes, or after the row is added
+void marketPriceChanged(int row, int isNew) {
+    if (isNew) {
+        // A new listing can price holdings that had no market row yet
+        marketHolders[row].count = 0;
+        for (int i = 0; i < accountCount; i++) {
+            Account *acct = accounts[i];
+            int found = 0;
+            int slot = findHoldingSlotByKey(acct, marketKeys[row], &found);
+            if (!found || !acct->aggregates[slot].tracked) continue;
+            untrackHoldingAggregate(acct, slot);
+            acct->aggregates[slot].marketRow = row;
+            addMarketHolder(row, acct, slot);
+            trackHoldingAggregate(acct, slot);
+        }
+        return;
+    }
+    const MarketHolders *h = &marketHolders[row];
+    for (int i = 0; i < h->count; i++) {
+        Account *acct = accounts[h->refs[i].account];
+        untrackHoldingAggregate(acct, h->refs[i].slot);
+        trackHoldingAggregate(acct, h->refs[i].slot);
+    }
+}
+
+// Recomputes one account's aggregates after its holdings were reloaded
+void rebuildAccountAggregates(Account *acct) {
+    memset(&acct->totals, 0, sizeof(acct->totals));
+    orderIndexBuild(&acct->profitIndex, NULL, NULL, 0);
+
+    for (int slot = 0; slot < TABLE_SIZE; slot++) {
+        HoldingAggregate *a = &acct->aggregates[slot];
+        if (a->marketRow >= 0) removeMarketHolder(a->marketRow, acct, slot);
+        orderIndexRemove(&bookLeaderboard, acct->id * TABLE_SIZE + slot);
+        a->tracked = 0;
+        a->marketRow = -1;
+        if (acct->holdings[slot].status != OCCUPIED) continue;
+
+        a->marketRow = findMarketRowByKey(acct->holdingKeys[slot]);
+        if (a->marketRow >= 0) addMarketHolder(a->marketRow, acct, slot);
+        trackHoldingAggregate(acct, slot);
+    }
+}
+
+// Recomputes every aggregate from the tables; used after bulk loads
+void rebuildPortfolioAggregates() {
+    // Market rows may have been renumbered, so every link starts over
+    for (int row = 0; row < marketCount; row++) marketHolders[row].count = 0;
+    for (int i = 0; i < accountCount; i++) {
+        for (int slot = 0; slot < TABLE_SIZE; slot++) accounts[i]->aggregates[slot].marketRow = -1;
+        rebuildAccountAggregates(accounts[i]);
+    }
+}
+
+// Best (highest profit) and worst priced holding slots, or -1 if none
+int bestHoldingSlot(Account *acct) {
+    int n = orderIndexCount(&acct->profitIndex);
+    return n > 0 ? orderIndexSelect(&acct->profitIndex, n - 1) : -1;
+}
+
+int worstHoldingSlot(Account *acct) {
+    return orderIndexCount(&acct->profitIndex) > 0 ? orderIndexSelect(&acct->profitIndex, 0) : -1;
+}
+
+static void printLeaderboardRow(int rank, int id) {
+    const Account *acct = accounts[id / TABLE_SIZE];
+    const HoldingEntry *h = &acct->holdings[id % TABLE_SIZE];
+    printf("%4d | %-20s | %-12s | %5d | %11.2f\n", rank, acct->name, h->symbol, h->quantity,
+           bookLeaderboard.key[id]);
+}
+
+// The k most profitable and k most losing priced holdings across all
+// accounts; a holding at a profit is never listed as a loser, nor the other
+// way round. bookLeaderboard follows every trade and price tick, so this is
+// k selections, O(k log n), however many holdings there are.
+void showLeaderboard(int k) {
+    int n = orderIndexCount(&bookLeaderboard);
+    int losers = orderIndexRank(&bookLeaderboard, 0, 0);
+    int gainers = n - orderIndexRank(&bookLeaderboard, 0, 1);
+    printf("\n----- Leaderboard (%d priced holdings, %d accounts) -----\n", n, accountCount);
+    if (n == 0) {
+        printf("No priced holdings.\n");
+        return;
+    }
+    printf("Rank | %-20s | %-12s | Qty   | TotalProfit\n", "Account", "Symbol");
+    printf("Top gainers:\n");
+    if (gainers == 0) printf("None.\n");
+    for (int i = 0; i < k && i < gainers; i++) printLeaderboardRow(i + 1, orderIndexSelect(&bookLeaderboard, n - 1 - i));
+    printf("Top losers:\n");
+    if (losers == 0) printf("None.\n");
+    for (int i = 0; i < k && i < losers; i++) printLeaderboardRow(i + 1, orderIndexSelect(&bookLeaderboard, i));
+}
+
+void showLeaderboardInteractive() {
+    int k = readTopKCount();
+    if (k > 0) showLeaderboard(k);
+}
+
+// ================= TRANSACTION FUNCTIONS =================
+
+void initTransactionHistory(Account *acct) {
+    for (int i = 0; i < acct->transactionChunkCount; i++) {
+        free(acct->transactionChunks[i]);
+    }
+    acct->transactionChunkCount = 0;
+    acct->transactionCount = 0;
+    acct->transactionBase = 0;
+    acct->journalMarkCount = 0;
+    resetHistoryIndex(&acct->historyIndex);
+    resetLotBook(&acct->lots);
+}
+
+// Returns the record at a global history index, or NULL if it is out of
+// range or has been evicted from the in-memory window.
+TransactionEntry *getTransaction(Account *acct, int index) {
+    if (index < acct->transactionBase || index >= acct->transactionCount)
+        return NULL;
+    int offset = index - acct->transactionBase;
+    return &acct->transactionChunks[offset / TRANSACTION_CHUNK_SIZE][offset % TRANSACTION_CHUNK_SIZE];
+}
+
+// Drops the oldest chunk once the window is exceeded by a whole chunk, so the
+// in-memory history stays between historyWindow and historyWindow + chunk.
+static void evictOldTransactionChunks(Account *acct) {
+    while (historyWindow > 0 && acct->transactionChunkCount > 1 &&
+           acct->transactionCount - acct->transactionBase - TRANSACTION_CHUNK_SIZE >= historyWindow) {
+        free(acct->transactionChunks[0]);
+        memmove(acct->transactionChunks, acct->transactionChunks + 1,
+                sizeof(TransactionEntry *) * (acct->transactionChunkCount - 1));
+        acct->transactionChunkCount--;
+        acct->transactionBase += TRANSACTION_CHUNK_SIZE;
+    }
+}
+
+// Returns the slot for the next record, starting a new chunk when needed
+static TransactionEntry *nextTransactionSlot(Account *acct) {
+    int offset = acct->transactionCount - acct->transactionBase;
+
+    if (offset == acct->transactionChunkCount * TRANSACTION_CHUNK_SIZE) {
+        // Current chunk is full (or none yet): start a new one
+        if (acct->transactionChunkCount == acct->transactionChunkCapacity) {
+            int newCapacity = acct->transactionChunkCapacity ? acct->transactionChunkCapacity * 2 : 16;
+            TransactionEntry **dir = realloc(acct->transactionChunks, sizeof(TransactionEntry *) * newCapacity);
+            if (!dir) {
+                perror("Error growing transaction history");
+                return NULL;
+            }
+            acct->transactionChunks = dir;
+            acct->transactionChunkCapacity = newCapacity;
+        }
+        TransactionEntry *chunk = malloc(sizeof(TransactionEntry) * TRANSACTION_CHUNK_SIZE);
+        if (!chunk) {
+            perror("Error allocating transaction chunk");
+            return NULL;
+        }
+        acct->transactionChunks[acct->transactionChunkCount++] = chunk;
+    }
+
+    return &acct->transactionChunks[offset / TRANSACTION_CHUNK_SIZE][offset % TRANSACTION_CHUNK_SIZE];
+}
+
+void addTransaction(Account *acct, const char *symbol, int quantity, double price, Timestamp time, int type, int relief) {
+    TransactionEntry *t = nextTransactionSlot(acct);
+    if (!t) return;
+
+    strcpy(t->symbol, symbol);
+    t->quantity = quantity;
+    t->pricePerShare = price;
+    t->time = time;
+    t->type = type;
+    t->relief = relief;
+    indexTransactions(&acct->historyIndex, t, 1);
+    applyLotRecords(&acct->lots, acct->transactionCount, t, 1);
+    acct->transactionCount++;
+
+    evictOldTransactionChunks(acct);
+}
+
+// Bulk append of ready-made records, one memcpy per chunk
+static void appendTransactionRecords(Account *acct, const TransactionEntry *records, int n) {
+    while (n > 0) {
+        TransactionEntry *t = nextTransactionSlot(acct);
+        if (!t) return;
+
+        int room = TRANSACTION_CHUNK_SIZE - (acct->transactionCount - acct->transactionBase) % TRANSACTION_CHUNK_SIZE;
+        int copy = n < room ? n : room;
+        memcpy(t, records, sizeof(TransactionEntry) * copy);
+        indexTransactions(&acct->historyIndex, records, copy);
+        applyLotRecords(&acct->lots, acct->transactionCount, records, copy);
+        acct->transactionCount += copy;
+        records += copy;
+        n -= copy;
+        evictOldTransactionChunks(acct);
+    }
+}
+
+// Reads one journal record; 0 at the end of the file or a malformed line.
+// Lines are read whole, since sells may end with an optional relief.
+static int readTransactionText(FILE *fp, TransactionEntry *t) {
+    char line[256];
+    while (fgets(line, sizeof(line), fp)) {
+        const char *end = line + strcspn(line, "\n");
+        if (skipFieldSpace(line, end) == end) continue;   // blank lines are skipped
+        return parseTransactionLine(line, end, t);
+    }
+    return 0;
+}
+
+// Appends the relief of a sell that did not use the average cost
+static void writeReliefText(FILE *fp, int type, int relief) {
+    if (type != 1 || relief == RELIEF_AVERAGE) return;
+    if (relief >= 0) fprintf(fp, " %d", relief);
+    else fprintf(fp, " %s", relief == RELIEF_FIFO ? "FIFO" : "LIFO");
+}
+
+// Streams the records that were evicted from memory back from the journal
+static int readEvictedTransactions(Account *acct, void (*visit)(const TransactionEntry *t, void *ctx), void *ctx) {
+    if (acct->transactionBase == 0) return 1;
+
+    // Deferred journal records must reach the file before it is read back
+    if (acct->journal) fflush(acct->journal);
+
+    FILE *fp = fopen(acct->transactionFile, "r");
+    if (!fp) {
+        perror("Error opening transaction file for reading");
+        return 0;
+    }
+
+    TransactionEntry t;
+    int read = 0;
+    while (read < acct->transactionBase && readTransactionText(fp, &t)) {
+        visit(&t, ctx);
+        read++;
+    }
+    fclose(fp);
+    return read == acct->transactionBase;
+}
+
+static void writeTransactionLine(const TransactionEntry *t, void *ctx) {
+    char date[MAX_DATE_LEN];
+    formatTimestamp(t->time, date);
+    fprintf((FILE *)ctx, "%s %d %.10f %s %d",
+            t->symbol, t->quantity, t->pricePerShare, date, t->type);
+    writeReliefText((FILE *)ctx, t->type, t->relief);
+    fputc('\n', (FILE *)ctx);
+}
+
+static void printTransactionRow(const TransactionEntry *t, void *ctx) {
+    (void)ctx;
+    char date[MAX_DATE_LEN];
+    formatTimestamp(t->time, date);
+    printf("%-12s | %-5s | %3d | %11.2f | %s\n",
+           t->symbol,
+           t->type == 0 ? "BUY" : "SELL",
+           t->quantity,
+           t->pricePerShare,
+           date);
+}
+
+int saveTransactionsToFile(Account *acct, const char *filename) {
+    FILE *fp = fopen(filename, "w");
+    if (!fp) {
+        perror("Error opening transaction file for saving");
+        return 0;
+    }
+
+    // Records outside the in-memory window come from the current journal
+    if (!readEvictedTransactions(acct, writeTransactionLine, fp)) {
+        fclose(fp);
+        return 0;
+    }
+    for (int i = acct->transactionBase; i < acct->transactionCount; i++) {
+        writeTransactionLine(getTransaction(acct, i), fp);
+    }
+
+    if (fclose(fp) != 0) {
+        perror("Error writing transaction file");
+        return 0;
+    }
+    return 1;
+}
+
+// ---------- Transaction Journal ----------
+
+// Journals are opened on first use. With many accounts only
+// MAX_OPEN_JOURNALS stay open (see makeRoomForJournal); past that the least
+// recently written one is synced and closed, and reopens on its next trade.
+int openTransactionJournal(Account *acct) {
+    if (acct->journal) return 1;
+    makeRoomForJournal(acct);
+    if (!ensureAccountDirectory(acct)) return 0;
+    acct->journal = fopen(acct->transactionFile, "a");
+    if (!acct->journal) {
+        perror("Error opening transaction journal");
+        return 0;
+    }
+    if (journalDeferred) setvbuf(acct->journal, NULL, _IOFBF, 1 << 20);
+    acct->journalPending = 0;
+    openJournalCount++;
+    return 1;
+}
+
+// Appends one record in the same format as saveTransactionsToFile, so the
+// journal is always a valid transactions file.
+void appendTransactionToJournal(Account *acct, const char *symbol, int quantity, double price, Timestamp time, int type, int relief) {
+    if (!acct->journal && !openTransactionJournal(acct)) return;
+    acct->journalUsed = ++journalClock;
+
+    char date[MAX_DATE_LEN];
+    formatTimestamp(time, date);
+    fprintf(acct->journal, "%s %d %.10f %s %d",
+            symbol, quantity, price, date, type);
+    writeReliefText(acct->journal, type, relief);
+    fputc('\n', acct->journal);
+    acct->journalPending++;
+    if (journalDeferred) return;
+
+    fflush(acct->journal);
+    if (journalGroupCommit > 0 && acct->journalPending >= journalGroupCommit) {
+        syncTransactionJournal(acct);
+    }
+}
+
+// Group commit: one fsync covers every record appended since the last one
+void syncTransactionJournal(Account *acct) {
+    if (!acct->journal) return;
+
+    fflush(acct->journal);
+    if (acct->journalPending > 0 && journalGroupCommit > 0) {
+        if (fsync(fileno(acct->journal)) != 0)
+            perror("Error syncing transaction journal");
+    }
+    acct->journalPending = 0;
+}
+
+void closeTransactionJournal(Account *acct) {
+    if (!acct->journal) return;
+
+    syncTransactionJournal(acct);
+    fclose(acct->journal);
+    acct->journal = NULL;
+    openJournalCount--;
+}
+
+// Explicit compaction: the only place the transaction file is fully rewritten.
+// Evicted history is copied from the old file before it is replaced.
+// The new file is written aside and renamed over the journal atomically.
+int compactTransactionJournal(Account *acct) {
+    char tmpPath[MAX_PATH_LEN + 4];
+    snprintf(tmpPath, sizeof(tmpPath), "%s.tmp", acct->transactionFile);
+    int reopen = (acct->journal != NULL);
+    closeTransactionJournal(acct);
+
+    int ok = ensureAccountDirectory(acct) && saveTransactionsToFile(acct, tmpPath);
+    if (ok && rename(tmpPath, acct->transactionFile) != 0) {
+        perror("Error replacing transaction file");
+        ok = 0;
+    }
+    if (!ok) remove(tmpPath);
+    acct->journalMarkCount = 0;   // the records moved
+
+    if (reopen) openTransactionJournal(acct);
+
+    // The rewritten file may differ byte-wise, so the snapshot starts over
+    if (ok && useSnapshots) {
+        acct->transactionSnapshotCount = -1;
+        saveTransactionSnapshot(acct);
+    }
+    return ok;
+}
+
+// ---------- Transaction Snapshot ----------
+// transactions.bin holds the records of a prefix of the journal and the
+// journal size at that point. Because the journal is append-only, a load maps
+// the snapshot, bulk-copies the records and parses only the text tail.
+
+static void writeTransactionRecord(const TransactionEntry *t, void *ctx) {
+    fwrite(t, sizeof(TransactionEntry), 1, (FILE *)ctx);
+}
+
+int saveTransactionSnapshot(Account *acct) {
+    char path[256], tmpPath[260];
+    snapshotPathFor(acct->transactionFile, path, sizeof(path));
+    if (acct->journal) fflush(acct->journal);
+
+    if (acct->transactionSnapshotCount >= acct->transactionBase && acct->transactionSnapshotCount <= acct->transactionCount) {
+        // Fast path: append the records added since the snapshot, then the header
+        FILE *fp = fopen(path, "r+b");
+        if (fp && fseek(fp, sizeof(SnapshotHeader) + (long)acct->transactionSnapshotCount * sizeof(TransactionEntry), SEEK_SET) == 0) {
+            for (int i = acct->transactionSnapshotCount; i < acct->transactionCount; i++) {
+                writeTransactionRecord(getTransaction(acct, i), fp);
+            }
+            fflush(fp);
+            if (fsync(fileno(fp)) == 0 &&
+                finishSnapshot(fp, path, path, SNAPSHOT_TRANSACTIONS, sizeof(TransactionEntry),
+                               acct->transactionCount, 0, acct->transactionFile)) {
+                acct->transactionSnapshotCount = acct->transactionCount;
+                return 1;
+            }
+            fp = NULL;
+        }
+        if (fp) fclose(fp);
+    }
+
+    // Full rewrite; evicted history is streamed back from the journal
+    snprintf(tmpPath, sizeof(tmpPath), "%s.tmp", path);
+    FILE *fp = beginSnapshot(tmpPath);
+    if (!fp) return 0;
+    if (!readEvictedTransactions(acct, writeTransactionRecord, fp)) {
+        fclose(fp);
+        remove(tmpPath);
+        return 0;
+    }
+    for (int i = acct->transactionBase; i < acct->transactionCount; i++) {
+        writeTransactionRecord(getTransaction(acct, i), fp);
+    }
+    if (!finishSnapshot(fp, tmpPath, path, SNAPSHOT_TRANSACTIONS, sizeof(TransactionEntry),
+                        acct->transactionCount, 0, acct->transactionFile)) {
+        acct->transactionSnapshotCount = -1;
+        return 0;
+    }
+    acct->transactionSnapshotCount = acct->transactionCount;
+    return 1;
+}
+
+// Maps the transaction snapshot of textFile if it still holds a prefix of
+// the journal; NULL if it cannot be used
+static const SnapshotHeader *mapTransactionSnapshot(const char *textFile, size_t *mapSize) {
+    char path[256];
+    long long size, mtimeNs, inode;
+    snapshotPathFor(textFile, path, sizeof(path));
+    if (!statTextFile(textFile, &size, &mtimeNs, &inode)) return NULL;
+
+    const SnapshotHeader *h = mapSnapshot(path, SNAPSHOT_TRANSACTIONS, sizeof(TransactionEntry), mapSize);
+    if (!h) return NULL;
+
+    // The same journal may only have grown since; same size means unchanged
+    int ok = h->count <= 0x7fffffff && h->sourceInode == inode &&
+             (size > h->sourceSize || (size == h->sourceSize && mtimeNs == h->sourceMtimeNs));
+    if (ok && size > h->sourceSize) {
+        // ... and only by appends, so the prefix it covers is still the same
+        unsigned long long sum;
+        ok = prefixChecksum(textFile, h->sourceSize, &sum) && sum == h->sourceChecksum;
+    }
+    if (!ok) {
+        munmap((void *)h, *mapSize);
+        return NULL;
+    }
+    return h;
+}
+
+// Loads the snapshot records (respecting historyWindow) and returns the
+// journal offset to resume text parsing from, or -1 if it cannot be used.
+static long loadTransactionSnapshot(Account *acct) {
+    size_t mapSize;
+    const SnapshotHeader *h = mapTransactionSnapshot(acct->transactionFile, &mapSize);
+    if (!h) return -1;
+
+    const TransactionEntry *records = (const TransactionEntry *)(h + 1);
+    int count = (int)h->count;
+    int start = (historyWindow > 0 && count > historyWindow) ? count - historyWindow : 0;
+
+    initTransactionHistory(acct);
+    indexTransactions(&acct->historyIndex, records, start);   // outside the window too
+    applyLotRecords(&acct->lots, 0, records, start);
+    acct->transactionBase = acct->transactionCount = start;
+    appendTransactionRecords(acct, records + start, count - start);
+    acct->transactionSnapshotCount = count;
+    long offset = (long)h->sourceSize;
+    munmap((void *)h, mapSize);
+    return offset;
+}
+
+void loadTransactionsFromFile(Account *acct) {
+    const char *filename = acct->transactionFile;
+    FILE *fp = fopen(filename, "r");
+    if (!fp) {
+        return;
+    }
+
+    fclose(fp);
+
+    initTransactionHistory(acct);
+    acct->transactionSnapshotCount = -1;
+    long offset = 0;
+    if (useSnapshots) {
+        offset = loadTransactionSnapshot(acct);
+        if (offset < 0) offset = 0;
+    }
+
+    void *rows;
+    size_t count;
+    if (parseTextFileParallel(filename, offset, parseTransactionLine, sizeof(TransactionEntry), &rows, &count, NULL)) {
+        appendTransactionRecords(acct, rows, (int)count);
+        free(rows);
+    }
+}
+
+void viewTransactionHistory() {
+    Account *acct = activeAccount;
+    printf("\n----- Transaction History (%s) -----\n", acct->name);
+    
+    if (acct->transactionCount == 0) {
+        printf("No transaction history found.\n");
+        return;
+    }
+    
+    printf("%-12s | Type  | Qty | Price/Share | Date/Time\n", "Symbol");
+    printf("---------------------------------------------------------\n");
+    
+    // Older records beyond the in-memory window are streamed from disk
+    readEvictedTransactions(acct, printTransactionRow, NULL);
+    for (int i = acct->transactionBase; i < acct->transactionCount; i++) {
+        printTransactionRow(getTransaction(acct, i), NULL);
+    }
+}
+
+// ================= HISTORY INDEX =================
+// Every account indexes its whole transaction history, evicted records
+// included: each record's timestamp, one list of records in time order and
+// one posting list per symbol, each also kept split by side so a buy/sell
+// filter is a range in its own list. Trades append to the lists; a list is
+// sorted only when a query finds a record was added out of time order, which
+// the usual in-order journal never does. A query binary-searches its date
+// range in the symbol's list (or the time list) for the side it asks for
+// (or either) and reads back just the page
+// it shows, so its cost follows the result, not the history length. Records
+// outside the in-memory window are read from the transaction snapshot by
+// position, or failing that from the journal, which remembers the offset of
+// every JOURNAL_MARK_STRIDE-th record it passes.
+
+#define JOURNAL_MARK_STRIDE 256   // records between remembered journal offsets
+
+static int historyListAdd(HistoryList *list, const Timestamp *times, int record) {
+    if (list->count == list->capacity) {
+        int newCapacity = list->capacity ? list->capacity * 2 : 16;
+        int *records = realloc(list->records, sizeof(int) * newCapacity);
+        if (!records) {
+            perror("Error growing history index");
+            return 0;
+        }
+        list->records = records;
+        list->capacity = newCapacity;
+    }
+    if (list->count > 0 && times[record] < times[list->records[list->count - 1]]) list->unsorted = 1;
+    list->records[list->count++] = record;
+    return 1;
+}
+
+static const Timestamp *historySortTimes;   // context for cmpHistoryRecords
+
+static int cmpHistoryRecords(const void *a, const void *b) {
+    int x = *(const int *)a, y = *(const int *)b;
+    Timestamp tx = historySortTimes[x], ty = historySortTimes[y];
+    if (tx != ty) return tx < ty ? -1 : 1;
+    return (x > y) - (x < y);
+}
+
+static void sortHistoryList(HistoryList *list, const Timestamp *times) {
+    if (!list->unsorted) return;
+    historySortTimes = times;
+    qsort(list->records, list->count, sizeof(int), cmpHistoryRecords);
+    list->unsorted = 0;
+}
+
+// Number of records in a sorted list before time (or up to and including
+// it with inclusive)
+static int historyRank(const HistoryList *list, const Timestamp *times, Timestamp time, int inclusive) {
+    int lo = 0, hi = list->count;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        Timestamp t = times[list->records[mid]];
+        if (t < time || (inclusive && t == time)) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+// The posting lists of key; with create they are added if missing. NULL if
+// the symbol has none (or the table cannot grow).
+static HistorySymbol *historySymbol(HistoryIndex *hi, SymbolKey key, int create) {
+    if (key == SYMBOL_KEY_NONE) return NULL;
+    if (create && (hi->symbolCount + 1) * 2 > hi->symbolCapacity) {
+        int newCapacity = hi->symbolCapacity ? hi->symbolCapacity * 2 : 64;
+        HistorySymbol *symbols = calloc(newCapacity, sizeof(HistorySymbol));
+        if (!symbols) {
+            perror("Error growing history index");
+            return NULL;
+        }
+        for (int i = 0; i < hi->symbolCapacity; i++) {
+            if (hi->symbols[i].key == SYMBOL_KEY_NONE) continue;
+            unsigned int pos = symbolKeyHash(hi->symbols[i].key) & (newCapacity - 1);
+            while (symbols[pos].key != SYMBOL_KEY_NONE) pos = (pos + 1) & (newCapacity - 1);
+            symbols[pos] = hi->symbols[i];
+        }
+        free(hi->symbols);
+        hi->symbols = symbols;
+        hi->symbolCapacity = newCapacity;
+    }
+    if (hi->symbolCapacity == 0) return NULL;
+
+    unsigned int mask = hi->symbolCapacity - 1;
+    for (unsigned int pos = symbolKeyHash(key) & mask;; pos = (pos + 1) & mask) {
+        HistorySymbol *entry = &hi->symbols[pos];
+        if (entry->key == key) return entry;
+        if (entry->key == SYMBOL_KEY_NONE) {
+            if (!create) return NULL;
+            entry->key = key;
+            hi->symbolCount++;
+            return entry;
+        }
+    }
+}
+
+static void clearHistoryList(HistoryList *list) {
+    list->count = 0;
+    list->unsorted = 0;
+}
+
+// Empties the index but keeps its memory and symbols for the reload
+void resetHistoryIndex(HistoryIndex *hi) {
+    hi->count = 0;
+    hi->failed = 0;
+    clearHistoryList(&hi->byTime);
+    clearHistoryList(&hi->bySide[0]);
+    clearHistoryList(&hi->bySide[1]);
+    for (int i = 0; i < hi->symbolCapacity; i++) {
+        clearHistoryList(&hi->symbols[i].list);
+        clearHistoryList(&hi->symbols[i].sides[0]);
+        clearHistoryList(&hi->symbols[i].sides[1]);
+    }
+}
+
+// Indexes n records that follow the ones already indexed
+void indexTransactions(HistoryIndex *hi, const TransactionEntry *records, int n) {
+    if (hi->failed || n <= 0) return;
+    if (hi->count + n > hi->capacity) {
+        int newCapacity = hi->capacity ? hi->capacity : 1024;
+        while (newCapacity < hi->count + n) newCapacity *= 2;
+        Timestamp *times = realloc(hi->times, sizeof(Timestamp) * newCapacity);
+        if (!times) {
+            perror("Error growing history index");
+            hi->failed = 1;
+            return;
+        }
+        hi->times = times;
+        hi->capacity = newCapacity;
+    }
+
+    for (int i = 0; i < n; i++) {
+        int record = hi->count;
+        int side = records[i].type != 0;
+        hi->times[record] = records[i].time;   // TIMESTAMP_NONE sorts first
+        HistorySymbol *entry = historySymbol(hi, internSymbolKey(records[i].symbol), 1);
+        if (!entry || !historyListAdd(&hi->byTime, hi->times, record) ||
+            !historyListAdd(&hi->bySide[side], hi->times, record) ||
+            !historyListAdd(&entry->list, hi->times, record) ||
+            !historyListAdd(&entry->sides[side], hi->times, record)) {
+            hi->failed = 1;
+            return;
+        }
+        hi->count++;
+    }
+}
+
+// Matches of q in time order: fills recordsOut with up to limit history
+// indexes, starting at match number offset, and returns the match count, or
+// -1 if the index is unavailable. O(log n) plus the page.
+int queryTransactionHistory(Account *acct, const HistoryQuery *q, int offset, int limit, int *recordsOut) {
+    HistoryIndex *hi = &acct->historyIndex;
+    if (hi->failed || hi->count != acct->transactionCount) return -1;
+
+    HistoryList *list = q->type < 0 ? &hi->byTime : &hi->bySide[q->type != 0];
+    if (q->symbol[0]) {
+        HistorySymbol *entry = historySymbol(hi, symbolKey(q->symbol), 0);
+        if (!entry) return 0;
+        list = q->type < 0 ? &entry->list : &entry->sides[q->type != 0];
+    }
+    sortHistoryList(list, hi->times);
+    int first = historyRank(list, hi->times, q->from, 0);
+    int last = historyRank(list, hi->times, q->to, 1);
+
+    int total = last > first ? last - first : 0;
+    for (int i = 0; i < limit && offset + i < total; i++) recordsOut[i] = list->records[first + offset + i];
+    return total;
+}
+
+// Remembers where record journalMarkCount * JOURNAL_MARK_STRIDE starts
+static int addJournalMark(Account *acct, long offset) {
+    if (acct->journalMarkCount == acct->journalMarkCapacity) {
+        int newCapacity = acct->journalMarkCapacity ? acct->journalMarkCapacity * 2 : 64;
+        long *marks = realloc(acct->journalMarks, sizeof(long) * newCapacity);
+        if (!marks) {
+            perror("Error growing journal offsets");
+            return 0;
+        }
+        acct->journalMarks = marks;
+        acct->journalMarkCapacity = newCapacity;
+    }
+    acct->journalMarks[acct->journalMarkCount++] = offset;
+    return offset >= 0;
+}
+
+// Reads record index of the journal open as fp: seeks to the nearest known
+// mark before it, noting the marks passed on the way, and reads at most
+// JOURNAL_MARK_STRIDE records from there once the marks reach it
+static int readJournalRecord(Account *acct, FILE *fp, int index, TransactionEntry *t) {
+    if (acct->journalMarkCount == 0 && !addJournalMark(acct, 0)) return 0;
+    int mark = index / JOURNAL_MARK_STRIDE;
+    if (mark >= acct->journalMarkCount) mark = acct->journalMarkCount - 1;
+    if (fseek(fp, acct->journalMarks[mark], SEEK_SET) != 0) return 0;
+    for (int i = mark * JOURNAL_MARK_STRIDE;; i++) {
+        if (i % JOURNAL_MARK_STRIDE == 0 && i / JOURNAL_MARK_STRIDE == acct->journalMarkCount &&
+            !addJournalMark(acct, ftell(fp)))
+            return 0;
+        if (!readTransactionText(fp, t)) return 0;
+        if (i == index) return 1;
+    }
+}
+
+// Copies the given history records to out: from memory, else from the
+// transaction snapshot if it still holds a prefix of the journal, else
+// from the journal by way of its marks. Returns 0 if some record could not
+// be read; its symbol is left empty.
+int readTransactionRecords(Account *acct, const int *records, int n, TransactionEntry *out) {
+    // Deferred journal records must reach the file before it is read back
+    if (acct->journal) fflush(acct->journal);
+
+    const SnapshotHeader *snapshot = NULL;
+    size_t mapSize = 0;
+    int snapshotTried = 0;
+    FILE *fp = NULL;
+    int ok = 1;
+    for (int i = 0; i < n; i++) {
+        const TransactionEntry *t = getTransaction(acct, records[i]);
+        if (t) {
+            out[i] = *t;
+            continue;
+        }
+        if (records[i] < acct->transactionSnapshotCount) {
+            if (!snapshotTried) {
+                snapshotTried = 1;
+                snapshot = mapTransactionSnapshot(acct->transactionFile, &mapSize);
+            }
+            if (snapshot && records[i] < snapshot->count) {
+                out[i] = ((const TransactionEntry *)(snapshot + 1))[records[i]];
+                continue;
+            }
+        }
+        if (!fp && (fp = fopen(acct->transactionFile, "r")) == NULL) {
+            perror("Error opening transaction file for reading");
+            ok = 0;
+        }
+        if (!fp || !readJournalRecord(acct, fp, records[i], &out[i])) {
+            out[i].symbol[0] = '\0';
+            ok = 0;
+        }
+    }
+    if (snapshot) munmap((void *)snapshot, mapSize);
+    if (fp) fclose(fp);
+    return ok;
+}
+
+// Builds a query from user text: symbol or "-", dates or "-" for open ends,
+// and BUY/SELL/ALL (or "-"), of which only the first letter counts. The end
+// date runs to the end of the day, minute or second it names.
+static int makeHistoryQuery(const char *symbol, const char *from, const char *to, const char *type,
+                            HistoryQuery *q) {
+    if (strlen(symbol) >= MAX_SYMBOL_LEN) return 0;
+    strcpy(q->symbol, strcmp(symbol, "-") == 0 ? "" : symbol);
+    toUpperStr(q->symbol);
+
+    Timestamp span;
+    q->from = TIMESTAMP_NONE;
+    q->to = LLONG_MAX;
+    if (strcmp(from, "-") != 0 && !parseTimestamp(from, &q->from, NULL)) return 0;
+    if (strcmp(to, "-") != 0) {
+        if (!parseTimestamp(to, &q->to, &span)) return 0;
+        q->to += span - 1;
+    }
+
+    switch (toupper((unsigned char)type[0])) {
+        case '-': case 'A': q->type = -1; return 1;
+        case 'B': q->type = 0; return 1;
+        case 'S': q->type = 1; return 1;
+        default: return 0;
+    }
+}
+
+// Prints limit matches of q from match number offset, a page at a time;
+// returns the match count or -1
+static int printHistoryMatches(Account *acct, const HistoryQuery *q, int offset, int limit) {
+    int records[HISTORY_PAGE_SIZE];
+    TransactionEntry rows[HISTORY_PAGE_SIZE];
+    int total = queryTransactionHistory(acct, q, offset, HISTORY_PAGE_SIZE, records);
+    if (total < 0) return -1;
+
+    for (int shown = 0; shown < limit && offset + shown < total; ) {
+        if (shown > 0) queryTransactionHistory(acct, q, offset + shown, HISTORY_PAGE_SIZE, records);
+        int n = total - offset - shown;
+        if (n > HISTORY_PAGE_SIZE) n = HISTORY_PAGE_SIZE;
+        if (n > limit - shown) n = limit - shown;
+        if (!readTransactionRecords(acct, records, n, rows))
+            printf("(some records could not be read back)\n");
+        for (int i = 0; i < n; i++)
+            if (rows[i].symbol[0]) printTransactionRow(&rows[i], NULL);
+        shown += n;
+    }
+    return total;
+}
+
+void queryTransactionHistoryInteractive() {
+    Account *acct = activeAccount;
+    char symbol[MAX_SYMBOL_LEN], from[MAX_DATE_LEN], to[MAX_DATE_LEN], type[8];
+
+    printf("Symbol (- for all): ");
+    if (scanf("%15s", symbol) != 1) {
+        printf("Invalid input.\n");
+        clearInputBuffer();
+        return;
+    }
+    printf("From date YYYY-MM-DD[_HH:MM[:SS]] (- for the beginning): ");
+    if (scanf("%31s", from) != 1) {
+        printf("Invalid input.\n");
+        clearInputBuffer();
+        return;
+    }
+    printf("To date YYYY-MM-DD[_HH:MM[:SS]] (- for now): ");
+    if (scanf("%31s", to) != 1) {
+        printf("Invalid input.\n");
+        clearInputBuffer();
+        return;
+    }
+    printf("Type (B = buy, S = sell, A = all): ");
+    if (scanf("%7s", type) != 1) {
+        printf("Invalid input.\n");
+        clearInputBuffer();
+        return;
+    }
+    clearInputBuffer();
+
+    HistoryQuery q;
+    if (!makeHistoryQuery(symbol, from, to, type, &q)) {
+        printf("Invalid query (dates are YYYY-MM-DD, YYYY-MM-DD_HH:MM or YYYY-MM-DD_HH:MM:SS).\n");
+        return;
+    }
+    int records[HISTORY_PAGE_SIZE];
+    int total = queryTransactionHistory(acct, &q, 0, HISTORY_PAGE_SIZE, records);
+    if (total < 0) {
+        printf("History index unavailable.\n");
+        return;
+    }
+    printf("\n----- Transaction History (%s): %d matching -----\n", acct->name, total);
+    if (total == 0) return;
+    printf("%-12s | Type  | Qty | Price/Share | Date/Time\n", "Symbol");
+    printf("---------------------------------------------------------\n");
+
+    // Results come HISTORY_PAGE_SIZE at a time
+    for (int offset = 0; offset < total; offset += HISTORY_PAGE_SIZE) {
+        if (offset > 0) {
+            char more;
+            printf("Show next %d? (y/n): ", HISTORY_PAGE_SIZE);
+            if (scanf(" %c", &more) != 1 || (more != 'y' && more != 'Y')) {
+                clearInputBuffer();
+                break;
+            }
+            clearInputBuffer();
+        }
+        printHistoryMatches(acct, &q, offset, HISTORY_PAGE_SIZE);
+    }
+}
+
+// ================= TAX LOTS =================
+// Each buy opens a lot and each sell closes shares from the symbol's lots,
+// using the relief it was recorded with: FIFO, LIFO, one named lot (its
+// remainder, if any, FIFO) or average cost, which charges the blended cost
+// and takes the shares from the oldest lots. A symbol's lots sit in a ring
+// buffer in buy order, so FIFO and LIFO work at its ends in amortized O(1); a
+// lot closed in the middle stays as an empty lot until an end reaches it.
+// Every queue keeps the cost of its open shares and its realized P&L, and
+// the book keeps the account total, so reports never replay the history.
+// Lots are built as the history loads, through the same path as trades.
+
+#define LOT_PRINT_LIMIT 10   // lots listed per symbol by showTaxLots
+
+// "AVG", "FIFO", "LIFO" or a lot id
+int parseRelief(const char *text, int *out) {
+    if (equalsIgnoreCase(text, "AVG")) *out = RELIEF_AVERAGE;
+    else if (equalsIgnoreCase(text, "FIFO")) *out = RELIEF_FIFO;
+    else if (equalsIgnoreCase(text, "LIFO")) *out = RELIEF_LIFO;
+    else {
+        char *end;
+        long id = strtol(text, &end, 10);
+        if (end == text || *end != '\0' || id < 0 || id > INT_MAX) return 0;
+        *out = (int)id;
+    }
+    return 1;
+}
+
+static const char *reliefName(int relief) {
+    switch (relief) {
+        case RELIEF_AVERAGE: return "AVG";
+        case RELIEF_FIFO: return "FIFO";
+        case RELIEF_LIFO: return "LIFO";
+        default: return "LOT";
+    }
+}
+
+static Lot *lotAt(const LotQueue *q, int pos) {
+    return &q->lots[(q->head + pos) & (q->capacity - 1)];
+}
+
+static void clearLotQueue(LotQueue *q) {
+    q->head = q->count = 0;
+    q->openQuantity = 0;
+    q->basis = 0;
+    q->scale = 1;
+}
+
+// The queue of key; with create it is added if missing. NULL if the symbol
+// has none (or the table cannot grow).
+static LotQueue *lotQueue(LotBook *book, const char *symbol, SymbolKey key, int create) {
+    if (key == SYMBOL_KEY_NONE) return NULL;
+    if (create && (book->queueCount + 1) * 2 > book->queueCapacity) {
+        int newCapacity = book->queueCapacity ? book->queueCapacity * 2 : 64;
+        LotQueue *queues = calloc(newCapacity, sizeof(LotQueue));
+        if (!queues) {
+            perror("Error growing tax lots");
+            return NULL;
+        }
+        for (int i = 0; i < book->queueCapacity; i++) {
+            if (book->queues[i].key == SYMBOL_KEY_NONE) continue;
+            unsigned int pos = symbolKeyHash(book->queues[i].key) & (newCapacity - 1);
+            while (queues[pos].key != SYMBOL_KEY_NONE) pos = (pos + 1) & (newCapacity - 1);
+            queues[pos] = book->queues[i];
+        }
+        free(book->queues);
+        book->queues = queues;
+        book->queueCapacity = newCapacity;
+    }
+    if (book->queueCapacity == 0) return NULL;
+
+    unsigned int mask = book->queueCapacity - 1;
+    for (unsigned int pos = symbolKeyHash(key) & mask;; pos = (pos + 1) & mask) {
+        LotQueue *q = &book->queues[pos];
+        if (q->key == key) return q;
+        if (q->key == SYMBOL_KEY_NONE) {
+            if (!create) return NULL;
+            q->key = key;
+            strcpy(q->symbol, symbol);
+            book->queueCount++;
+            return q;
+        }
+    }
+}
+
+static int pushLot(LotQueue *q, Lot lot) {
+    if (q->openQuantity == 0) q->scale = 1;   // also covers a zeroed queue
+    if (q->count == q->capacity) {
+        int newCapacity = q->capacity ? q->capacity * 2 : 4;
+        Lot *lots = malloc(sizeof(Lot) * newCapacity);
+        if (!lots) {
+            perror("Error growing tax lots");
+            return 0;
+        }
+        for (int i = 0; i < q->count; i++) lots[i] = *lotAt(q, i);
+        free(q->lots);
+        q->lots = lots;
+        q->head = 0;
+        q->capacity = newCapacity;
+    }
+    q->openQuantity += lot.quantity;
+    q->basis += lot.price * lot.quantity;
+    lot.price /= q->scale;
+    *lotAt(q, q->count++) = lot;
+    return 1;
+}
+
+// Position of the open lot with id, or -1 (ids ascend through the queue)
+static int findLot(const LotQueue *q, int id) {
+    int lo = 0, hi = q->count;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (lotAt(q, mid)->id < id) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo < q->count && lotAt(q, lo)->id == id && lotAt(q, lo)->quantity > 0 ? lo : -1;
+}
+
+// Takes up to qty shares from the lot at pos; returns the cost taken
+static double takeFromLot(LotQueue *q, int pos, int *qty, int apply) {
+    Lot *lot = lotAt(q, pos);
+    int take = lot->quantity < *qty ? lot->quantity : *qty;
+    *qty -= take;
+    if (apply) lot->quantity -= take;
+    return lot->price * q->scale * take;
+}
+
+// An average-cost sell charges the average cost, not the cost of the lots
+// the shares came from, so the lots left (which cost lotsCost) are scaled
+// to add up to the new basis again. Mixing reliefs on one position then
+// realizes exactly what the basis says.
+static void rescaleLots(LotQueue *q, double lotsCost) {
+    if (lotsCost > q->basis * 1e-9) {
+        q->scale *= q->basis / lotsCost;
+        return;
+    }
+    // Only zero-cost lots are left: give each the average
+    q->scale = 1;
+    for (int i = 0; i < q->count; i++) lotAt(q, i)->price = q->basis / q->openQuantity;
+}
+
+// Cost of closing qty shares (at most the open quantity) with relief; with
+// apply the shares are closed too
+static double relieveLots(LotQueue *q, int qty, int relief, int apply) {
+    if (qty > q->openQuantity) qty = q->openQuantity;
+    if (qty <= 0) return 0;
+
+    double cost = 0;
+    int left = qty;
+    int chosen = relief >= 0 ? findLot(q, relief) : -1;
+    if (chosen >= 0) cost += takeFromLot(q, chosen, &left, apply);
+    for (int i = 0; left > 0 && i < q->count; i++) {
+        int pos = relief == RELIEF_LIFO ? q->count - 1 - i : i;
+        if (pos != chosen) cost += takeFromLot(q, pos, &left, apply);
+    }
+    double lotsCost = q->basis - cost;   // of the lots left
+    if (relief == RELIEF_AVERAGE) cost = q->basis * qty / q->openQuantity;
+    if (!apply) return cost;
+
+    // Closed lots leave from the ends; ones in the middle wait for an end
+    while (q->count > 0 && lotAt(q, 0)->quantity == 0) {
+        q->head = (q->head + 1) & (q->capacity - 1);
+        q->count--;
+    }
+    while (q->count > 0 && lotAt(q, q->count - 1)->quantity == 0) q->count--;
+    q->openQuantity -= qty;
+    if (q->openQuantity == 0) {
+        q->basis = 0;
+        return cost;
+    }
+    q->basis -= cost;
+    if (relief == RELIEF_AVERAGE) rescaleLots(q, lotsCost);
+    return cost;
+}
+
+// Empties the book but keeps its memory and symbols for the reload
+void resetLotBook(LotBook *book) {
+    for (int i = 0; i < book->queueCapacity; i++) {
+        clearLotQueue(&book->queues[i]);
+        book->queues[i].realized = 0;
+    }
+    book->realized = 0;
+    book->failed = 0;
+}
+
+// Applies n records that follow the ones already applied; first is the
+// history index of records[0]. Sells of shares without open lots (history
+// that does not start at the first buy) realize nothing.
+void applyLotRecords(LotBook *book, int first, const TransactionEntry *records, int n) {
+    if (book->failed) return;
+    for (int i = 0; i < n; i++) {
+        const TransactionEntry *t = &records[i];
+        int buy = t->type == 0;
+        LotQueue *q = lotQueue(book, t->symbol, internSymbolKey(t->symbol), buy);
+        if (buy) {
+            Lot lot = { t->time, t->pricePerShare, t->quantity, first + i };
+            if (!q || !pushLot(q, lot)) {
+                book->failed = 1;
+                return;
+            }
+        } else if (q && q->openQuantity > 0) {
+            int qty = t->quantity < q->openQuantity ? t->quantity : q->openQuantity;
+            double pnl = t->pricePerShare * qty - relieveLots(q, qty, t->relief, 1);
+            q->realized += pnl;
+            book->realized += pnl;
+        }
+    }
+}
+
+// After a load, makes the lots agree with the holdings: a position whose
+// lots do not add up to it (history older than the journal, or edited
+// files) becomes one opening lot at its average price.
+void reconcileLots(Account *acct) {
+    LotBook *book = &acct->lots;
+    if (book->failed) return;
+    for (int i = 0; i < book->queueCapacity; i++) {
+        LotQueue *q = &book->queues[i];
+        if (q->key == SYMBOL_KEY_NONE || q->openQuantity == 0) continue;
+        int found = 0;
+        findHoldingSlotByKey(acct, q->key, &found);
+        if (!found) clearLotQueue(q);
+    }
+    for (int slot = 0; slot < TABLE_SIZE; slot++) {
+        const HoldingEntry *h = &acct->holdings[slot];
+        if (h->status != OCCUPIED) continue;
+        LotQueue *q = lotQueue(book, h->symbol, acct->holdingKeys[slot], 1);
+        if (!q) {
+            book->failed = 1;
+            return;
+        }
+        if (q->openQuantity == h->quantity) continue;
+        clearLotQueue(q);
+        Lot lot = { h->lastBuyTime, h->avgBuyPrice, h->quantity, -1 };
+        if (!pushLot(q, lot)) {
+            book->failed = 1;
+            return;
+        }
+    }
+}
+
+static const LotQueue *lotSortQueues;   // context for cmpLotQueues
+
+static int cmpLotQueues(const void *a, const void *b) {
+    return strcmp(lotSortQueues[*(const int *)a].symbol, lotSortQueues[*(const int *)b].symbol);
+}
+
+// Open lots, cost and P&L of every symbol traded, from the running totals
+void showTaxLots(Account *acct) {
+    const LotBook *book = &acct->lots;
+    printf("\n----- Tax Lots (%s) -----\n", acct->name);
+    if (book->failed) {
+        printf("Tax lots unavailable.\n");
+        return;
+    }
+    printf("Sells without a relief use: %s\n", reliefName(defaultRelief));
+
+    int *order = malloc(sizeof(int) * (book->queueCount > 0 ? book->queueCount : 1));
+    if (!order) {
+        perror("Error listing tax lots");
+        return;
+    }
+    int n = 0;
+    for (int i = 0; i < book->queueCapacity; i++) {
+        const LotQueue *q = &book->queues[i];
+        if (q->key != SYMBOL_KEY_NONE && (q->openQuantity > 0 || q->realized != 0)) order[n++] = i;
+    }
+    lotSortQueues = book->queues;
+    qsort(order, n, sizeof(int), cmpLotQueues);
+
+    double unrealized = 0;
+    for (int i = 0; i < n; i++) {
+        const LotQueue *q = &book->queues[order[i]];
+        int row = findMarketRowByKey(q->key);
+        printf("%-12s | Open: %d | Cost: %.2f | Realized: %.2f", q->symbol, q->openQuantity, q->basis, q->realized);
+        if (row != -1 && q->openQuantity > 0) {
+            double pnl = marketPrices[row] * q->openQuantity - q->basis;
+            unrealized += pnl;
+            printf(" | Unrealized: %.2f", pnl);
+        }
+        printf("\n");
+
+        int shown = 0;
+        for (int pos = 0; pos < q->count; pos++) {
+            const Lot *lot = lotAt(q, pos);
+            if (lot->quantity == 0) continue;
+            if (shown == LOT_PRINT_LIMIT) {
+                printf("    ... more lots\n");
+                break;
+            }
+            char date[MAX_DATE_LEN];
+            formatTimestamp(lot->time, date);
+            if (lot->id >= 0) printf("    Lot %-8d", lot->id);
+            else printf("    Lot %-8s", "open");
+            printf(" | %5d @ %11.2f | %s\n", lot->quantity, lot->price * q->scale, date);
+            shown++;
+        }
+    }
+    free(order);
+    printf("Realized P&L: %.2f\n", book->realized);
+    printf("Unrealized P&L: %.2f\n", unrealized);
+}
+
+// Prints each position whose open lots do not add up to the holding, which
+// the lots' realized P&L relies on; returns how many there are
+int checkTaxLots(Account *acct) {
+    if (acct->lots.failed) return 0;
+    int mismatched = 0;
+    for (int slot = 0; slot < TABLE_SIZE; slot++) {
+        const HoldingEntry *h = &acct->holdings[slot];
+        if (h->status != OCCUPIED) continue;
+        const LotQueue *q = lotQueue(&acct->lots, NULL, acct->holdingKeys[slot], 0);
+        int quantity = 0;
+        double cost = 0;
+        for (int pos = 0; q && pos < q->count; pos++) {
+            const Lot *lot = lotAt(q, pos);
+            quantity += lot->quantity;
+            cost += lot->price * q->scale * lot->quantity;
+        }
+        double held = h->avgBuyPrice * h->quantity;
+        if (quantity == h->quantity && fabs(cost - held) <= PRICE_TOLERANCE * fmax(1.0, fabs(held))) continue;
+        printf("%-12s | Held: %d @ %.2f | Lots: %d @ %.2f\n", h->symbol, h->quantity, h->avgBuyPrice,
+               quantity, quantity > 0 ? cost / quantity : 0.0);
+        mismatched++;
+    }
+    printf("Tax lots: %d positions differ from the holdings\n", mismatched);
+    return mismatched;
+}
+
+// ================= BUY/SELL FUNCTIONS =================
+
+// Core trade logic shared by the interactive menu and batch mode. Symbols
+// must already be uppercase. Holdings are not saved here; callers decide when
+// to persist (after each interactive trade, or at batch checkpoints).
+
+// Records a buy and updates the holding; returns the holding slot, or -1
+// if the table is full (*found is 0) or the position would pass INT_MAX
+// shares (*found is 1).
+int executeBuy(Account *acct, const char *symbol, const char *sector, int qty, double buyPrice,
+               Timestamp time, int *found) {
+    SymbolKey key = internSymbolKey(symbol);
+    int slot = findHoldingSlotByKey(acct, key, found);
+    if (slot == -1 || (*found && qty > INT_MAX - acct->holdings[slot].quantity)) {
+        return -1;
+    }
+    HoldingEntry *h = &acct->holdings[slot];
+
+    // Add transaction BEFORE modifying holdings
+    addTransaction(acct, symbol, qty, buyPrice, time, 0, RELIEF_AVERAGE);  // 0 = buy
+    appendTransactionToJournal(acct, symbol, qty, buyPrice, time, 0, RELIEF_AVERAGE);
+
+    if (*found) {
+        // Update quantity & average price
+        int oldQty = h->quantity;
+        double oldAvg = h->avgBuyPrice;
+        int newQty = oldQty + qty;
+        double newAvg = ((oldAvg * oldQty) + (buyPrice * qty)) / newQty;
+
+        h->quantity = newQty;
+        h->avgBuyPrice = newAvg;
+    } else {
+        occupyHoldingSlot(acct, slot, key, symbol);
+        h->sectorId = internSector(sector);
+        h->quantity = qty;
+        h->avgBuyPrice = buyPrice;
+        addHoldingToSector(acct, slot);
+    }
+    h->lastBuyTime = time;
+    refreshHoldingAggregate(acct, slot);
+    recordHoldingChange(acct, slot);
+
+    return slot;
+}
+
+// Records a sell and reduces the holding; returns the remaining quantity,
+// or -1 if the symbol is not held, qty exceeds the position or a named lot
+// is not open for qty shares. The lots are closed by relief (see TAX LOTS).
+int executeSell(Account *acct, const char *symbol, int qty, double price, Timestamp time, int relief) {
+    int found = 0;
+    int slot = findHoldingSlot(acct, symbol, &found);
+    if (!found || qty <= 0 || qty > acct->holdings[slot].quantity) {
+        return -1;
+    }
+    HoldingEntry *h = &acct->holdings[slot];
+    SymbolKey key = acct->holdingKeys[slot];
+    if (relief >= 0) {
+        const LotQueue *q = lotQueue(&acct->lots, NULL, key, 0);
+        int pos = q ? findLot(q, relief) : -1;
+        if (pos < 0 || lotAt(q, pos)->quantity < qty) return -1;
+    }
+
+    // Add sell transaction
+    addTransaction(acct, symbol, qty, price, time, 1, relief);  // 1 = sell
+    appendTransactionToJournal(acct, symbol, qty, price, time, 1, relief);
+
+    h->quantity -= qty;
+    int remaining = h->quantity;
+    if (relief != RELIEF_AVERAGE && remaining > 0) {
+        // The shares left carry the cost of the lots left
+        const LotQueue *q = lotQueue(&acct->lots, NULL, key, 0);
+        if (q && q->openQuantity == remaining) h->avgBuyPrice = q->basis / remaining;
+    }
+    if (remaining == 0) {
+        removeHoldingFromSector(acct, slot);
+        h->status = EMPTY;   // closed; the slot itself is freed once journaled
+    }
+    refreshHoldingAggregate(acct, slot);
+    recordHoldingChange(acct, slot);
+    if (remaining == 0) removeHoldingSlot(acct, slot, 1);
+    return remaining;
+}
+
+int buyStockInteractive() {
+    char symbolRaw[MAX_SYMBOL_LEN];
+    int qty;
+    double buyPrice;
+    char dateStr[MAX_DATE_LEN];
+
+    printf("Enter stock symbol to BUY (no spaces): ");
+    if (scanf("%15s", symbolRaw) != 1) {
+        printf("Invalid input.\n");
+        clearInputBuffer();
+        return 0;
+    }
+
+    double currentPrice;
+    char sector[MAX_SECTOR_LEN];
+    if (!searchMarketStockExact(symbolRaw, &currentPrice, sector)) {
+        printf("Stock not found in MARKET data.\n");
+        clearInputBuffer();
+        return 0;
+    }
+
+    printf("Market price for %s (sector %s) is: %.2f\n",
+           symbolRaw, sector, currentPrice);
+
+    printf("Enter quantity to buy: ");
+    if (scanf("%d", &qty) != 1 || qty <= 0) {
+        printf("Invalid quantity.\n");
+        clearInputBuffer();
+        return 0;
+    }
+
+    printf("Enter buy price (per share) (you can use current %.2f): ", currentPrice);
+    if (scanf("%lf", &buyPrice) != 1 || !isValidPrice(buyPrice)) {
+        printf("Invalid price.\n");
+        clearInputBuffer();
+        return 0;
+    }
+    clearInputBuffer();
+
+    printf("Enter purchase date/time (no spaces, e.g. 2025-11-27_14:05) or 'now' for current: ");
+    if (scanf("%31s", dateStr) != 1) {
+        printf("Invalid date/time.\n");
+        clearInputBuffer();
+        return 0;
+    }
+    clearInputBuffer();
+
+    Timestamp time = currentTimestamp();
+    if (strcmp(dateStr, "now") != 0 && !parseTimestamp(dateStr, &time, NULL)) {
+        printf("Invalid date/time.\n");
+        return 0;
+    }
+
+    char symbol[MAX_SYMBOL_LEN];
+    strncpy(symbol, symbolRaw, MAX_SYMBOL_LEN - 1);
+    symbol[MAX_SYMBOL_LEN - 1] = '\0';
+    toUpperStr(symbol);
+
+    Account *acct = activeAccount;
+    int found = 0;
+    int slot = executeBuy(acct, symbol, sector, qty, buyPrice, time, &found);
+    if (slot == -1) {
+        if (found) printf("Error: Position would exceed %d shares.\n", INT_MAX);
+        else printf("Error: Holdings table is full.\n");
+        return 0;
+    }
+
+    if (found) {
+        printf("Bought more of %s. New quantity: %d, New avg price: %.2f\n",
+               symbol, acct->holdings[slot].quantity, acct->holdings[slot].avgBuyPrice);
+    } else {
+        printf("Bought %d of %s at %.2f. Holding created.\n", qty, symbol, buyPrice);
+    }
+
+
+    return 1;
+}
+
+int sellStockInteractive() {
+    char symbolRaw[MAX_SYMBOL_LEN];
+    int qty;
+
+    printf("Enter stock symbol to SELL: ");
+    if (scanf("%15s", symbolRaw) != 1) {
+        printf("Invalid input.\n");
+        clearInputBuffer();
+        return 0;
+    }
+    clearInputBuffer();
+
+    char symbol[MAX_SYMBOL_LEN];
+    strncpy(symbol, symbolRaw, MAX_SYMBOL_LEN - 1);
+    symbol[MAX_SYMBOL_LEN - 1] = '\0';
+    toUpperStr(symbol);
+
+    Account *acct = activeAccount;
+    int found = 0;
+    int slot = findHoldingSlot(acct, symbol, &found);
+    if (!found || acct->holdings[slot].status != OCCUPIED) {
+        printf("You do not hold any %s.\n", symbol);
+        return 0;
+    }
+
+    printf("You currently hold %d shares of %s at avg price %.2f\n",
+           acct->holdings[slot].quantity,
+           acct->holdings[slot].symbol,
+           acct->holdings[slot].avgBuyPrice);
+
+    printf("Enter quantity to sell: ");
+    if (scanf("%d", &qty) != 1 || qty <= 0) {
+        printf("Invalid quantity.\n");
+        clearInputBuffer();
+        return 0;
+    }
+    clearInputBuffer();
+
+    if (qty > acct->holdings[slot].quantity) {
+        printf("You cannot sell more than you hold.\n");
+        return 0;
+    }
+
+    double currentPrice;
+    char sectorDummy[MAX_SECTOR_LEN];
+    if (!searchMarketStockExact(symbol, &currentPrice, sectorDummy)) {
+        printf("Current market price not found for %s.\n", symbol);
+        return 0;
+    }
+
+    Timestamp now = currentTimestamp();
+
+    // Profit against the lots the default relief would close
+    double cost = acct->holdings[slot].avgBuyPrice * qty;
+    LotQueue *lots = lotQueue(&acct->lots, NULL, acct->holdingKeys[slot], 0);
+    if (defaultRelief != RELIEF_AVERAGE && lots && lots->openQuantity == acct->holdings[slot].quantity)
+        cost = relieveLots(lots, qty, defaultRelief, 0);
+    double totalProfit = currentPrice * qty - cost;
+
+    printf("Current market price: %.2f\n", currentPrice);
+    if (totalProfit > 0)
+        printf("If you sell %d now: PROFIT = %.2f\n", qty, totalProfit);
+    else if (totalProfit < 0)
+        printf("If you sell %d now: LOSS = %.2f\n", qty, -totalProfit);
+    else
+        printf("If you sell %d now: NO PROFIT / NO LOSS (break-even)\n", qty);
+
+    // Update holdings
+    int remaining = executeSell(acct, symbol, qty, currentPrice, now, defaultRelief);
+    if (remaining == 0) {
+        printf("You sold all holdings of %s.\n", symbol);
+    } else {
+        printf("Remaining quantity of %s: %d\n", symbol, remaining);
+    }
+
+
+    return 1;
+}
+
+typedef struct {
+    char symbol[MAX_SYMBOL_LEN];
+    char sector[MAX_SECTOR_LEN];
+    int quantity;
+    double avgBuyPrice;
+    Timestamp lastBuyTime;
+    double currentPrice;
+    double profitPerShare;
+    double totalProfit;
+} HoldingView;
+
+int cmpHoldByPrice(const void *a, const void *b) {
+    const HoldingView *x = (const HoldingView *)a;
+    const HoldingView *y = (const HoldingView *)b;
+    if (x->currentPrice < y->currentPrice) return -1;
+    if (x->currentPrice > y->currentPrice) return  1;
+    return strcmp(x->symbol, y->symbol);
+}
+
+int cmpHoldBySector(const void *a, const void *b) {
+    const HoldingView *x = (const HoldingView *)a;
+    const HoldingView *y = (const HoldingView *)b;
+    int cmp = strcasecmp(x->sector, y->sector);
+    if (cmp != 0) return cmp;
+    return strcmp(x->symbol, y->symbol);
+}
+
+int cmpHoldByProfit(const void *a, const void *b) {
+    const HoldingView *x = (const HoldingView *)a;
+    const HoldingView *y = (const HoldingView *)b;
+    if (x->totalProfit < y->totalProfit) return -1;
+    if (x->totalProfit > y->totalProfit) return  1;
+    return strcmp(x->symbol, y->symbol);
+}
+
+static void printPortfolioHeader(const Account *acct) {
+    printf("\n----- Your Portfolio (%s) -----\n", acct->name);
+    printf("%-12s | %-10s | Qty | AvgBuy | CurPrice | Profit/Sh | TotalProfit\n",
+           "Symbol", "Sector");
+    printf("------------------------------------------------------------------------\n");
+}
+
+// The k biggest gainers (or losers) by total profit, picked from the running
+// aggregates with a bounded heap; unpriced holdings count as break-even
+static void displayPortfolioTopK(const Account *acct, int losers) {
+    int k = readTopKCount();
+    if (k == 0) return;
+    TopKEntry best[TABLE_SIZE];
+    TopK top = { best, 0, k < TABLE_SIZE ? k : TABLE_SIZE, losers };
+    for (int slot = 0; slot < TABLE_SIZE; slot++) {
+        const HoldingAggregate *a = &acct->aggregates[slot];
+        if (acct->holdings[slot].status != OCCUPIED) continue;
+        topKOffer(&top, a->tracked && a->marketRow >= 0 ? a->value - a->cost : 0, slot);
+    }
+    int n = topKFinish(&top);
+
+    printPortfolioHeader(acct);
+    for (int i = 0; i < n; i++) {
+        const HoldingEntry *h = &acct->holdings[best[i].id];
+        int row = acct->aggregates[best[i].id].marketRow;
+        double price = row >= 0 ? marketPrices[row] : 0;
+        printf("%-12s | %-10s | %3d | %6.2f | %8.2f | %9.2f | %11.2f\n",
+               h->symbol, sectorName(h->sectorId), h->quantity, h->avgBuyPrice,
+               price, row >= 0 ? price - h->avgBuyPrice : 0, best[i].key);
+    }
+    printf("------------------------------------------------------------------------\n");
+    printf("%s %d of %d holdings by total profit\n", losers ? "Bottom" : "Top", n, acct->totals.holdings);
+}
+
+void displayUserPortfolioInteractive() {
+    const Account *acct = activeAccount;
+    const HoldingEntry *holdings = acct->holdings;
+    int count = 0;
+    HoldingView temp[TABLE_SIZE];
+    int qty[TABLE_SIZE];
+    double avg[TABLE_SIZE], price[TABLE_SIZE], pnl[TABLE_SIZE];
+
+    if (acct->totals.holdings == 0) {
+        printf("No holdings in your portfolio.\n");
+        return;
+    }
+
+    int sortChoice;
+    printf("\nSort portfolio by:\n");
+    printf("1. No sorting\n");
+    printf("2. By current price\n");
+    printf("3. By sector\n");
+    printf("4. By total profit\n");
+    printf("5. Top K gainers\n");
+    printf("6. Top K losers\n");
+    printf("Enter choice: ");
+    if (scanf("%d", &sortChoice) != 1) {
+        printf("Invalid input.\n");
+        clearInputBuffer();
         return;
     }
     clearInputBuffer();
+    if (sortChoice == 5 || sortChoice == 6) {
+        displayPortfolioTopK(acct, sortChoice == 6);
+        return;
+    }
+
+    // Gather holdings into contiguous arrays, pricing each through its
+    // linked market row; unpriced holdings are valued at cost (zero P&L)
+    for (int i = 0; i < TABLE_SIZE; i++) {
+        if (holdings[i].status == OCCUPIED) {
+            strcpy(temp[count].symbol, holdings[i].symbol);
+            strcpy(temp[count].sector, sectorName(holdings[i].sectorId));
+            temp[count].quantity = holdings[i].quantity;
+            temp[count].avgBuyPrice = holdings[i].avgBuyPrice;
+            temp[count].lastBuyTime = holdings[i].lastBuyTime;
+
+            int row = acct->aggregates[i].marketRow;
+            qty[count] = holdings[i].quantity;
+            avg[count] = holdings[i].avgBuyPrice;
+            price[count] = row >= 0 ? marketPrices[row] : avg[count];
+            temp[count].currentPrice = row >= 0 ? price[count] : 0;
+            count++;
+        }
+    }
+
+    BookTotals book;
+    valueBook(qty, avg, price, count, pnl, &book);
+    for (int i = 0; i < count; i++) {
+        temp[i].profitPerShare = price[i] - avg[i];
+        temp[i].totalProfit = pnl[i];
+    }
+
+    switch (sortChoice) {
+        case 2: qsort(temp, count, sizeof(HoldingView), cmpHoldByPrice); break;
+        case 3: qsort(temp, count, sizeof(HoldingView), cmpHoldBySector); break;
+        case 4: qsort(temp, count, sizeof(HoldingView), cmpHoldByProfit); break;
+    }
+
+    printPortfolioHeader(acct);
+    for (int i = 0; i < count; i++) {
+        printf("%-12s | %-10s | %3d | %6.2f | %8.2f | %9.2f | %11.2f\n",
+               temp[i].symbol,
+               temp[i].sector,
+               temp[i].quantity,
+               temp[i].avgBuyPrice,
+               temp[i].currentPrice,
+               temp[i].profitPerShare,
+               temp[i].totalProfit);
+    }
     
-    if (choice == 1) {
-        double price;
-        char sector[MAX_SECTOR_LEN];
-        
-        printf("Enter exact symbol to search: ");
-        if (scanf("%15s", input) != 1) {
-            printf("Invalid input.\n");
-            clearInputBuffer();
-            return;
+    printf("------------------------------------------------------------------------\n");
+    printf("TOTALS: Investment: %.2f | Current Value: %.2f | Net Profit/Loss: %.2f\n",
+           acct->totals.investment, acct->totals.currentValue,
+           acct->totals.currentValue - acct->totals.pricedInvestment);
+}
+
+// Foreground checkpoint: writes the holdings file atomically and starts an
+// empty holdings journal (see HOLDINGS JOURNAL)
+int saveHoldingsToFile(Account *acct) {
+    HoldingTextRow rows[TABLE_SIZE];
+    finishHoldingsCheckpoint(acct);
+    if (!ensureAccountDirectory(acct)) return 0;
+    if (!writeHoldingsCheckpoint(acct->holdingsFile, rows, collectHoldingRows(acct, rows)))
+        return 0;
+
+    // Every delta is now in the checkpoint
+    char path[MAX_PATH_LEN + 16];
+    closeHoldingJournal(acct);
+    holdingJournalPath(acct, 0, path, sizeof(path));
+    remove(path);
+    holdingJournalPath(acct, 1, path, sizeof(path));
+    remove(path);
+    acct->holdingDeltas = 0;
+    acct->dirty = 0;
+    if (useSnapshots) saveHoldingsSnapshot(acct);
+    return 1;
+}
+
+// Holdings snapshot: the raw slot array and the sector names its ids refer to
+static int saveHoldingsSnapshot(Account *acct) {
+    char path[256], tmpPath[260];
+    snapshotPathFor(acct->holdingsFile, path, sizeof(path));
+    snprintf(tmpPath, sizeof(tmpPath), "%s.tmp", path);
+
+    FILE *fp = beginSnapshot(tmpPath);
+    if (!fp) return 0;
+    fwrite(acct->holdings, sizeof(HoldingEntry), TABLE_SIZE, fp);
+    writeSectorNames(fp);
+    return finishSnapshot(fp, tmpPath, path, SNAPSHOT_HOLDINGS, sizeof(HoldingEntry),
+                          TABLE_SIZE, TABLE_SIZE, acct->holdingsFile);
+}
+
+static int loadHoldingsSnapshot(Account *acct) {
+    char path[256];
+    size_t mapSize;
+    snapshotPathFor(acct->holdingsFile, path, sizeof(path));
+
+    const SnapshotHeader *h = mapSnapshot(path, SNAPSHOT_HOLDINGS, sizeof(HoldingEntry), &mapSize);
+    if (!h) return 0;
+
+    int ok = snapshotMatchesText(h, acct->holdingsFile) && h->count == TABLE_SIZE &&
+             mapSize >= sizeof(*h) + sizeof(HoldingEntry) * TABLE_SIZE;
+    int sectorCount = 0;
+    int *remap = ok ? readSectorNames((const char *)h + sizeof(*h) + sizeof(HoldingEntry) * TABLE_SIZE,
+                                      (const char *)h + mapSize, &sectorCount) : NULL;
+    ok = ok && remap;
+    if (ok) {
+        memcpy(acct->holdings, h + 1, sizeof(HoldingEntry) * TABLE_SIZE);
+        for (int i = 0; i < TABLE_SIZE; i++) {
+            int id = acct->holdings[i].sectorId;
+            acct->holdings[i].sectorId = (id >= 0 && id < sectorCount) ? remap[id] : -1;
+            EntryStatus status = acct->holdings[i].status;
+            SymbolKey key = status == OCCUPIED ? internSymbolKey(acct->holdings[i].symbol) : SYMBOL_KEY_NONE;
+            // Long symbol ids are per process, so slots placed by their key
+            // are not reusable, and tombstones from older builds would need
+            // compacting; the text file is parsed instead
+            if (status == OCCUPIED && ((key & SYMBOL_KEY_LONG) || key == SYMBOL_KEY_NONE)) ok = 0;
+            if (status == DELETED) ok = 0;
+            acct->holdingKeys[i] = key;
+        }
+    }
+    if (ok) {
+        rebuildHoldingSectorMembers(acct);
+        rebuildAccountAggregates(acct);
+    }
+    free(remap);
+    munmap((void *)h, mapSize);
+    return ok;
+}
+
+static int loadHoldingsCheckpoint(Account *acct) {
+    FILE *fp = fopen(acct->holdingsFile, "r");
+    if (!fp) {
+        return 0;
+    }
+
+    if (useSnapshots && loadHoldingsSnapshot(acct)) {
+        fclose(fp);
+        return 1;
+    }
+
+    fclose(fp);
+    initHoldingTable(acct);
+
+    void *rows;
+    size_t count;
+    if (!parseTextFileParallel(acct->holdingsFile, 0, parseHoldingLine, sizeof(HoldingTextRow), &rows, &count, NULL)) {
+        return 0;
+    }
+    const HoldingTextRow *h = rows;
+    for (size_t i = 0; i < count; i++) {
+        int found = 0;
+        SymbolKey key = internSymbolKey(h[i].symbol);
+        int slot = findHoldingSlotByKey(acct, key, &found);
+        if (slot != -1) {
+            HoldingEntry *e = &acct->holdings[slot];
+            occupyHoldingSlot(acct, slot, key, h[i].symbol);
+            e->sectorId = internSector(h[i].sector);
+            e->quantity = h[i].quantity;
+            e->avgBuyPrice = h[i].avgBuyPrice;
+            e->lastBuyTime = h[i].lastBuyTime;
         }
-        clearInputBuffer();
-        
-        if (searchMarketStockExact(input, &price, sector)) {
-            printf("Found: %s | Sector: %s | Price: %.2f\n", input, sector, price);
-        } else {
-            printf("Stock %s not found in market.\n", input);
+    }
+    free(rows);
+    rebuildHoldingSectorMembers(acct);
+    rebuildAccountAggregates(acct);
+    return 1;
+}
+
+// Loads the checkpoint, then replays the journal tail written since it
+int loadHoldingsFromFile(Account *acct) {
+    char path[MAX_PATH_LEN + 16];
+    int loaded = loadHoldingsCheckpoint(acct);
+    if (!loaded) initHoldingTable(acct);
+
+    holdingJournalPath(acct, 1, path, sizeof(path));
+    int replayed = replayHoldingJournal(acct, path);
+    holdingJournalPath(acct, 0, path, sizeof(path));
+    replayed += replayHoldingJournal(acct, path);
+    if (replayed > 0) {
+        rebuildHoldingSectorMembers(acct);
+        rebuildAccountAggregates(acct);
+        acct->holdingDeltas = replayed;
+        acct->dirty = 1;   // the next save folds the tail into a checkpoint
+    }
+    return loaded || replayed > 0;
+}
+
+// ================= STATISTICS =================
+
+void showMarketStatistics() {
+    // Market rows are dense and never deleted, so the price column is
+    // exactly the listed stocks. Read lock-free: each price is whole, though
+    // the set may mix prices from before and after a concurrent update.
+    int phase = marketReadBegin();
+    int count = marketVisibleCount();
+    PriceStats stats;
+    computePriceStats(__atomic_load_n(&marketPrices, __ATOMIC_ACQUIRE), count, &stats);
+
+    // Unique sectors are the dictionary entries with market members
+    const SectorMembers *members = __atomic_load_n(&marketSectorMembers, __ATOMIC_ACQUIRE);
+    int sectors = __atomic_load_n(&sectorNameCount, __ATOMIC_ACQUIRE);
+    int sectorCount = 0;
+    for (int id = 0; id < sectors; id++) {
+        if (__atomic_load_n(&members[id].count, __ATOMIC_RELAXED) > 0) sectorCount++;
+    }
+
+    printf("\n----- Market Statistics -----\n");
+    printf("Total Stocks: %d\n", count);
+    printf("Unique Sectors: %d\n", sectorCount);
+    if (count > 0) {
+        printf("Average Price: %.2f\n", stats.sum / count);
+        printf("Price Range: %.2f - %.2f\n", stats.min, stats.max);
+        printf("Sectors: ");
+        int printed = 0;
+        for (int id = 0; id < sectors; id++) {
+            int n = __atomic_load_n(&members[id].count, __ATOMIC_RELAXED);
+            if (n == 0) continue;
+            printf("%s%s (%d)", printed ? ", " : "", sectorName(id), n);
+            printed = 1;
         }
-        
-    } else if (choice == 2) {
-        printf("Enter symbol prefix (case-insensitive, no spaces): ");
-        if (scanf("%15s", input) != 1) {
-            printf("Invalid input.\n");
-            clearInputBuffer();
-            return;
+        printf("\n");
+    }
+    marketReadEnd(phase);
+}
+
+// Reads the running aggregates: O(1) totals, O(log n) best and worst
+void showPortfolioStatistics() {
+    Account *acct = activeAccount;
+    const PortfolioTotals *t = &acct->totals;
+
+    printf("\n----- Portfolio Statistics (%s) -----\n", acct->name);
+    printf("Total Holdings: %d\n", t->holdings);
+    printf("Total Investment: %.2f\n", t->investment);
+    printf("Current Portfolio Value: %.2f\n", t->currentValue);
+    printf("Net Profit/Loss: %.2f\n", t->currentValue - t->investment);
+    if (!acct->lots.failed) printf("Realized Profit/Loss: %.2f\n", acct->lots.realized);
+    if (t->investment > 0) {
+        double roi = ((t->currentValue - t->investment) / t->investment) * 100;
+        printf("ROI: %.2f%%\n", roi);
+    }
+    int best = bestHoldingSlot(acct), worst = worstHoldingSlot(acct);
+    if (best >= 0) {
+        printf("Best Performing: %s (%.2f)\n", acct->holdings[best].symbol,
+               acct->aggregates[best].value - acct->aggregates[best].cost);
+        printf("Worst Performing: %s (%.2f)\n", acct->holdings[worst].symbol,
+               acct->aggregates[worst].value - acct->aggregates[worst].cost);
+    }
+}
+
+// ================= TABLE HEALTH =================
+// Shape of the hash tables: load factor and probe lengths. Neither table
+// leaves tombstones. "stored" is what a hit on each entry costs now; "miss"
+// is the average cost of looking up an absent symbol from every home slot,
+// which is what clustering inflates. Builds with -DTABLE_STATS also show
+// the probes of every lookup since startup.
+
+static void printProbeHeader() {
+    printf("  %-8s %10s  %-10s  %-8s |%8s%8s%8s%8s%8s%8s%8s%8s\n", "probes", "count", "avg", "max",
+           "1", "2", "3", "4", "5-8", "9-16", "17-32", "33+");
+}
+
+static void printProbeRow(const char *label, const ProbeStats *stats) {
+    printf("  %-8s %10llu  avg %6.2f  max %4llu |", label, stats->lookups,
+           stats->lookups ? (double)stats->probes / stats->lookups : 0.0, stats->maxProbe);
+    for (int b = 0; b < PROBE_HISTOGRAM_BUCKETS; b++) printf(" %7llu", stats->histogram[b]);
+    printf("\n");
+}
+
+static void marketIndexHealth(ProbeStats *stored, ProbeStats *miss) {
+    unsigned int mask = marketIndexCapacity - 1;
+    for (unsigned int i = 0; i < marketIndexCapacity; i++) {
+        if (marketIndex[i].row >= 0) recordProbes(stored, marketIndex[i].dist + 1, 1);
+        // A miss from home slot i stops at an empty slot or a richer entry
+        unsigned int pos = i;
+        int dist = 0;
+        while (marketIndex[pos].row >= 0 && marketIndex[pos].dist >= dist) {
+            pos = (pos + 1) & mask;
+            dist++;
         }
-        clearInputBuffer();
+        recordProbes(miss, dist + 1, 0);
+    }
+}
 
-        int foundAny = 0;
-        printf("\n--- Stocks starting with \"%s\" ---\n", input);
-        for (int i = 0; i < TABLE_SIZE; i++) {
-            if (marketTable[i].status == OCCUPIED &&
-                startsWithIgnoreCase(marketTable[i].symbol, input)) {
-                printf("%-12s | %-10s | Price: %.2f\n",
-                       marketTable[i].symbol,
-                       marketTable[i].sector,
-                       marketTable[i].price);
-                foundAny = 1;
-            }
+static void holdingTableHealth(const Account *acct, ProbeStats *stored, ProbeStats *miss) {
+    const SymbolKey *keys = acct->holdingKeys;
+    for (int i = 0; i < TABLE_SIZE; i++) {
+        SymbolKey k = keys[i];
+        if (k != SYMBOL_KEY_NONE)
+            recordProbes(stored, (i - (int)holdingHomeSlot(k) + TABLE_SIZE) % TABLE_SIZE + 1, 1);
+        // A miss from home slot i runs until an empty slot
+        int probes = 1;
+        for (int pos = i; keys[pos] != SYMBOL_KEY_NONE && probes < TABLE_SIZE; probes++)
+            pos = (pos + 1 < TABLE_SIZE) ? pos + 1 : 0;
+        recordProbes(miss, probes, 0);
+    }
+}
+
+void showTableHealth() {
+    ProbeStats stored = { 0 }, miss = { 0 };
+    marketIndexHealth(&stored, &miss);
+
+    printf("\n----- Hash Table Health -----\n");
+    printf("Market index: %d rows in %u slots, load %.1f%%\n",
+           marketCount, marketIndexCapacity,
+           marketIndexCapacity ? 100.0 * marketCount / marketIndexCapacity : 0.0);
+    printProbeHeader();
+    printProbeRow("stored", &stored);
+    printProbeRow("miss", &miss);
+
+    ProbeStats allStored = { 0 }, allMiss = { 0 };
+    for (int a = 0; a < accountCount; a++) {
+        const Account *acct = accounts[a];
+        ProbeStats accountStored = { 0 }, accountMiss = { 0 };
+        holdingTableHealth(acct, &accountStored, &accountMiss);
+        for (int b = 0; b < PROBE_HISTOGRAM_BUCKETS; b++) {
+            allStored.histogram[b] += accountStored.histogram[b];
+            allMiss.histogram[b] += accountMiss.histogram[b];
         }
-        if (!foundAny) {
-            printf("No stocks found with prefix: %s\n", input);
+        allStored.lookups += accountStored.lookups;
+        allStored.probes += accountStored.probes;
+        allMiss.lookups += accountMiss.lookups;
+        allMiss.probes += accountMiss.probes;
+        if (accountStored.maxProbe > allStored.maxProbe) allStored.maxProbe = accountStored.maxProbe;
+        if (accountMiss.maxProbe > allMiss.maxProbe) allMiss.maxProbe = accountMiss.maxProbe;
+        if (acct != activeAccount) continue;
+
+        int held = (int)accountStored.lookups;
+        printf("Holdings (%s): %d held in %d slots, load %.1f%%\n",
+               acct->name, held, TABLE_SIZE, 100.0 * held / TABLE_SIZE);
+        printProbeHeader();
+        printProbeRow("stored", &accountStored);
+        printProbeRow("miss", &accountMiss);
+    }
+    if (accountCount > 1) {
+        printf("All %d accounts: %llu held\n", accountCount, allStored.lookups);
+        printProbeHeader();
+        printProbeRow("stored", &allStored);
+        printProbeRow("miss", &allMiss);
+    }
+
+#ifdef TABLE_STATS
+    printf("Lookups since startup: market %llu hits, holdings %llu hits\n",
+           marketLookupStats.hits, holdingLookupStats.hits);
+    printProbeHeader();
+    printProbeRow("market", &marketLookupStats);
+    printProbeRow("holdings", &holdingLookupStats);
+#else
+    printf("Per-lookup counters are off (build with -DTABLE_STATS).\n");
+#endif
+}
+
+// ================= THREAD POOL =================
+// A persistent pool for data-parallel loops. parallelFor splits [0, n) into
+// one contiguous range per worker; each worker takes grain-sized chunks from
+// the front of its own range and, once that is empty, steals the back half
+// of another worker's range. A range is one atomic word (end << 32 | begin),
+// so the owner and thieves agree through compare-and-swap alone. The calling
+// thread takes part as worker 0.
+
+typedef struct {
+    _Alignas(64) _Atomic unsigned long long range;   // own cache line
+} WorkRange;
+
+typedef void (*ParallelBody)(int begin, int end, void *ctx);
+
+static pthread_mutex_t poolLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t poolWake = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t poolDone = PTHREAD_COND_INITIALIZER;
+static WorkRange *poolRanges = NULL;
+static int poolSize = 0;                 // workers including the caller
+static int poolLimit = 0;                // workers taking part in the current job
+static unsigned long poolGeneration = 0; // bumped once per job
+static int poolRunning = 0;              // helper threads still in the current job
+static ParallelBody poolBody;
+static void *poolCtx;
+static int poolGrain;
+
+static unsigned long long packRange(unsigned int begin, unsigned int end) {
+    return ((unsigned long long)end << 32) | begin;
+}
+
+// Runs chunks of the current job until no range has work left
+static void poolWork(int self) {
+    _Atomic unsigned long long *own = &poolRanges[self].range;
+    for (;;) {
+        unsigned long long r = atomic_load(own);
+        unsigned int begin = (unsigned int)r, end = (unsigned int)(r >> 32);
+        if (begin < end) {
+            unsigned int stop = end - begin > (unsigned int)poolGrain ? begin + poolGrain : end;
+            if (atomic_compare_exchange_weak(own, &r, packRange(stop, end)))
+                poolBody((int)begin, (int)stop, poolCtx);
+            continue;
         }
-        
-    } else {
-        printf("Invalid choice.\n");
+
+        // Own range is empty: steal the back half of the first busy range
+        int stolen = 0;
+        for (int k = 1; k < poolLimit && !stolen; k++) {
+            _Atomic unsigned long long *victim = &poolRanges[(self + k) % poolLimit].range;
+            unsigned long long v = atomic_load(victim);
+            unsigned int vBegin = (unsigned int)v, vEnd = (unsigned int)(v >> 32);
+            while (vBegin < vEnd && !stolen) {
+                unsigned int mid = vBegin + (vEnd - vBegin) / 2;
+                if (atomic_compare_exchange_weak(victim, &v, packRange(vBegin, mid))) {
+                    atomic_store(own, packRange(mid, vEnd));
+                    stolen = 1;
+                } else {
+                    vBegin = (unsigned int)v;
+                    vEnd = (unsigned int)(v >> 32);
+                }
+            }
+        }
+        // Work claimed by others is finished by them, so an empty pass ends
+        if (!stolen) return;
     }
 }
 
-void filterMarketByPriceInteractive() {
-    double target;
-    int choice;
+static void *poolThreadMain(void *arg) {
+    int self = (int)(long)arg;
+    unsigned long seen = 0;
+    pthread_mutex_lock(&poolLock);
+    for (;;) {
+        while (poolGeneration == seen) pthread_cond_wait(&poolWake, &poolLock);
+        seen = poolGeneration;
+        int takesPart = self < poolLimit;
+        pthread_mutex_unlock(&poolLock);
 
-    printf("Enter target price: ");
-    if (scanf("%lf", &target) != 1) {
-        printf("Invalid price.\n");
-        clearInputBuffer();
-        return;
+        if (takesPart) poolWork(self);
+
+        pthread_mutex_lock(&poolLock);
+        if (--poolRunning == 0) pthread_cond_signal(&poolDone);
     }
-    clearInputBuffer();
+    return NULL;
+}
 
-    printf("1. Price >= target\n");
-    printf("2. Price <= target\n");
-    printf("Enter choice: ");
-    if (scanf("%d", &choice) != 1) {
-        printf("Invalid input.\n");
-        clearInputBuffer();
+// Starts the helper threads once; the pool size is fixed afterwards
+static int startThreadPool() {
+    if (poolSize > 0) return poolSize;
+    int n = poolThreads > 0 ? poolThreads : (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (n < 1) n = 1;
+
+    poolRanges = aligned_alloc(64, sizeof(WorkRange) * n);
+    if (!poolRanges) {
+        // Run single-threaded; worker 0 needs no allocation
+        static WorkRange soloRange;
+        perror("Error allocating thread pool");
+        n = 1;
+        poolRanges = &soloRange;
+    }
+    poolSize = 1;
+    for (int i = 1; i < n; i++) {
+        pthread_t tid;
+        if (pthread_create(&tid, NULL, poolThreadMain, (void *)(long)i) != 0) {
+            perror("Error starting pool thread");
+            break;
+        }
+        pthread_detach(tid);
+        poolSize++;
+    }
+    poolLimit = poolSize;
+    return poolSize;
+}
+
+// Calls body over disjoint subranges covering [0, n), on up to `workers`
+// threads (0 = the whole pool). Returns once every subrange is done.
+static void parallelFor(int n, int grain, int workers, ParallelBody body, void *ctx) {
+    int size = startThreadPool();
+    int limit = (workers > 0 && workers < size) ? workers : size;
+    if (grain < 1) grain = 1;
+    if (limit == 1 || n <= grain) {
+        if (n > 0) body(0, n, ctx);
         return;
     }
-    clearInputBuffer();
 
-    int foundAny = 0;
-    printf("\n--- Market stocks by price filter ---\n");
-    for (int i = 0; i < TABLE_SIZE; i++) {
-        if (marketTable[i].status == OCCUPIED) {
-            int cond = 0;
-            if (choice == 1) cond = (marketTable[i].price >= target);
-            else if (choice == 2) cond = (marketTable[i].price <= target);
+    for (int w = 0; w < size; w++) {
+        unsigned int begin = w < limit ? (unsigned int)((long long)n * w / limit) : 0;
+        unsigned int end = w < limit ? (unsigned int)((long long)n * (w + 1) / limit) : 0;
+        atomic_store(&poolRanges[w].range, packRange(begin, end));
+    }
 
-            if (cond) {
-                printf("%-12s | %-10s | Price: %.2f\n",
-                       marketTable[i].symbol,
-                       marketTable[i].sector,
-                       marketTable[i].price);
-                foundAny = 1;
-            }
+    pthread_mutex_lock(&poolLock);
+    poolBody = body;
+    poolCtx = ctx;
+    poolGrain = grain;
+    poolLimit = limit;
+    poolRunning = size - 1;
+    poolGeneration++;
+    pthread_cond_broadcast(&poolWake);
+    pthread_mutex_unlock(&poolLock);
+
+    poolWork(0);
+
+    pthread_mutex_lock(&poolLock);
+    while (poolRunning > 0) pthread_cond_wait(&poolDone, &poolLock);
+    pthread_mutex_unlock(&poolLock);
+}
+
+// ================= ACCOUNTS =================
+// Every account is loaded at startup: its holdings are needed so that price
+// changes reach all positions. Transaction history is loaded when an account
+// is first activated, and its journal is opened on its first trade.
+
+static unsigned int accountLookupHome(const char *name) {
+    return hash(name) & (accountLookupCapacity - 1);
+}
+
+static int growAccountLookup() {
+    int newCapacity = accountLookupCapacity ? accountLookupCapacity * 2 : 16;
+    int *lookup = malloc(sizeof(int) * newCapacity);
+    if (!lookup) {
+        perror("Error growing account lookup");
+        return 0;
+    }
+    for (int i = 0; i < newCapacity; i++) lookup[i] = -1;
+    free(accountLookup);
+    accountLookup = lookup;
+    accountLookupCapacity = newCapacity;
+
+    for (int id = 0; id < accountCount; id++) {
+        unsigned int pos = accountLookupHome(accounts[id]->name);
+        while (accountLookup[pos] >= 0) pos = (pos + 1) & (accountLookupCapacity - 1);
+        accountLookup[pos] = id;
+    }
+    return 1;
+}
+
+// Account names become directory names: letters, digits, '-' and '_' only
+static int validAccountName(const char *name) {
+    size_t len = strlen(name);
+    if (len == 0 || len >= MAX_ACCOUNT_NAME) return 0;
+    for (size_t i = 0; i < len; i++) {
+        if (!isalnum((unsigned char)name[i]) && name[i] != '-' && name[i] != '_')
+            return 0;
+    }
+    return 1;
+}
+
+Account *findAccount(const char *name) {
+    if (accountLookupCapacity == 0) return NULL;
+    unsigned int pos = accountLookupHome(name);
+    while (accountLookup[pos] >= 0) {
+        if (strcmp(accounts[accountLookup[pos]]->name, name) == 0) return accounts[accountLookup[pos]];
+        pos = (pos + 1) & (accountLookupCapacity - 1);
+    }
+    return NULL;
+}
+
+// Registers an empty account without touching its files
+static Account *newAccount(const char *name) {
+    if ((accountCount + 1) * 2 > accountLookupCapacity && !growAccountLookup())
+        return NULL;
+    if (accountCount == accountCapacity) {
+        int newCapacity = accountCapacity ? accountCapacity * 2 : 8;
+        Account **list = realloc(accounts, sizeof(Account *) * newCapacity);
+        if (!list) {
+            perror("Error growing account list");
+            return NULL;
         }
+        accounts = list;
+        accountCapacity = newCapacity;
     }
-    if (!foundAny) {
-        printf("No stocks match the given price filter.\n");
+    Account *acct = calloc(1, sizeof(Account));
+    if (!acct) {
+        perror("Error allocating account");
+        return NULL;
+    }
+
+    strcpy(acct->name, name);
+    if (strcmp(name, DEFAULT_ACCOUNT) == 0) {
+        strcpy(acct->holdingsFile, USER_FILE);
+        strcpy(acct->transactionFile, TRANSACTION_FILE);
+    } else {
+        snprintf(acct->holdingsFile, MAX_PATH_LEN, "%s/%s/%s", ACCOUNTS_DIR, name, USER_FILE);
+        snprintf(acct->transactionFile, MAX_PATH_LEN, "%s/%s/%s", ACCOUNTS_DIR, name, TRANSACTION_FILE);
     }
+    initHoldingTable(acct);
+    for (int slot = 0; slot < TABLE_SIZE; slot++) acct->aggregates[slot].marketRow = -1;
+    acct->profitIndex.root = -1;
+    acct->transactionSnapshotCount = -1;
+
+    acct->id = accountCount;
+    accounts[accountCount++] = acct;
+    unsigned int pos = accountLookupHome(name);
+    while (accountLookup[pos] >= 0) pos = (pos + 1) & (accountLookupCapacity - 1);
+    accountLookup[pos] = acct->id;
+    return acct;
 }
 
-void filterMarketBySectorInteractive() {
-    char sector[MAX_SECTOR_LEN];
-    printf("Enter sector name (e.g., IT, BANKING, AUTO): ");
-    if (scanf("%19s", sector) != 1) {
+// Returns the named account, loading its holdings the first time; NULL if
+// the name is invalid
+Account *openAccount(const char *name) {
+    if (!validAccountName(name)) return NULL;
+    Account *acct = findAccount(name);
+    if (acct) return acct;
+    acct = newAccount(name);
+    if (acct) loadHoldingsFromFile(acct);
+    return acct;
+}
+
+// The default account lives in the working directory; others get
+// accounts/<name>/, created on their first save
+int ensureAccountDirectory(const Account *acct) {
+    if (strcmp(acct->name, DEFAULT_ACCOUNT) == 0) return 1;
+    char dir[MAX_PATH_LEN];
+    snprintf(dir, sizeof(dir), "%s/%s", ACCOUNTS_DIR, acct->name);
+    if ((mkdir(ACCOUNTS_DIR, 0755) != 0 && errno != EEXIST) ||
+        (mkdir(dir, 0755) != 0 && errno != EEXIST)) {
+        perror("Error creating account directory");
+        return 0;
+    }
+    return 1;
+}
+
+// Makes acct the one trades apply to, loading its history on first use
+int activateAccount(Account *acct) {
+    if (!acct) return 0;
+    if (!acct->historyLoaded) {
+        loadTransactionsFromFile(acct);
+        reconcileLots(acct);
+        acct->historyLoaded = 1;
+    }
+    activeAccount = acct;
+    return 1;
+}
+
+// Opens the default account and every account directory; returns how many
+// accounts had saved holdings
+int loadAllAccounts() {
+    int loaded = 0;
+    Account *acct = newAccount(DEFAULT_ACCOUNT);
+    if (acct && loadHoldingsFromFile(acct)) loaded++;
+
+    DIR *dir = opendir(ACCOUNTS_DIR);
+    if (!dir) return loaded;
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        char path[MAX_PATH_LEN];
+        struct stat st;
+        if (!validAccountName(entry->d_name) || findAccount(entry->d_name)) continue;
+        snprintf(path, sizeof(path), "%s/%.*s", ACCOUNTS_DIR, MAX_ACCOUNT_NAME, entry->d_name);
+        if (stat(path, &st) != 0 || !S_ISDIR(st.st_mode)) continue;
+
+        acct = newAccount(entry->d_name);
+        if (acct && loadHoldingsFromFile(acct)) loaded++;
+    }
+    closedir(dir);
+    return loaded;
+}
+
+void saveDirtyAccounts() {
+    for (int i = 0; i < accountCount; i++) {
+        if (accounts[i]->dirty) saveHoldingsToFile(accounts[i]);
+    }
+}
+
+// Closes every journal and brings the loaded histories' snapshots up to date
+void closeAllAccounts() {
+    for (int i = 0; i < accountCount; i++) {
+        finishHoldingsCheckpoint(accounts[i]);
+        closeHoldingJournal(accounts[i]);
+        closeTransactionJournal(accounts[i]);
+        if (useSnapshots && accounts[i]->historyLoaded) saveTransactionSnapshot(accounts[i]);
+    }
+}
+
+void switchAccountInteractive() {
+    char name[MAX_ACCOUNT_NAME + 1];
+
+    printf("\n%-20s | Holdings | Current Value\n", "Account");
+    printf("-----------------------------------------------\n");
+    for (int i = 0; i < accountCount; i++) {
+        const Account *acct = accounts[i];
+        printf("%-20s | %8d | %13.2f%s\n", acct->name, acct->totals.holdings,
+               acct->totals.currentValue, acct == activeAccount ? "  (active)" : "");
+    }
+
+    printf("Enter account name to switch to (new names create an account): ");
+    if (scanf("%32s", name) != 1) {
         printf("Invalid input.\n");
         clearInputBuffer();
         return;
     }
     clearInputBuffer();
 
-    int foundAny = 0;
-    printf("\n--- Market stocks in sector \"%s\" ---\n", sector);
-    for (int i = 0; i < TABLE_SIZE; i++) {
-        if (marketTable[i].status == OCCUPIED &&
-            equalsIgnoreCase(marketTable[i].sector, sector)) {
-            printf("%-12s | %-10s | Price: %.2f\n",
-                   marketTable[i].symbol,
-                   marketTable[i].sector,
-                   marketTable[i].price);
-            foundAny = 1;
+    if (!validAccountName(name)) {
+        printf("Invalid account name (use letters, digits, '-' and '_').\n");
+        return;
+    }
+    int existed = findAccount(name) != NULL;
+    Account *acct = openAccount(name);
+    if (!acct || !activateAccount(acct)) {
+        printf("Could not open account %s.\n", name);
+        return;
+    }
+    printf("%s account %s.\n", existed ? "Switched to" : "Created and switched to", acct->name);
+}
+
+// Full revaluation of every account at current prices, one account per work
+// item. Each account's result is kept in acct->revalued; totals are reduced
+// serially afterwards so the sum does not depend on scheduling.
+
+static void revalueAccountRange(int begin, int end, void *ctx) {
+    (void)ctx;
+    int qty[TABLE_SIZE];
+    double avg[TABLE_SIZE], price[TABLE_SIZE];
+    int phase = marketReadBegin();
+
+    for (int i = begin; i < end; i++) {
+        Account *acct = accounts[i];
+        int n = 0;
+        for (int slot = 0; slot < TABLE_SIZE; slot++) {
+            int row = acct->aggregates[slot].marketRow;
+            if (acct->holdings[slot].status != OCCUPIED || row < 0) continue;
+            qty[n] = acct->holdings[slot].quantity;
+            avg[n] = acct->holdings[slot].avgBuyPrice;
+            price[n] = loadMarketPrice(row);
+            n++;
         }
+        valueBook(qty, avg, price, n, NULL, &acct->revalued);
     }
-    if (!foundAny) {
-        printf("No stocks found in this sector.\n");
+    marketReadEnd(phase);
+}
+
+static void revalueAccounts(BookTotals *book, int workers) {
+    if (!valueBookKernel) selectValuationKernels();   // before threads race to it
+    parallelFor(accountCount, 16, workers, revalueAccountRange, NULL);
+
+    book->cost = book->value = 0;
+    for (int i = 0; i < accountCount; i++) {
+        book->cost += accounts[i]->revalued.cost;
+        book->value += accounts[i]->revalued.value;
+    }
+}
+
+void revalueAllAccounts(BookTotals *book) {
+    revalueAccounts(book, 0);
+}
+
+void showBookSummary() {
+    BookTotals book;
+    double start = monotonicSeconds();
+    revalueAllAccounts(&book);
+    double elapsed = monotonicSeconds() - start;
+
+    int positions = 0, priced = 0, best = -1, worst = -1;
+    double drift = 0;
+    for (int i = 0; i < accountCount; i++) {
+        const Account *acct = accounts[i];
+        double pnl = acct->revalued.value - acct->revalued.cost;
+        positions += acct->totals.holdings;
+        priced += acct->totals.pricedHoldings;
+        if (best < 0 || pnl > accounts[best]->revalued.value - accounts[best]->revalued.cost) best = i;
+        if (worst < 0 || pnl < accounts[worst]->revalued.value - accounts[worst]->revalued.cost) worst = i;
+        double d = fabs(acct->revalued.value - acct->totals.currentValue);
+        if (d > drift) drift = d;
     }
+
+    printf("\n----- Book Summary -----\n");
+    printf("Accounts: %d\n", accountCount);
+    printf("Positions: %d (%d priced)\n", positions, priced);
+    printf("Investment (priced): %.2f\n", book.cost);
+    printf("Current Value: %.2f\n", book.value);
+    printf("Net Profit/Loss: %.2f\n", book.value - book.cost);
+    if (best >= 0) {
+        printf("Best Account: %s (%.2f)\n", accounts[best]->name,
+               accounts[best]->revalued.value - accounts[best]->revalued.cost);
+        printf("Worst Account: %s (%.2f)\n", accounts[worst]->name,
+               accounts[worst]->revalued.value - accounts[worst]->revalued.cost);
+    }
+    printf("Revalued in %.3f ms on %d threads (%s kernel); max drift from running totals: %.6f\n",
+           elapsed * 1e3, poolSize, valuationKernelName, drift);
 }
 
+// ================= HOLDINGS REBUILD =================
+// Holdings and the transaction log are saved separately, so they can drift
+// apart (files edited by hand, or history that predates the journal).
+// verifyHoldings replays the log the way executeBuy and executeSell apply
+// trades and compares the result with the holdings table. Only the order of
+// one symbol's records matters, so the log is reduced per symbol in
+// parallel: workers hash blocks of records into symbol partitions, the
+// record indexes are scattered into one run per partition (block order
+// keeps them in log order), and each partition is then replayed by one
+// worker into its own table. Trades the table would have refused (sells of
+// more than the position or of a named lot that is not open for them, buys
+// past INT_MAX shares) are counted and skipped. Lots are replayed only when some sell names a relief other
+// than AVG.
+
+#define REBUILD_BLOCK 65536          // records per partitioning block
+#define REBUILD_MAX_PARTITIONS 256
+
 typedef struct {
     char symbol[MAX_SYMBOL_LEN];
-    char sector[MAX_SECTOR_LEN];
-    double price;
-} MarketView;
+    unsigned int hash;               // 0 = empty slot
+    int quantity;
+    double avgBuyPrice;
+    Timestamp lastBuyTime;
+    int refused;                     // trades the holdings table would reject
+    LotQueue lots;                   // only with HoldingsRebuild.needLots
+} RebuiltHolding;
+
+typedef struct {
+    RebuiltHolding *entries;         // open addressing by hash
+    int count;
+    int capacity;                    // power of two
+    int failed;
+} RebuildPartition;
+
+typedef struct {
+    const TransactionEntry *head;    // mapped snapshot records, then
+    int headCount;
+    const TransactionEntry *tail;    // the journal lines after them
+    int count;
+    unsigned int *hashes;            // per record
+    int *order;                      // record indexes grouped by partition
+    int *blockCounts;                // per block and partition; then offsets
+    unsigned char *blockReliefs;     // per block: a sell names a relief
+    int *partitionStart;             // partitions + 1 offsets into order
+    int blocks;
+    int partitions;                  // power of two
+    int partitionShift;              // partition = hash >> partitionShift
+    int needLots;
+    RebuildPartition *parts;
+} HoldingsRebuild;
+
+typedef struct {
+    char symbol[MAX_SYMBOL_LEN];
+    int heldQuantity;
+    double heldAvg;
+    const RebuiltHolding *rebuilt;   // NULL = not in the log
+} HoldingDifference;
+
+static const TransactionEntry *rebuildRecord(const HoldingsRebuild *r, int i) {
+    return i < r->headCount ? &r->head[i] : &r->tail[i - r->headCount];
+}
+
+// Hashes (never 0, so 0 marks empty slots) and counts one block's records
+static void hashRebuildBlocks(int begin, int end, void *ctx) {
+    HoldingsRebuild *r = ctx;
+    for (int b = begin; b < end; b++) {
+        int *counts = &r->blockCounts[(size_t)b * r->partitions];
+        int last = (b + 1) * REBUILD_BLOCK < r->count ? (b + 1) * REBUILD_BLOCK : r->count;
+        for (int i = b * REBUILD_BLOCK; i < last; i++) {
+            const TransactionEntry *t = rebuildRecord(r, i);
+            unsigned int h = hash(t->symbol) | 1;
+            r->hashes[i] = h;
+            counts[r->partitionShift < 32 ? h >> r->partitionShift : 0]++;
+            if (t->type == 1 && t->relief != RELIEF_AVERAGE) r->blockReliefs[b] = 1;
+        }
+    }
+}
+
+static void scatterRebuildBlocks(int begin, int end, void *ctx) {
+    HoldingsRebuild *r = ctx;
+    for (int b = begin; b < end; b++) {
+        int *next = &r->blockCounts[(size_t)b * r->partitions];
+        int last = (b + 1) * REBUILD_BLOCK < r->count ? (b + 1) * REBUILD_BLOCK : r->count;
+        for (int i = b * REBUILD_BLOCK; i < last; i++) {
+            unsigned int h = r->hashes[i];
+            r->order[next[r->partitionShift < 32 ? h >> r->partitionShift : 0]++] = i;
+        }
+    }
+}
+
+static RebuiltHolding *rebuiltEntry(RebuildPartition *part, const char *symbol, unsigned int h, int create) {
+    if (create && (part->count + 1) * 2 > part->capacity) {
+        int newCapacity = part->capacity ? part->capacity * 2 : 64;
+        RebuiltHolding *entries = calloc(newCapacity, sizeof(RebuiltHolding));
+        if (!entries) {
+            perror("Error growing holdings rebuild");
+            return NULL;
+        }
+        for (int i = 0; i < part->capacity; i++) {
+            if (part->entries[i].hash == 0) continue;
+            unsigned int pos = part->entries[i].hash & (newCapacity - 1);
+            while (entries[pos].hash != 0) pos = (pos + 1) & (newCapacity - 1);
+            entries[pos] = part->entries[i];
+        }
+        free(part->entries);
+        part->entries = entries;
+        part->capacity = newCapacity;
+    }
+    if (part->capacity == 0) return NULL;
+
+    unsigned int mask = part->capacity - 1;
+    for (unsigned int pos = h & mask;; pos = (pos + 1) & mask) {
+        RebuiltHolding *e = &part->entries[pos];
+        if (e->hash == h && strcmp(e->symbol, symbol) == 0) return e;
+        if (e->hash == 0) {
+            if (!create) return NULL;
+            e->hash = h;
+            strcpy(e->symbol, symbol);
+            part->count++;
+            return e;
+        }
+    }
+}
+
+// Replays each partition's records in log order, as executeBuy/executeSell
+static void reduceRebuildPartitions(int begin, int end, void *ctx) {
+    HoldingsRebuild *r = ctx;
+    for (int p = begin; p < end; p++) {
+        RebuildPartition *part = &r->parts[p];
+        for (int k = r->partitionStart[p]; k < r->partitionStart[p + 1] && !part->failed; k++) {
+            int i = r->order[k];
+            const TransactionEntry *t = rebuildRecord(r, i);
+            RebuiltHolding *e = rebuiltEntry(part, t->symbol, r->hashes[i], 1);
+            if (!e) {
+                part->failed = 1;
+                break;
+            }
+            if (t->type == 0) {
+                if (t->quantity <= 0) continue;
+                if (t->quantity > INT_MAX - e->quantity) {
+                    e->refused++;
+                    continue;
+                }
+                if (e->quantity == 0) e->avgBuyPrice = t->pricePerShare;
+                else e->avgBuyPrice = ((e->avgBuyPrice * e->quantity) + (t->pricePerShare * t->quantity)) /
+                                      (e->quantity + t->quantity);
+                e->quantity += t->quantity;
+                e->lastBuyTime = t->time;
+                Lot lot = { t->time, t->pricePerShare, t->quantity, i };
+                if (r->needLots && !pushLot(&e->lots, lot)) part->failed = 1;
+                continue;
+            }
+
+            int lotPos = t->relief >= 0 && r->needLots ? findLot(&e->lots, t->relief) : -1;
+            if (t->quantity <= 0 || t->quantity > e->quantity ||
+                (t->relief >= 0 && r->needLots && (lotPos < 0 || lotAt(&e->lots, lotPos)->quantity < t->quantity))) {
+                e->refused++;
+                continue;
+            }
+            e->quantity -= t->quantity;
+            if (r->needLots) relieveLots(&e->lots, t->quantity, t->relief, 1);
+            if (e->quantity == 0) e->avgBuyPrice = 0;
+            else if (r->needLots && t->relief != RELIEF_AVERAGE) e->avgBuyPrice = e->lots.basis / e->quantity;
+        }
+    }
+}
+
+static void freeHoldingsRebuild(HoldingsRebuild *r) {
+    if (r->parts) {
+        for (int p = 0; p < r->partitions; p++) {
+            for (int i = 0; i < r->parts[p].capacity; i++) free(r->parts[p].entries[i].lots.lots);
+            free(r->parts[p].entries);
+        }
+    }
+    free(r->parts);
+    free(r->hashes);
+    free(r->order);
+    free(r->blockCounts);
+    free(r->blockReliefs);
+    free(r->partitionStart);
+}
+
+static const RebuiltHolding *findRebuilt(const HoldingsRebuild *r, const char *symbol) {
+    unsigned int h = hash(symbol) | 1;
+    return rebuiltEntry(&r->parts[r->partitionShift < 32 ? h >> r->partitionShift : 0], symbol, h, 0);
+}
+
+// Reduces count records (head, then tail) into r; 0 if memory runs out
+static int reduceTransactionLog(HoldingsRebuild *r) {
+    int workers = startThreadPool();
+    r->partitions = 1;
+    r->partitionShift = 32;
+    while (r->partitions < workers * 4 && r->partitions < REBUILD_MAX_PARTITIONS) {
+        r->partitions *= 2;
+        r->partitionShift--;
+    }
+    r->blocks = (r->count + REBUILD_BLOCK - 1) / REBUILD_BLOCK;
+    r->hashes = malloc(sizeof(unsigned int) * (r->count > 0 ? r->count : 1));
+    r->order = malloc(sizeof(int) * (r->count > 0 ? r->count : 1));
+    r->blockCounts = calloc((size_t)(r->blocks > 0 ? r->blocks : 1) * r->partitions, sizeof(int));
+    r->blockReliefs = calloc(r->blocks > 0 ? r->blocks : 1, 1);
+    r->partitionStart = malloc(sizeof(int) * (r->partitions + 1));
+    r->parts = calloc(r->partitions, sizeof(RebuildPartition));
+    if (!r->hashes || !r->order || !r->blockCounts || !r->blockReliefs || !r->partitionStart || !r->parts) {
+        perror("Error allocating holdings rebuild");
+        return 0;
+    }
+
+    parallelFor(r->blocks, 1, 0, hashRebuildBlocks, r);
+
+    // Counts become each block's first position in its partition's run
+    int pos = 0;
+    for (int p = 0; p < r->partitions; p++) {
+        r->partitionStart[p] = pos;
+        for (int b = 0; b < r->blocks; b++) {
+            int *count = &r->blockCounts[(size_t)b * r->partitions + p];
+            int n = *count;
+            *count = pos;
+            pos += n;
+        }
+    }
+    r->partitionStart[r->partitions] = pos;
+    for (int b = 0; b < r->blocks; b++) r->needLots |= r->blockReliefs[b];
+
+    parallelFor(r->blocks, 1, 0, scatterRebuildBlocks, r);
+    parallelFor(r->partitions, 1, 0, reduceRebuildPartitions, r);
+
+    for (int p = 0; p < r->partitions; p++) {
+        if (r->parts[p].failed) return 0;
+    }
+    return 1;
+}
+
+static int cmpHoldingDifferences(const void *a, const void *b) {
+    return strcmp(((const HoldingDifference *)a)->symbol, ((const HoldingDifference *)b)->symbol);
+}
+
+// Makes the holding of d->symbol what the log says
+static void applyRebuiltHolding(Account *acct, const HoldingDifference *d) {
+    const RebuiltHolding *e = d->rebuilt;
+    SymbolKey key = internSymbolKey(d->symbol);
+    int found = 0;
+    int slot = findHoldingSlotByKey(acct, key, &found);
+    if (slot == -1) {
+        printf("Error: Holdings table is full; %s not rebuilt.\n", d->symbol);
+        return;
+    }
+    HoldingEntry *h = &acct->holdings[slot];
+
+    if (!e || e->quantity == 0) {
+        if (!found) return;
+        removeHoldingFromSector(acct, slot);
+        h->status = EMPTY;
+        refreshHoldingAggregate(acct, slot);
+        recordHoldingChange(acct, slot);
+        removeHoldingSlot(acct, slot, 1);
+        return;
+    }
+    if (!found) {
+        int row = findMarketRowByKey(key);
+        occupyHoldingSlot(acct, slot, key, d->symbol);
+        h->sectorId = row != -1 ? marketSectorIds[row] : internSector("UNKNOWN");
+        addHoldingToSector(acct, slot);
+    }
+    h->quantity = e->quantity;
+    h->avgBuyPrice = e->avgBuyPrice;
+    h->lastBuyTime = e->lastBuyTime;
+    refreshHoldingAggregate(acct, slot);
+    recordHoldingChange(acct, slot);
+}
+
+// Rebuilds acct's holdings from its transaction log and prints where the
+// holdings table differs; with rebuild the table is set to the log's
+// result. Returns the number of differences, or -1 if the log could not be
+// reduced.
+int verifyHoldings(Account *acct, int rebuild) {
+    double start = monotonicSeconds();
+    if (acct->journal) fflush(acct->journal);
+
+    HoldingsRebuild r;
+    memset(&r, 0, sizeof(r));
+    const SnapshotHeader *snapshot = NULL;
+    size_t mapSize = 0;
+    void *rows = NULL;
+    size_t tailCount = 0;
+    FILE *fp = fopen(acct->transactionFile, "r");
+    if (fp) {
+        fclose(fp);
+        long offset = 0;
+        if (useSnapshots && (snapshot = mapTransactionSnapshot(acct->transactionFile, &mapSize)) != NULL) {
+            r.head = (const TransactionEntry *)(snapshot + 1);
+            r.headCount = (int)snapshot->count;
+            offset = (long)snapshot->sourceSize;
+        }
+        if (!parseTextFileParallel(acct->transactionFile, offset, parseTransactionLine, sizeof(TransactionEntry), &rows, &tailCount, NULL)) {
+            if (snapshot) munmap((void *)snapshot, mapSize);
+            return -1;
+        }
+        r.tail = rows;
+    }
+    r.count = r.headCount + (int)tailCount;
+
+    int differences = -1;
+    HoldingDifference *diffs = NULL;
+    int symbols = 0;
+    int reduced = reduceTransactionLog(&r);
+    for (int p = 0; reduced && p < r.partitions; p++) symbols += r.parts[p].count;
+    if (reduced && (diffs = malloc(sizeof(HoldingDifference) * (TABLE_SIZE + symbols))) != NULL) {
+        int n = 0, refused = 0;
+        for (int p = 0; p < r.partitions; p++) {
+            const RebuildPartition *part = &r.parts[p];
+            for (int i = 0; i < part->capacity; i++) {
+                const RebuiltHolding *e = &part->entries[i];
+                if (e->hash == 0) continue;
+                refused += e->refused;
+                int found = 0;
+                int slot = findHoldingSlot(acct, e->symbol, &found);
+                const HoldingEntry *h = found ? &acct->holdings[slot] : NULL;
+                if (!h && e->quantity == 0) continue;
+                if (h && h->quantity == e->quantity &&
+                    fabs(h->avgBuyPrice - e->avgBuyPrice) <= PRICE_TOLERANCE * fmax(1.0, fabs(e->avgBuyPrice)))
+                    continue;
+                HoldingDifference *d = &diffs[n++];
+                strcpy(d->symbol, e->symbol);
+                d->heldQuantity = h ? h->quantity : 0;
+                d->heldAvg = h ? h->avgBuyPrice : 0;
+                d->rebuilt = e;
+            }
+        }
+        for (int slot = 0; slot < TABLE_SIZE; slot++) {
+            const HoldingEntry *h = &acct->holdings[slot];
+            if (h->status != OCCUPIED || findRebuilt(&r, h->symbol)) continue;
+            HoldingDifference *d = &diffs[n++];
+            strcpy(d->symbol, h->symbol);
+            d->heldQuantity = h->quantity;
+            d->heldAvg = h->avgBuyPrice;
+            d->rebuilt = NULL;
+        }
+        qsort(diffs, n, sizeof(HoldingDifference), cmpHoldingDifferences);
+        double elapsed = monotonicSeconds() - start;
+
+        printf("\n----- Holdings vs Transaction Log (%s) -----\n", acct->name);
+        for (int i = 0; i < n; i++) {
+            const HoldingDifference *d = &diffs[i];
+            int logQty = d->rebuilt ? d->rebuilt->quantity : 0;
+            printf("%-12s | Held: %d @ %.2f | Log: %d @ %.2f\n", d->symbol,
+                   d->heldQuantity, d->heldAvg, logQty, logQty > 0 ? d->rebuilt->avgBuyPrice : 0.0);
+        }
+        printf("%d transactions, %d symbols, %d refused trades: %d differences (%.1f ms on %d threads)\n",
+               r.count, symbols, refused, n, elapsed * 1e3, poolSize);
+
+        if (rebuild && n > 0) {
+            for (int i = 0; i < n; i++) applyRebuiltHolding(acct, &diffs[i]);
+            if (acct->historyLoaded) {
+                // The lots were reconciled against the old holdings
+                loadTransactionsFromFile(acct);
+                reconcileLots(acct);
+            }
+            printf("Holdings rebuilt from the transaction log.\n");
+        }
+        if (acct->historyLoaded) checkTaxLots(acct);
+        differences = n;
+    }
 
-int cmpMarketByPrice(const void *a, const void *b) {
-    const MarketView *x = (const MarketView *)a;
-    const MarketView *y = (const MarketView *)b;
-    if (x->price < y->price) return -1;
-    if (x->price > y->price) return  1;
-    return strcmp(x->symbol, y->symbol);
+    free(diffs);
+    freeHoldingsRebuild(&r);
+    free(rows);
+    if (snapshot) munmap((void *)snapshot, mapSize);
+    return differences;
 }
 
-int cmpMarketBySector(const void *a, const void *b) {
-    const MarketView *x = (const MarketView *)a;
-    const MarketView *y = (const MarketView *)b;
-    int cmp = strcasecmp(x->sector, y->sector);
-    if (cmp != 0) return cmp;
-    return strcmp(x->symbol, y->symbol);
+// ================= BATCH MODE =================
+
+// Persists everything applied since the last checkpoint
+static void batchCheckpoint() {
+    for (int i = 0; i < accountCount; i++) {
+        syncTransactionJournal(accounts[i]);
+        syncHoldingJournal(accounts[i]);
+    }
+    saveMarketToFile(MARKET_FILE);
 }
 
-void displayAllMarketStocksInteractive() {
-    int count = 0;
-    MarketView temp[TABLE_SIZE];
+// Applies one order line; returns 1 for a trade, 2 for a price update,
+// 0 for blank/comment/checkpoint/account/stats lines and -1 for a rejected line.
+static int applyBatchLine(char *line, Timestamp defaultTime) {
+    char *cmd = strtok(line, " \t\r\n");
+    if (!cmd || cmd[0] == '#') return 0;
+    toUpperStr(cmd);
 
-    for (int i = 0; i < TABLE_SIZE; i++) {
-        if (marketTable[i].status == OCCUPIED) {
-            strcpy(temp[count].symbol, marketTable[i].symbol);
-            strcpy(temp[count].sector, marketTable[i].sector);
-            temp[count].price = marketTable[i].price;
-            count++;
+    if (strcmp(cmd, "CHECKPOINT") == 0) {
+        batchCheckpoint();
+        return 0;
+    }
+    if (strcmp(cmd, "STATS") == 0) {
+        showTableHealth();
+        return 0;
+    }
+    if (strcmp(cmd, "LOTS") == 0) {
+        showTaxLots(activeAccount);
+        return 0;
+    }
+    if (strcmp(cmd, "LEADERS") == 0) {
+        // LEADERS [k]
+        char *kArg = strtok(NULL, " \t\r\n");
+        int k = kArg ? atoi(kArg) : LEADERBOARD_DEFAULT_K;
+        if (k <= 0) return -1;
+        showLeaderboard(k);
+        return 0;
+    }
+    if (strcmp(cmd, "HISTORY") == 0) {
+        // HISTORY [symbol|-] [from|-] [to|-] [BUY|SELL|-] [offset] [limit]
+        const char *args[4] = { "-", "-", "-", "-" };
+        for (int i = 0; i < 4; i++) {
+            char *arg = strtok(NULL, " \t\r\n");
+            if (!arg) break;
+            args[i] = arg;
         }
+        char *offsetArg = strtok(NULL, " \t\r\n");
+        char *limitArg = strtok(NULL, " \t\r\n");
+        int offset = offsetArg ? atoi(offsetArg) : 0;
+        int limit = limitArg ? atoi(limitArg) : HISTORY_PAGE_SIZE;
+        HistoryQuery q;
+        if (offset < 0 || limit < 0 || !makeHistoryQuery(args[0], args[1], args[2], args[3], &q)) return -1;
+        printf("HISTORY %s %s %s %s\n", args[0], args[1], args[2], args[3]);
+        int total = printHistoryMatches(activeAccount, &q, offset, limit);
+        if (total < 0) return -1;
+        printf("%d matching\n", total);
+        return 0;
     }
-
-    if (count == 0) {
-        printf("No market stocks available.\n");
-        return;
+    if (strcmp(cmd, "ACCOUNT") == 0) {
+        // ACCOUNT <name>; later trades go to that account
+        char *nameArg = strtok(NULL, " \t\r\n");
+        Account *acct = nameArg ? openAccount(nameArg) : NULL;
+        return acct && activateAccount(acct) ? 0 : -1;
     }
 
-    int sortChoice;
-    printf("\nSort market stocks by:\n");
-    printf("1. No sorting\n");
-    printf("2. By price\n");
-    printf("3. By sector\n");
-    printf("Enter choice: ");
-    if (scanf("%d", &sortChoice) != 1) {
-        printf("Invalid input.\n");
-        clearInputBuffer();
-        return;
+    char *symArg = strtok(NULL, " \t\r\n");
+    if (!symArg || strlen(symArg) >= MAX_SYMBOL_LEN) return -1;
+    char symbol[MAX_SYMBOL_LEN];
+    strcpy(symbol, symArg);
+    toUpperStr(symbol);
+
+    if (strcmp(cmd, "PRICE") == 0) {
+        // PRICE <symbol> <price> [sector]
+        char *priceArg = strtok(NULL, " \t\r\n");
+        char *sectorArg = strtok(NULL, " \t\r\n");
+        char *end;
+        double price = priceArg ? strtod(priceArg, &end) : 0;
+        if (!priceArg || *end != '\0' || !isValidPrice(price)) return -1;
+
+        char sector[MAX_SECTOR_LEN] = "UNKNOWN";
+        int row = findMarketSlot(symbol, NULL);
+        if (sectorArg && strlen(sectorArg) < MAX_SECTOR_LEN) {
+            strcpy(sector, sectorArg);
+            toUpperStr(sector);
+        } else if (row != -1) {
+            strcpy(sector, sectorName(marketSectorIds[row]));
+        }
+        return upsertMarketStock(symbol, sector, price, NULL) == -1 ? -1 : 2;
     }
-    clearInputBuffer();
 
-    if (sortChoice == 2) {
-        qsort(temp, count, sizeof(MarketView), cmpMarketByPrice);
-    } else if (sortChoice == 3) {
-        qsort(temp, count, sizeof(MarketView), cmpMarketBySector);
+    char *qtyArg = strtok(NULL, " \t\r\n");
+    char *priceArg = strtok(NULL, " \t\r\n");
+    char *dateArg = strtok(NULL, " \t\r\n");
+    char *reliefArg = strtok(NULL, " \t\r\n");
+    char *end;
+    long qty = qtyArg ? strtol(qtyArg, &end, 10) : 0;
+    if (!qtyArg || *end != '\0' || qty <= 0 || qty > 1000000000L) return -1;
+
+    int row = findMarketSlot(symbol, NULL);
+    double price = 0;
+    if (priceArg && strcmp(priceArg, "-") != 0) {
+        price = strtod(priceArg, &end);
+        if (*end != '\0' || !isValidPrice(price)) return -1;
+    } else if (row != -1) {
+        price = marketPrices[row];   // default to the market price
+    } else {
+        return -1;
     }
+    Timestamp time = defaultTime;
+    if (dateArg && strcmp(dateArg, "-") != 0 && !parseTimestamp(dateArg, &time, NULL)) return -1;
 
-    printf("\n----- Market Stocks -----\n");
-    for (int i = 0; i < count; i++) {
-        printf("%-12s | %-10s | Price: %.2f\n",
-               temp[i].symbol, temp[i].sector, temp[i].price);
+    if (strcmp(cmd, "BUY") == 0) {
+        // BUY <symbol> <qty> [price|-] [date]; symbol must be listed
+        if (row == -1) return -1;
+        int found = 0;
+        return executeBuy(activeAccount, symbol, sectorName(marketSectorIds[row]), (int)qty, price, time, &found) == -1 ? -1 : 1;
     }
-    printf("---------------------------------\n");
+    if (strcmp(cmd, "SELL") == 0) {
+        // SELL <symbol> <qty> [price|-] [date|-] [AVG|FIFO|LIFO|lot id]
+        int relief = defaultRelief;
+        if (reliefArg && !parseRelief(reliefArg, &relief)) return -1;
+        return executeSell(activeAccount, symbol, (int)qty, price, time, relief) == -1 ? -1 : 1;
+    }
+    return -1;
 }
 
-int saveMarketToFile(const char *filename) {
-    FILE *fp = fopen(filename, "w");
+// Headless order replay: reads BUY/SELL/PRICE/ACCOUNT/CHECKPOINT/STATS/HISTORY/LOTS/LEADERS lines from a file
+// (or stdin for "-") and applies them through the same trade logic as the
+// menu. Persistence is deferred to checkpoints and the end of the batch.
+int runBatchOrders(const char *filename, int checkpointEvery) {
+    FILE *fp = strcmp(filename, "-") == 0 ? stdin : fopen(filename, "r");
     if (!fp) {
-        perror("Error opening market file for saving");
+        perror("Error opening batch order file");
         return 0;
     }
 
-    for (int i = 0; i < TABLE_SIZE; i++) {
-        if (marketTable[i].status == OCCUPIED) {
-            fprintf(fp, "%s %s %.10f\n",
-                    marketTable[i].symbol,
-                    marketTable[i].sector,
-                    marketTable[i].price);
+    Timestamp defaultTime = currentTimestamp();
+
+    journalDeferred = 1;
+
+    char line[256];
+    long lineNo = 0, trades = 0, priceUpdates = 0, rejected = 0;
+    long sinceCheckpoint = 0;
+    double start = monotonicSeconds();
+
+    while (fgets(line, sizeof(line), fp)) {
+        lineNo++;
+        int result = applyBatchLine(line, defaultTime);
+        if (result == 1) {
+            trades++;
+            if (checkpointEvery > 0 && ++sinceCheckpoint >= checkpointEvery) {
+                batchCheckpoint();
+                sinceCheckpoint = 0;
+            }
+        } else if (result == 2) {
+            priceUpdates++;
+        } else if (result == -1) {
+            rejected++;
+            fprintf(stderr, "Batch line %ld rejected\n", lineNo);
         }
     }
+    double applied = monotonicSeconds();
 
-    fclose(fp);
-    return 1;
+    batchCheckpoint();
+    saveDirtyAccounts();   // fold the journal tails into checkpoints
+    journalDeferred = 0;
+    double finished = monotonicSeconds();
+
+    if (fp != stdin) fclose(fp);
+
+    double elapsed = applied - start;
+    printf("Batch complete: %ld trades, %ld price updates, %ld rejected lines\n",
+           trades, priceUpdates, rejected);
+    printf("Apply time: %.3f s (%.0f trades/sec), persist time: %.3f s\n",
+           elapsed, elapsed > 0 ? trades / elapsed : 0.0, finished - applied);
+    return rejected == 0;
 }
 
-int loadMarketFromFile(const char *filename) {
-    FILE *fp = fopen(filename, "r");
-    if (!fp) {
-        return 0;
+// ================= PRICE TICKS =================
+// Streaming price feed of "SYMBOL PRICE [SENT_NS]" lines from a file, a FIFO
+// or stdin. A tick updates its market row in place and revalues only the
+// holding linked to that row. SENT_NS is the sender's CLOCK_MONOTONIC time
+// in nanoseconds (at most 19 digits), so the reported latency includes time
+// spent queued in the pipe. Without it latency is measured from the read()
+// that delivered the tick, so it includes the time the tick waited behind
+// the ones before it in the same read (up to TICK_READ_SIZE bytes).
+
+static long long monotonicNanos() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static volatile sig_atomic_t tickStopRequested = 0;
+
+static void onTickStopSignal(int sig) {
+    (void)sig;
+    tickStopRequested = 1;
+}
+
+// Uniform reservoir sample (Algorithm R) of the latencies: after n ticks
+// each one is in the sample with probability TICK_LATENCY_SAMPLES / n, so
+// the percentiles are those of a uniform random sample of every tick
+// (exact until the reservoir fills); max is tracked exactly
+typedef struct {
+    long long samples[TICK_LATENCY_SAMPLES];
+    long long seen;
+    long long max;
+    unsigned int rng;
+} LatencySampler;
+
+static void recordLatency(LatencySampler *ls, long long ns) {
+    if (ns > ls->max) ls->max = ns;
+    if (ls->seen < TICK_LATENCY_SAMPLES) {
+        ls->samples[ls->seen++] = ns;
+        return;
     }
+    ls->rng ^= ls->rng << 13;
+    ls->rng ^= ls->rng >> 17;
+    ls->rng ^= ls->rng << 5;
+    long long j = ls->rng % (unsigned long long)++ls->seen;
+    if (j < TICK_LATENCY_SAMPLES) ls->samples[j] = ns;
+}
 
-    initMarketTable();
+static int cmpLongLong(const void *a, const void *b) {
+    long long x = *(const long long *)a, y = *(const long long *)b;
+    return x < y ? -1 : (x > y ? 1 : 0);
+}
 
+// Applies one tick line. Returns 2 if a holding was revalued, 1 if only the
+// market row changed, 0 for an unlisted symbol and -1 for a malformed line
+// (a price isValidPrice refuses, e.g. inf, nan or one not above zero, included).
+static int applyPriceTick(const char *p, const char *end, long long *sentNs) {
     char symbol[MAX_SYMBOL_LEN];
-    char sector[MAX_SECTOR_LEN];
     double price;
+    p = parseTokenField(p, end, symbol, MAX_SYMBOL_LEN);
+    if (p) p = parseDoubleField(p, end, &price);
+    if (!p || !isValidPrice(price)) return -1;
+
+    *sentNs = 0;
+    p = skipFieldSpace(p, end);
+    for (int digits = 0; p < end && *p >= '0' && *p <= '9'; digits++) {
+        int d = *p++ - '0';
+        if (digits == 19 || *sentNs > (LLONG_MAX - d) / 10) return -1;
+        *sentNs = *sentNs * 10 + d;
+    }
+    if (!atLineEnd(p, end)) return -1;
 
-    while (fscanf(fp, "%15s %19s %lf", symbol, sector, &price) == 3) {
-        // Convert symbol to uppercase
-        toUpperStr(symbol);
-        toUpperStr(sector);
+    toUpperStr(symbol);
+    int row = findMarketSlot(symbol, NULL);
+    if (row == -1) return 0;
+    setMarketPrice(row, price);
+    return marketHolders[row].count > 0 ? 2 : 1;
+}
 
-        
-        int found = 0;
-        int slot = findMarketSlot(symbol, &found);
-        if (slot != -1) {
-            strcpy(marketTable[slot].symbol, symbol);
-            strcpy(marketTable[slot].sector, sector);
-            marketTable[slot].price = price;
-            marketTable[slot].status = OCCUPIED;
+// Reads ticks until end of input (or, with follow, until interrupted),
+// then saves the market once and prints throughput and latency.
+int runPriceTicks(const char *filename, int follow) {
+    int fd = strcmp(filename, "-") == 0 ? STDIN_FILENO : open(filename, O_RDONLY);
+    if (fd < 0) {
+        perror("Error opening tick feed");
+        return 0;
+    }
+    char *buf = malloc(TICK_READ_SIZE);
+    LatencySampler *latency = calloc(1, sizeof(LatencySampler));
+    if (!buf || !latency) {
+        perror("Error allocating tick buffers");
+        free(buf);
+        free(latency);
+        if (fd != STDIN_FILENO) close(fd);
+        return 0;
+    }
+    latency->rng = 2463534242U;
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = onTickStopSignal;   // no SA_RESTART: a blocked read returns
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    long applied = 0, revalued = 0, unknown = 0, malformed = 0;
+    long long firstNs = 0, lastNs = 0;
+    size_t len = 0;
+    int eof = 0;
+
+    while (!eof && !tickStopRequested) {
+        ssize_t n = read(fd, buf + len, TICK_READ_SIZE - len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            perror("Error reading tick feed");
+            break;
+        }
+        if (n == 0) {
+            if (follow) {
+                usleep(1000);
+                continue;
+            }
+            eof = 1;
+            if (len > 0) buf[len++] = '\n';   // last line without a newline
+        }
+        len += n;
+        long long readNs = monotonicNanos();
+
+        char *p = buf, *end = buf + len;
+        char *nl;
+        while ((nl = memchr(p, '\n', end - p)) != NULL) {
+            long long sentNs;
+            int result = applyPriceTick(p, nl, &sentNs);
+            p = nl + 1;
+            if (result < 0) {
+                malformed++;
+                continue;
+            }
+            if (result == 0) {
+                unknown++;
+                continue;
+            }
+            long long doneNs = monotonicNanos();
+            if (applied++ == 0) firstNs = readNs;
+            lastNs = doneNs;
+            if (result == 2) revalued++;
+            recordLatency(latency, doneNs - (sentNs > 0 ? sentNs : readNs));
+        }
+        len = end - p;
+        if (len == TICK_READ_SIZE) {
+            malformed++;    // a single line filled the buffer; drop it
+            len = 0;
         }
+        memmove(buf, p, len);
     }
 
-    fclose(fp);
-    return 1;
+    signal(SIGINT, SIG_DFL);
+    signal(SIGTERM, SIG_DFL);
+    if (fd != STDIN_FILENO) close(fd);
+    free(buf);
+
+    double persistStart = monotonicSeconds();
+    if (applied > 0) saveMarketToFile(MARKET_FILE);
+    double persistTime = monotonicSeconds() - persistStart;
+
+    double elapsed = (lastNs - firstNs) / 1e9;
+    printf("Ticks: %ld applied (%ld revalued a holding), %ld unlisted symbols, %ld malformed lines\n",
+           applied, revalued, unknown, malformed);
+    printf("Throughput: %.0f ticks/sec over %.3f s, persist time: %.3f s\n",
+           elapsed > 0 ? applied / elapsed : 0.0, elapsed, persistTime);
+    if (latency->seen > 0) {
+        int samples = latency->seen < TICK_LATENCY_SAMPLES ? (int)latency->seen : TICK_LATENCY_SAMPLES;
+        qsort(latency->samples, samples, sizeof(long long), cmpLongLong);
+        printf("Tick-to-revaluation latency (us): p50 %.1f, p99 %.1f, p99.9 %.1f, max %.1f\n",
+               latency->samples[samples / 2] / 1e3,
+               latency->samples[(int)(samples * 0.99)] / 1e3,
+               latency->samples[(int)(samples * 0.999)] / 1e3,
+               latency->max / 1e3);
+    }
+    free(latency);
+    return malformed == 0;
 }
 
-// ================= HOLDINGS TABLE (User) =================
-
-void initHoldingTable() {
-    for (int i = 0; i < TABLE_SIZE; i++) {
-        holdingTable[i].status = EMPTY;
-        holdingTable[i].symbol[0] = '\0';
-        holdingTable[i].sector[0] = '\0';
-        holdingTable[i].quantity = 0;
-        holdingTable[i].avgBuyPrice = 0.0;
-        holdingTable[i].lastBuyDate[0] = '\0';
+// Local stand-in for a market data feed: writes count ticks for random
+// listed symbols to stdout as a random walk, stamped with the send time.
+// ratePerSec > 0 paces the output; 0 writes as fast as the reader drains.
+int generatePriceTicks(long count, long ratePerSec) {
+    if (marketCount == 0) {
+        fprintf(stderr, "No market data to generate ticks for.\n");
+        return 0;
+    }
+    setvbuf(stdout, NULL, _IOFBF, 1 << 16);
+    unsigned int rng = 88172645U;
+    long long start = monotonicNanos();
+
+    for (long i = 0; i < count; i++) {
+        rng ^= rng << 13;
+        rng ^= rng >> 17;
+        rng ^= rng << 5;
+        int row = rng % marketCount;
+        double step = ((int)(rng >> 8 & 0xff) - 127.5) / 12750.0;   // within +-1%
+        marketPrices[row] *= 1.0 + step;
+        if (marketPrices[row] < 0.01) marketPrices[row] = 0.01;
+
+        if (ratePerSec > 0 && (i & 63) == 0) {
+            fflush(stdout);
+            long long due = start + (long long)(i * (1e9 / ratePerSec));
+            long long now = monotonicNanos();
+            if (due > now) {
+                struct timespec ts = { (due - now) / 1000000000LL, (due - now) % 1000000000LL };
+                nanosleep(&ts, NULL);
+            }
+        }
+        if (printf("%s %.4f %lld\n", marketSymbols[row], marketPrices[row],
+                   monotonicNanos()) < 0)
+            return 0;   // reader went away
     }
+    fflush(stdout);
+    return 1;
 }
 
-int findHoldingSlot(const char *symbol, int *found) {
-    unsigned int index = hash(symbol);
-    int firstDeletedIndex = -1;
+// ================= BENCHMARKS =================
 
-    if (found) *found = 0;
+// The fscanf loops the loaders used before the fast text loader; kept here
+// only as the baseline for --bench-parse. Returns rows, *sum is a checksum.
+static long scanfParseFile(const char *filename, int kind, double *sum) {
+    FILE *fp = fopen(filename, "r");
+    if (!fp) return -1;
 
-    for (int i = 0; i < TABLE_SIZE; i++) {
-        int current = (index + i) % TABLE_SIZE;
+    char symbol[MAX_SYMBOL_LEN], sector[MAX_SECTOR_LEN], date[MAX_DATE_LEN];
+    int quantity, type;
+    double price;
+    long rows = 0;
+    *sum = 0;
 
-        if (holdingTable[current].status == EMPTY) {
-            return (firstDeletedIndex != -1) ? firstDeletedIndex : current;
+    if (kind == SNAPSHOT_MARKET) {
+        while (fscanf(fp, "%15s %19s %lf", symbol, sector, &price) == 3) {
+            *sum += price;
+            rows++;
         }
-
-        if (holdingTable[current].status == DELETED) {
-            if (firstDeletedIndex == -1)
-                firstDeletedIndex = current;
-        } else if (holdingTable[current].status == OCCUPIED &&
-                   equalsIgnoreCase(holdingTable[current].symbol, symbol)) {
-            if (found) *found = 1;
-            return current;
+    } else if (kind == SNAPSHOT_HOLDINGS) {
+        while (fscanf(fp, "%15s %19s %d %lf %31s", symbol, sector, &quantity, &price, date) == 5) {
+            *sum += price * quantity;
+            rows++;
+        }
+    } else {
+        // %*[^\n] skips the optional relief column
+        while (fscanf(fp, "%15s %d %lf %31s %d%*[^\n]", symbol, &quantity, &price, date, &type) == 5) {
+            *sum += price * quantity;
+            rows++;
         }
     }
-    return firstDeletedIndex;
+    fclose(fp);
+    return rows;
 }
 
-// ================= TRANSACTION FUNCTIONS =================
-
-void addTransaction(const char *symbol, int quantity, double price, const char *date, int type) {
-    if (transactionCount >= MAX_TRANSACTIONS) {
-        // Shift old transactions to make room
-        for (int i = 0; i < MAX_TRANSACTIONS - 1; i++) {
-            transactionHistory[i] = transactionHistory[i + 1];
+static long fastParseFile(const char *filename, int kind, double *sum) {
+    void *rows;
+    size_t count;
+    *sum = 0;
+
+    if (kind == SNAPSHOT_MARKET) {
+        if (!parseTextFileParallel(filename, 0, parseMarketLine, sizeof(MarketTextRow), &rows, &count, NULL)) return -1;
+        for (size_t i = 0; i < count; i++) *sum += ((MarketTextRow *)rows)[i].price;
+    } else if (kind == SNAPSHOT_HOLDINGS) {
+        if (!parseTextFileParallel(filename, 0, parseHoldingLine, sizeof(HoldingTextRow), &rows, &count, NULL)) return -1;
+        for (size_t i = 0; i < count; i++) {
+            const HoldingTextRow *h = &((HoldingTextRow *)rows)[i];
+            *sum += h->avgBuyPrice * h->quantity;
+        }
+    } else {
+        if (!parseTextFileParallel(filename, 0, parseTransactionLine, sizeof(TransactionEntry), &rows, &count, NULL)) return -1;
+        for (size_t i = 0; i < count; i++) {
+            const TransactionEntry *t = &((TransactionEntry *)rows)[i];
+            *sum += t->pricePerShare * t->quantity;
         }
-        transactionCount = MAX_TRANSACTIONS - 1;
     }
-    
-    strcpy(transactionHistory[transactionCount].symbol, symbol);
-    transactionHistory[transactionCount].quantity = quantity;
-    transactionHistory[transactionCount].pricePerShare = price;
-    strcpy(transactionHistory[transactionCount].date, date);
-    transactionHistory[transactionCount].type = type;
-    transactionCount++;
+    free(rows);
+    return (long)count;
 }
 
-void saveTransactionsToFile(const char *filename) {
-    FILE *fp = fopen(filename, "w");
-    if (!fp) {
-        perror("Error opening transaction file for saving");
-        return;
+// Compares the fscanf loops with the fast loader on the current data files.
+// Best of three runs each; the checksums must agree.
+void benchmarkTextParsers() {
+    const char *files[] = { MARKET_FILE, USER_FILE, TRANSACTION_FILE };
+    const int kinds[] = { SNAPSHOT_MARKET, SNAPSHOT_HOLDINGS, SNAPSHOT_TRANSACTIONS };
+
+    printf("%-20s %10s %12s %12s %8s %s\n",
+           "file", "rows", "fscanf_ms", "fast_ms", "speedup", "checksum");
+    for (int f = 0; f < 3; f++) {
+        double best[2] = { 1e30, 1e30 }, sums[2] = { 0, 0 };
+        long rows[2] = { -1, -1 };
+
+        for (int run = 0; run < 3; run++) {
+            for (int which = 0; which < 2; which++) {
+                double start = monotonicSeconds();
+                rows[which] = which == 0 ? scanfParseFile(files[f], kinds[f], &sums[which])
+                                         : fastParseFile(files[f], kinds[f], &sums[which]);
+                double elapsed = monotonicSeconds() - start;
+                if (elapsed < best[which]) best[which] = elapsed;
+            }
+        }
+        if (rows[0] < 0) {
+            printf("%-20s (missing)\n", files[f]);
+            continue;
+        }
+        int match = rows[0] == rows[1] && sums[0] == sums[1];
+        printf("%-20s %10ld %12.3f %12.3f %7.1fx %s\n",
+               files[f], rows[0], best[0] * 1e3, best[1] * 1e3,
+               best[1] > 0 ? best[0] / best[1] : 0.0, match ? "match" : "MISMATCH");
     }
+    printf("threads: %d\n", parseThreadCount());
+}
 
-    for (int i = 0; i < transactionCount; i++) {
-        fprintf(fp, "%s %d %.10f %s %d\n",
-                transactionHistory[i].symbol,
-                transactionHistory[i].quantity,
-                transactionHistory[i].pricePerShare,
-                transactionHistory[i].date,
-                transactionHistory[i].type);
+// Market layout benchmark: the same three scans over n synthetic rows, once
+// as an array of MarketEntry rows and once as the column arrays the market
+// table uses. Each query returns a checksum so the two can be compared.
+#define LAYOUT_BENCH_SECTORS 16
+
+static double scanMarketRows(const MarketEntry *rows, int n, int query) {
+    double acc = 0, lo = 100, hi = 200;
+    int sectorCounts[LAYOUT_BENCH_SECTORS] = { 0 };
+    for (int i = 0; i < n; i++) {
+        if (rows[i].status != OCCUPIED) continue;
+        if (query == 0) acc += rows[i].price;                                  // statistics
+        else if (query == 1) acc += rows[i].price >= lo && rows[i].price <= hi; // price filter
+        else sectorCounts[rows[i].sectorId]++;                                 // sector counts
     }
+    for (int s = 0; s < LAYOUT_BENCH_SECTORS; s++) acc += (double)sectorCounts[s] * (s + 1);
+    return acc;
+}
 
-    fclose(fp);
+static double scanMarketColumns(const double *prices, const int *sectorIds,
+                                const unsigned char *status, int n, int query) {
+    double acc = 0, lo = 100, hi = 200;
+    int sectorCounts[LAYOUT_BENCH_SECTORS] = { 0 };
+    for (int i = 0; i < n; i++) {
+        if (status[i] != OCCUPIED) continue;
+        if (query == 0) acc += prices[i];
+        else if (query == 1) acc += prices[i] >= lo && prices[i] <= hi;
+        else sectorCounts[sectorIds[i]]++;
+    }
+    for (int s = 0; s < LAYOUT_BENCH_SECTORS; s++) acc += (double)sectorCounts[s] * (s + 1);
+    return acc;
 }
 
-void loadTransactionsFromFile(const char *filename) {
-    FILE *fp = fopen(filename, "r");
-    if (!fp) {
+void benchmarkMarketLayout(int n) {
+    if (n <= 0) n = 1000000;
+    MarketEntry *rows = malloc(sizeof(MarketEntry) * n);
+    double *prices = malloc(sizeof(double) * n);
+    int *sectorIds = malloc(sizeof(int) * n);
+    unsigned char *status = malloc(n);
+    if (!rows || !prices || !sectorIds || !status) {
+        perror("Error allocating benchmark rows");
+        free(rows); free(prices); free(sectorIds); free(status);
         return;
     }
 
-    transactionCount = 0;
-    char symbol[MAX_SYMBOL_LEN];
-    int quantity;
-    double price;
-    char date[MAX_DATE_LEN];
-    int type;
+    unsigned int rng = 12345U;
+    for (int i = 0; i < n; i++) {
+        rng = rng * 1103515245U + 12345U;
+        snprintf(rows[i].symbol, MAX_SYMBOL_LEN, "S%07d", i);
+        rows[i].price = prices[i] = 1.0 + (rng >> 8) % 100000 / 100.0;
+        rows[i].sectorId = sectorIds[i] = (rng >> 4) % LAYOUT_BENCH_SECTORS;
+        rows[i].status = status[i] = OCCUPIED;
+    }
 
-    while (fscanf(fp, "%15s %d %lf %31s %d", 
-                  symbol, &quantity, &price, date, &type) == 5) {
-        if (transactionCount < MAX_TRANSACTIONS) {
-            strcpy(transactionHistory[transactionCount].symbol, symbol);
-            transactionHistory[transactionCount].quantity = quantity;
-            transactionHistory[transactionCount].pricePerShare = price;
-            strcpy(transactionHistory[transactionCount].date, date);
-            transactionHistory[transactionCount].type = type;
-            transactionCount++;
+    const char *queries[] = { "price statistics", "price range count", "sector counts" };
+    printf("%d rows; row layout %zu bytes/row, columns read by the scans %zu bytes/row\n",
+           n, sizeof(MarketEntry), sizeof(double) + sizeof(int) + 1);
+    printf("%-20s %12s %12s %8s %s\n", "query", "rows_ns/row", "cols_ns/row", "speedup", "checksum");
+    for (int q = 0; q < 3; q++) {
+        double best[2] = { 1e30, 1e30 }, sums[2] = { 0, 0 };
+        for (int run = 0; run < 5; run++) {
+            for (int which = 0; which < 2; which++) {
+                double start = monotonicSeconds();
+                sums[which] = which == 0 ? scanMarketRows(rows, n, q)
+                                         : scanMarketColumns(prices, sectorIds, status, n, q);
+                double elapsed = monotonicSeconds() - start;
+                if (elapsed < best[which]) best[which] = elapsed;
+            }
         }
+        printf("%-20s %12.3f %12.3f %7.1fx %s\n", queries[q],
+               best[0] * 1e9 / n, best[1] * 1e9 / n,
+               best[1] > 0 ? best[0] / best[1] : 0.0, sums[0] == sums[1] ? "match" : "MISMATCH");
     }
-
-    fclose(fp);
+    free(rows);
+    free(prices);
+    free(sectorIds);
+    free(status);
 }
 
-void viewTransactionHistory() {
-    printf("\n----- Transaction History -----\n");
-    
-    if (transactionCount == 0) {
-        printf("No transaction history found.\n");
+// Valuation benchmark: full revaluation (cost, value and per-position P&L)
+// and price statistics over n synthetic positions, scalar against the
+// kernel selected for this CPU.
+void benchmarkValuation(int n) {
+    if (n <= 0) n = 100000;
+    int *qty = malloc(sizeof(int) * n);
+    double *avg = malloc(sizeof(double) * n);
+    double *price = malloc(sizeof(double) * n);
+    double *pnl = malloc(sizeof(double) * n);
+    if (!qty || !avg || !price || !pnl) {
+        perror("Error allocating benchmark positions");
+        free(qty); free(avg); free(price); free(pnl);
         return;
     }
-    
-    printf("%-12s | Type  | Qty | Price/Share | Date/Time\n", "Symbol");
-    printf("---------------------------------------------------------\n");
-    
-    for (int i = 0; i < transactionCount; i++) {
-        printf("%-12s | %-5s | %3d | %11.2f | %s\n",
-               transactionHistory[i].symbol,
-               transactionHistory[i].type == 0 ? "BUY" : "SELL",
-               transactionHistory[i].quantity,
-               transactionHistory[i].pricePerShare,
-               transactionHistory[i].date);
+    unsigned int rng = 12345U;
+    for (int i = 0; i < n; i++) {
+        rng = rng * 1103515245U + 12345U;
+        qty[i] = 1 + (rng >> 8) % 1000;
+        avg[i] = 1.0 + (rng >> 4) % 100000 / 100.0;
+        price[i] = avg[i] * (0.9 + (rng >> 16) % 200 / 1000.0);
     }
-}
 
-// ================= BUY/SELL FUNCTIONS =================
+    selectValuationKernels();
+    printf("%d positions, kernel: %s\n", n, valuationKernelName);
+    printf("%-20s %12s %12s %8s %s\n", "kernel", "scalar_us", "selected_us", "speedup", "check");
+
+    double best[2][2] = { { 1e30, 1e30 }, { 1e30, 1e30 } };
+    BookTotals books[2];
+    PriceStats stats[2];
+    for (int run = 0; run < 20; run++) {
+        for (int which = 0; which < 2; which++) {
+            double start = monotonicSeconds();
+            if (which == 0) valueBookScalar(qty, avg, price, n, pnl, &books[0]);
+            else valueBookKernel(qty, avg, price, n, pnl, &books[1]);
+            double mid = monotonicSeconds();
+            if (which == 0) priceStatsScalar(price, n, &stats[0]);
+            else priceStatsKernel(price, n, &stats[1]);
+            double end = monotonicSeconds();
+            if (mid - start < best[0][which]) best[0][which] = mid - start;
+            if (end - mid < best[1][which]) best[1][which] = end - mid;
+        }
+    }
+    // Summation order differs between kernels, so compare to a tolerance
+    double tolerance = 1e-9 * (books[0].value > 0 ? books[0].value : 1);
+    int bookMatch = fabs(books[0].cost - books[1].cost) <= tolerance &&
+                    fabs(books[0].value - books[1].value) <= tolerance;
+    int statsMatch = stats[0].min == stats[1].min && stats[0].max == stats[1].max &&
+                     fabs(stats[0].sum - stats[1].sum) <= 1e-9 * stats[0].sum;
+    const char *names[] = { "full revaluation", "price statistics" };
+    int matches[] = { bookMatch, statsMatch };
+    for (int k = 0; k < 2; k++) {
+        printf("%-20s %12.1f %12.1f %7.1fx %s\n", names[k], best[k][0] * 1e6, best[k][1] * 1e6,
+               best[k][1] > 0 ? best[k][0] / best[k][1] : 0.0, matches[k] ? "match" : "MISMATCH");
+    }
+    free(qty);
+    free(avg);
+    free(price);
+    free(pnl);
+}
 
-int buyStockInteractive() {
-    char symbolRaw[MAX_SYMBOL_LEN];
-    int qty;
-    double buyPrice;
-    char dateStr[MAX_DATE_LEN];
+// Revalues a book of synthetic in-memory accounts on the loaded market with
+// 1, 2, 4, ... pool threads. Nothing is written to disk.
+void benchmarkBookRevaluation(int accountsWanted) {
+    if (accountsWanted <= 0) accountsWanted = 10000;
+    if (marketCount == 0) {
+        printf("No market data loaded; nothing to value.\n");
+        return;
+    }
 
-    printf("Enter stock symbol to BUY (no spaces): ");
-    if (scanf("%15s", symbolRaw) != 1) {
-        printf("Invalid input.\n");
-        clearInputBuffer();
-        return 0;
+    unsigned int rng = 12345U;
+    int positions = 0;
+    for (int a = 0; a < accountsWanted; a++) {
+        char name[MAX_ACCOUNT_NAME];
+        snprintf(name, sizeof(name), "bench%d", a);
+        Account *acct = newAccount(name);
+        if (!acct) return;
+        int holdingsWanted = marketCount < TABLE_SIZE / 2 ? marketCount : TABLE_SIZE / 2;
+        for (int k = 0; k < holdingsWanted; k++) {
+            rng = rng * 1103515245U + 12345U;
+            int row = (rng >> 8) % marketCount;
+            int found = 0;
+            int slot = findHoldingSlotByKey(acct, marketKeys[row], &found);
+            if (slot < 0 || found) continue;
+            HoldingEntry *h = &acct->holdings[slot];
+            occupyHoldingSlot(acct, slot, marketKeys[row], marketSymbols[row]);
+            h->sectorId = marketSectorIds[row];
+            h->quantity = 1 + (rng >> 4) % 500;
+            h->avgBuyPrice = marketPrices[row] * (0.8 + (rng >> 16) % 400 / 1000.0);
+            positions++;
+        }
+        rebuildHoldingSectorMembers(acct);
+        rebuildAccountAggregates(acct);
     }
 
-    double currentPrice;
-    char sector[MAX_SECTOR_LEN];
-    if (!searchMarketStockExact(symbolRaw, &currentPrice, sector)) {
-        printf("Stock not found in MARKET data.\n");
-        clearInputBuffer();
-        return 0;
+    int size = startThreadPool();
+    selectValuationKernels();
+    printf("%d accounts, %d positions, %d pool threads, kernel: %s\n",
+           accountCount, positions, size, valuationKernelName);
+    printf("%8s %12s %14s %8s %s\n", "threads", "ms", "positions/s", "speedup", "check");
+
+    BookTotals reference, book;
+    double single = 0;
+    revalueAccounts(&reference, 1);
+    for (int workers = 1; ; workers *= 2) {
+        if (workers > size) workers = size;
+        double best = 1e30;
+        for (int run = 0; run < 10; run++) {
+            double start = monotonicSeconds();
+            revalueAccounts(&book, workers);
+            double elapsed = monotonicSeconds() - start;
+            if (elapsed < best) best = elapsed;
+        }
+        if (workers == 1) single = best;
+        // Per-account sums are reduced in account order, so results are exact
+        int match = book.cost == reference.cost && book.value == reference.value;
+        printf("%8d %12.3f %14.0f %7.2fx %s\n", workers, best * 1e3,
+               best > 0 ? positions / best : 0.0, best > 0 ? single / best : 0.0,
+               match ? "match" : "MISMATCH");
+        if (workers == size) break;
     }
+}
 
-    printf("Market price for %s (sector %s) is: %.2f\n",
-           symbolRaw, sector, currentPrice);
+// Concurrent read stress: one writer lists n symbols while re-pricing and
+// re-sectoring listed rows, and reader threads look symbols up and copy rows
+// at the same time. Each price encodes its row and an update version whose
+// parity matches the sector, so a torn read is detectable.
+typedef struct {
+    _Atomic int done;
+    _Atomic int listed;            // symbols the writer has finished inserting
+    int sectorEven, sectorOdd;
+} ConcurrentBench;
 
-    printf("Enter quantity to buy: ");
-    if (scanf("%d", &qty) != 1 || qty <= 0) {
-        printf("Invalid quantity.\n");
-        clearInputBuffer();
-        return 0;
+typedef struct {
+    ConcurrentBench *bench;
+    unsigned int seed;
+    long lookups, torn, missing;
+} ConcurrentReader;
+
+static void *concurrentReaderMain(void *arg) {
+    ConcurrentReader *r = arg;
+    ConcurrentBench *b = r->bench;
+    while (!atomic_load(&b->done)) {
+        int listed = atomic_load(&b->listed);
+        if (listed == 0) continue;
+        r->seed = r->seed * 1103515245U + 12345U;
+        int k = (r->seed >> 8) % listed;
+        char symbol[MAX_SYMBOL_LEN];
+        snprintf(symbol, sizeof(symbol), "CR%07d", k);
+
+        int phase = marketReadBegin();
+        MarketQuote quote;
+        int row = lookupMarketRow(symbol);
+        if (row < 0 || !readMarketQuote(row, &quote)) {
+            r->missing++;
+        } else {
+            long code = (long)quote.price;
+            int version = (int)(code % 1000);
+            int expectSector = (version & 1) ? b->sectorOdd : b->sectorEven;
+            if (strcmp(quote.symbol, symbol) != 0 || code / 1000 != k || quote.sectorId != expectSector)
+                r->torn++;
+        }
+        r->lookups++;
+        marketReadEnd(phase);
     }
+    return NULL;
+}
 
-    printf("Enter buy price (per share) (you can use current %.2f): ", currentPrice);
-    if (scanf("%lf", &buyPrice) != 1 || buyPrice <= 0) {
-        printf("Invalid price.\n");
-        clearInputBuffer();
-        return 0;
+void benchmarkConcurrentReads(int n) {
+    if (n <= 0) n = 200000;
+    int readers = poolThreads > 0 ? poolThreads : 3;
+    initMarketTable();
+    marketIndexesDeferred = 0;
+
+    ConcurrentBench bench;
+    atomic_init(&bench.done, 0);
+    atomic_init(&bench.listed, 0);
+    bench.sectorEven = internSector("EVEN");
+    bench.sectorOdd = internSector("ODD");
+
+    ConcurrentReader *r = calloc(readers, sizeof(ConcurrentReader));
+    pthread_t *tids = malloc(sizeof(pthread_t) * readers);
+    if (!r || !tids) {
+        perror("Error allocating benchmark readers");
+        free(r);
+        free(tids);
+        return;
     }
-    clearInputBuffer();
-
-    printf("Enter purchase date/time (no spaces, e.g. 2025-11-27_14:05) or 'now' for current: ");
-    if (scanf("%31s", dateStr) != 1) {
-        printf("Invalid date/time.\n");
-        clearInputBuffer();
-        return 0;
+    int started = 0;
+    for (int i = 0; i < readers; i++) {
+        r[i].bench = &bench;
+        r[i].seed = 777U + i;
+        if (pthread_create(&tids[i], NULL, concurrentReaderMain, &r[i]) != 0) break;
+        started++;
     }
-    clearInputBuffer();
 
-    if (strcmp(dateStr, "now") == 0) {
-        getCurrentDateTime(dateStr);
+    // Writer: insert with version 0, then re-price and re-sector 4 random rows
+    unsigned int rng = 4242U;
+    long updates = 0;
+    double start = monotonicSeconds();
+    for (int k = 0; k < n; k++) {
+        char symbol[MAX_SYMBOL_LEN];
+        snprintf(symbol, sizeof(symbol), "CR%07d", k);
+        if (upsertMarketStock(symbol, "EVEN", k * 1000.0, NULL) == -1) break;
+        atomic_store(&bench.listed, k + 1);
+        for (int u = 0; u < 4; u++) {
+            rng = rng * 1103515245U + 12345U;
+            int j = (rng >> 8) % (k + 1);
+            int version = 1 + (rng >> 4) % 998;
+            snprintf(symbol, sizeof(symbol), "CR%07d", j);
+            upsertMarketStock(symbol, (version & 1) ? "ODD" : "EVEN", j * 1000.0 + version, NULL);
+            updates++;
+        }
     }
-
-    char symbol[MAX_SYMBOL_LEN];
-    strncpy(symbol, symbolRaw, MAX_SYMBOL_LEN - 1);
-    symbol[MAX_SYMBOL_LEN - 1] = '\0';
-    toUpperStr(symbol);
-
-    int found = 0;
-    int slot = findHoldingSlot(symbol, &found);
-    if (slot == -1) {
-        printf("Error: Holdings table is full.\n");
-        return 0;
+    double elapsed = monotonicSeconds() - start;
+    atomic_store(&bench.done, 1);
+
+    long lookups = 0, torn = 0, missing = 0;
+    for (int i = 0; i < started; i++) {
+        pthread_join(tids[i], NULL);
+        lookups += r[i].lookups;
+        torn += r[i].torn;
+        missing += r[i].missing;
     }
+    printf("%d symbols, %d reader threads, %.3f s\n", n, started, elapsed);
+    printf("writer: %.0f inserts/sec, %.0f updates/sec\n", n / elapsed, updates / elapsed);
+    printf("readers: %.0f lookups/sec, %ld torn, %ld missing -> %s\n",
+           lookups / elapsed, torn, missing, torn == 0 && missing == 0 ? "consistent" : "INCONSISTENT");
+    free(r);
+    free(tids);
+}
 
-    // Add transaction BEFORE modifying holdings
-    addTransaction(symbol, qty, buyPrice, dateStr, 0);  // 0 = buy
-
-    if (found) {
-        // Update quantity & average price
-        int oldQty = holdingTable[slot].quantity;
-        double oldAvg = holdingTable[slot].avgBuyPrice;
-        int newQty = oldQty + qty;
-        double newAvg = ((oldAvg * oldQty) + (buyPrice * qty)) / newQty;
-
-        holdingTable[slot].quantity = newQty;
-        holdingTable[slot].avgBuyPrice = newAvg;
-        strncpy(holdingTable[slot].lastBuyDate, dateStr, MAX_DATE_LEN - 1);
-        holdingTable[slot].lastBuyDate[MAX_DATE_LEN - 1] = '\0';
+// ---------- Synthetic Data ----------
+// --gen-data writes a consistent data set of a chosen size for the benchmark
+// suite: rows market listings, rows transactions for the default account
+// and the holdings those transactions leave behind. Symbols are 1-5 letter
+// tickers in scrambled order, prices are log-uniform between 1 and ~1100,
+// and each symbol's trades never sell more than is held. The holdings table
+// has TABLE_SIZE slots, so trades use at most GEN_HELD_SYMBOLS symbols.
+#define GEN_HELD_SYMBOLS (TABLE_SIZE * 7 / 10)
+#define GEN_HISTORY_MINUTES (10LL * 365 * 24 * 60)   // transactions span ten years
+#define GEN_HISTORY_START 1420070400LL                // 2015-01-01 00:00 UTC
+
+static const char *genSectors[] = { "TECH", "BANKING", "ENERGY", "HEALTH", "AUTO", "MEDIA",
+                                    "RETAIL", "TELECOM", "UTILITIES", "MATERIALS", "INDUSTRIAL" };
+#define GEN_SECTORS (int)(sizeof(genSectors) / sizeof(genSectors[0]))
+
+static unsigned long long genNext(unsigned long long *state) {
+    unsigned long long x = *state;   // xorshift64
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    return *state = x;
+}
 
-        printf("Bought more of %s. New quantity: %d, New avg price: %.2f\n",
-               symbol, newQty, newAvg);
-    } else {
-        strcpy(holdingTable[slot].symbol, symbol);
-        strcpy(holdingTable[slot].sector, sector);
-        holdingTable[slot].quantity = qty;
-        holdingTable[slot].avgBuyPrice = buyPrice;
-        strncpy(holdingTable[slot].lastBuyDate, dateStr, MAX_DATE_LEN - 1);
-        holdingTable[slot].lastBuyDate[MAX_DATE_LEN - 1] = '\0';
-        holdingTable[slot].status = OCCUPIED;
+static double genUniform(unsigned long long *state) {
+    return (genNext(state) >> 11) * (1.0 / 9007199254740992.0);   // [0, 1)
+}
 
-        printf("Bought %d of %s at %.2f. Holding created.\n", qty, symbol, buyPrice);
+// The i-th ticker in the order A..Z, AA..ZZ, AAA..
+static void genTicker(long long i, char *out) {
+    int len = 1;
+    long long span = 26;
+    while (i >= span) {
+        i -= span;
+        span *= 26;
+        len++;
+    }
+    out[len] = '\0';
+    for (int k = len - 1; k >= 0; k--) {
+        out[k] = (char)('A' + i % 26);
+        i /= 26;
     }
-    saveHoldingsToFile(USER_FILE);
-    saveTransactionsToFile(TRANSACTION_FILE);
-
-
-    return 1;
 }
 
-int sellStockInteractive() {
-    char symbolRaw[MAX_SYMBOL_LEN];
-    int qty;
-
-    printf("Enter stock symbol to SELL: ");
-    if (scanf("%15s", symbolRaw) != 1) {
-        printf("Invalid input.\n");
-        clearInputBuffer();
+// Writes MARKET_FILE, USER_FILE and TRANSACTION_FILE into dir (created if
+// needed). Refuses to overwrite an existing market file.
+int generateDataSet(long rows, const char *dir) {
+    char path[MAX_PATH_LEN + 32];
+    if (rows <= 0) rows = 1000;
+    if (mkdir(dir, 0755) != 0 && errno != EEXIST) {
+        perror("Error creating data directory");
         return 0;
     }
-    clearInputBuffer();
-
-    char symbol[MAX_SYMBOL_LEN];
-    strncpy(symbol, symbolRaw, MAX_SYMBOL_LEN - 1);
-    symbol[MAX_SYMBOL_LEN - 1] = '\0';
-    toUpperStr(symbol);
-
-    int found = 0;
-    int slot = findHoldingSlot(symbol, &found);
-    if (!found || holdingTable[slot].status != OCCUPIED) {
-        printf("You do not hold any %s.\n", symbol);
+    snprintf(path, sizeof(path), "%s/%s", dir, MARKET_FILE);
+    if (access(path, F_OK) == 0) {
+        fprintf(stderr, "%s already exists, not overwriting it.\n", path);
         return 0;
     }
 
-    printf("You currently hold %d shares of %s at avg price %.2f\n",
-           holdingTable[slot].quantity,
-           holdingTable[slot].symbol,
-           holdingTable[slot].avgBuyPrice);
-
-    printf("Enter quantity to sell: ");
-    if (scanf("%d", &qty) != 1 || qty <= 0) {
-        printf("Invalid quantity.\n");
-        clearInputBuffer();
+    FILE *market = fopen(path, "w");
+    snprintf(path, sizeof(path), "%s/%s", dir, TRANSACTION_FILE);
+    FILE *history = fopen(path, "w");
+    snprintf(path, sizeof(path), "%s/%s", dir, USER_FILE);
+    FILE *holdings = fopen(path, "w");
+    if (!market || !history || !holdings) {
+        perror("Error creating data files");
+        if (market) fclose(market);
+        if (history) fclose(history);
+        if (holdings) fclose(holdings);
         return 0;
     }
-    clearInputBuffer();
 
-    if (qty > holdingTable[slot].quantity) {
-        printf("You cannot sell more than you hold.\n");
-        return 0;
+    int held = rows < GEN_HELD_SYMBOLS ? (int)rows : GEN_HELD_SYMBOLS;
+    char heldSymbols[GEN_HELD_SYMBOLS][MAX_SYMBOL_LEN];
+    int heldSectors[GEN_HELD_SYMBOLS], heldQty[GEN_HELD_SYMBOLS] = { 0 };
+    double heldPrices[GEN_HELD_SYMBOLS], heldAvg[GEN_HELD_SYMBOLS] = { 0 };
+    Timestamp heldTimes[GEN_HELD_SYMBOLS];
+    unsigned long long rng = 0x9e3779b97f4a7c15ULL;
+
+    // Both steps are prime, so i * step mod rows visits every ticker once
+    long long step = rows % 2654435761LL ? 2654435761LL : 2246822519LL;
+    for (long r = 0; r < rows; r++) {
+        char ticker[MAX_SYMBOL_LEN];
+        genTicker(r * step % rows, ticker);
+        int sector = (int)(genNext(&rng) % GEN_SECTORS);
+        double price = round(exp(genUniform(&rng) * 7.0) * 100.0) / 100.0;
+        fprintf(market, "%s %s %.10f\n", ticker, genSectors[sector], price);
+        if (r < held) {
+            strcpy(heldSymbols[r], ticker);
+            heldSectors[r] = sector;
+            heldPrices[r] = price;
+        }
     }
 
-    double currentPrice;
-    char sectorDummy[MAX_SECTOR_LEN];
-    if (!searchMarketStockExact(symbol, &currentPrice, sectorDummy)) {
-        printf("Current market price not found for %s.\n", symbol);
-        return 0;
+    for (long t = 0; t < rows; t++) {
+        int k = (int)(genNext(&rng) % held);
+        double price = round(heldPrices[k] * (0.8 + 0.4 * genUniform(&rng)) * 100.0) / 100.0;
+        Timestamp when = GEN_HISTORY_START * NS_PER_SECOND + t * GEN_HISTORY_MINUTES / rows * NS_PER_MINUTE;
+        char date[MAX_DATE_LEN];
+        formatTimestamp(when, date);
+
+        unsigned long long roll = genNext(&rng);
+        if (heldQty[k] > 0 && roll % 10 < 3) {
+            int qty = 1 + (int)(roll / 10 % heldQty[k]);
+            heldQty[k] -= qty;
+            fprintf(history, "%s %d %.10f %s 1\n", heldSymbols[k], qty, price, date);
+        } else {
+            // Average cost the same way executeBuy does
+            int qty = 1 + (int)(roll / 10 % 100);
+            heldAvg[k] = (heldAvg[k] * heldQty[k] + price * qty) / (heldQty[k] + qty);
+            heldQty[k] += qty;
+            heldTimes[k] = when;
+            fprintf(history, "%s %d %.10f %s 0\n", heldSymbols[k], qty, price, date);
+        }
+    }
+    for (int k = 0; k < held; k++) {
+        if (heldQty[k] == 0) continue;
+        char date[MAX_DATE_LEN];
+        formatTimestamp(heldTimes[k], date);
+        fprintf(holdings, "%s %s %d %.10f %s\n", heldSymbols[k], genSectors[heldSectors[k]],
+                heldQty[k], heldAvg[k], date);
     }
 
-    // Add sell transaction
-    char dateStr[MAX_DATE_LEN];
-    getCurrentDateTime(dateStr);
-    addTransaction(symbol, qty, currentPrice, dateStr, 1);  // 1 = sell
+    int ok = 1;
+    if (fclose(market) != 0) ok = 0;
+    if (fclose(history) != 0) ok = 0;
+    if (fclose(holdings) != 0) ok = 0;
+    if (!ok) perror("Error writing data files");
+    return ok;
+}
 
-    double avg = holdingTable[slot].avgBuyPrice;
-    double profitPerShare = currentPrice - avg;
-    double totalProfit = profitPerShare * qty;
+// ---------- Benchmark Suite ----------
+// --bench-suite N generates an N row data set in a scratch directory and
+// times the core table operations on it. Output is CSV on stdout, one line
+// per operation, so runs can be compared with diff or a spreadsheet:
+//   op,rows,ops,ns_per_op,ops_per_sec,mem_bytes,max_rss_kb
+// rows is the data set size, ops what one timed run did (best of
+// BENCH_SUITE_RUNS), mem_bytes the size of the structure the operation
+// works on and max_rss_kb the process peak so far. Loads and saves count
+// one op per record; sorts one op per element sorted, and top-K selection
+// one per row scanned; history queries one op per query (a month of one
+// symbol, first page read back).
+#define BENCH_SUITE_RUNS 3
+#define BENCH_SUITE_MIN_OPS (1L << 20)   // lookups per timed run, at least
+#define BENCH_SUITE_MISSES 65536         // distinct unlisted symbols probed
+#define BENCH_SUITE_SORT_ROWS 1000000    // market rows sorted by the comparators
+#define BENCH_SUITE_HOLDING_REPS 200     // holdings are small: repeat loads
+#define BENCH_SUITE_HOLDING_SAVES 20     // ... and fsynced saves
+#define BENCH_SUITE_HISTORY_QUERIES 65536   // symbol and date range queries
+#define BENCH_SUITE_TOP_K 20             // K of the top-K market selection
 
-    printf("Current market price: %.2f\n", currentPrice);
-    if (totalProfit > 0)
-        printf("If you sell %d now: PROFIT = %.2f\n", qty, totalProfit);
-    else if (totalProfit < 0)
-        printf("If you sell %d now: LOSS = %.2f\n", qty, -totalProfit);
-    else
-        printf("If you sell %d now: NO PROFIT / NO LOSS (break-even)\n", qty);
+typedef struct {
+    Account *acct;
+    const char **hits;                 // listed symbols, shuffled
+    int hitCount;
+    char (*misses)[MAX_SYMBOL_LEN];    // unlisted symbols
+    int missCount;
+    const char *held[TABLE_SIZE];      // symbols in the holdings table
+    const char *notHeld[TABLE_SIZE];   // listed, not held
+    int heldCount, notHeldCount;
+    MarketView *views, *viewWork;
+    int viewCount;
+    HoldingView holdViews[TABLE_SIZE], holdWork[TABLE_SIZE];
+    int holdViewCount;
+    unsigned long long sink;           // keeps lookup results live
+} BenchSuite;
+
+typedef long (*BenchSuiteOp)(BenchSuite *s);
+typedef size_t (*BenchSuiteMem)(const BenchSuite *s);
+
+static size_t suiteMarketBytes(const BenchSuite *s) {
+    (void)s;
+    size_t perRow = MAX_SYMBOL_LEN + sizeof(double) + sizeof(int) + 1 + sizeof(unsigned int) +
+                    sizeof(int) + sizeof(SymbolKey) + sizeof(MarketHolders);
+    size_t priceIndex = (sizeof(double) + 3 * sizeof(int)) * (size_t)marketPriceIndex.capacity;
+    return perRow * marketRowCapacity + sizeof(MarketSlot) * marketIndexCapacity +
+           sizeof(int) * marketSymbolOrderCapacity + priceIndex;
+}
 
-    // Update holdings
-    holdingTable[slot].quantity -= qty;
-    if (holdingTable[slot].quantity == 0) {
-        holdingTable[slot].status = DELETED;
-        printf("You sold all holdings of %s.\n", symbol);
-    } else {
-        printf("Remaining quantity of %s: %d\n",
-               symbol, holdingTable[slot].quantity);
+static size_t suiteMarketIndexBytes(const BenchSuite *s) {
+    (void)s;
+    return sizeof(MarketSlot) * marketIndexCapacity;
+}
+
+static size_t suiteAccountBytes(const BenchSuite *s) {
+    (void)s;
+    return sizeof(Account);
+}
+
+static size_t suiteHoldingKeyBytes(const BenchSuite *s) {
+    return sizeof(s->acct->holdingKeys);
+}
+
+static size_t suiteHistoryBytes(const BenchSuite *s) {
+    return sizeof(TransactionEntry) * TRANSACTION_CHUNK_SIZE * (size_t)s->acct->transactionChunkCount;
+}
+
+static size_t suiteHistoryIndexBytes(const BenchSuite *s) {
+    const HistoryIndex *hi = &s->acct->historyIndex;
+    size_t bytes = sizeof(long long) * (size_t)hi->capacity +
+                   sizeof(int) * (size_t)(hi->byTime.capacity + hi->bySide[0].capacity + hi->bySide[1].capacity) +
+                   sizeof(HistorySymbol) * (size_t)hi->symbolCapacity;
+    for (int i = 0; i < hi->symbolCapacity; i++) {
+        const HistorySymbol *entry = &hi->symbols[i];
+        bytes += sizeof(int) * (size_t)(entry->list.capacity + entry->sides[0].capacity + entry->sides[1].capacity);
     }
-    saveHoldingsToFile(USER_FILE);
-    saveTransactionsToFile(TRANSACTION_FILE);
+    return bytes;
+}
 
+static size_t suiteViewBytes(const BenchSuite *s) {
+    return sizeof(MarketView) * (size_t)s->viewCount;
+}
 
-    return 1;
+static size_t suiteHoldViewBytes(const BenchSuite *s) {
+    return sizeof(HoldingView) * (size_t)s->holdViewCount;
 }
 
-typedef struct {
-    char symbol[MAX_SYMBOL_LEN];
-    char sector[MAX_SECTOR_LEN];
-    int quantity;
-    double avgBuyPrice;
-    char lastBuyDate[MAX_DATE_LEN];
-    double currentPrice;
-    double profitPerShare;
-    double totalProfit;
-} HoldingView;
+static long suiteLoadMarketText(BenchSuite *s) {
+    (void)s;
+    useSnapshots = 0;
+    return loadMarketFromFile(MARKET_FILE) ? marketCount : 0;
+}
 
-int cmpHoldByPrice(const void *a, const void *b) {
-    const HoldingView *x = (const HoldingView *)a;
-    const HoldingView *y = (const HoldingView *)b;
-    if (x->currentPrice < y->currentPrice) return -1;
-    if (x->currentPrice > y->currentPrice) return  1;
-    return strcmp(x->symbol, y->symbol);
+static long suiteSaveMarketText(BenchSuite *s) {
+    (void)s;
+    useSnapshots = 0;
+    return saveMarketToFile(MARKET_FILE) ? marketCount : 0;
 }
 
-int cmpHoldBySector(const void *a, const void *b) {
-    const HoldingView *x = (const HoldingView *)a;
-    const HoldingView *y = (const HoldingView *)b;
-    int cmp = strcasecmp(x->sector, y->sector);
-    if (cmp != 0) return cmp;
-    return strcmp(x->symbol, y->symbol);
+static long suiteSaveMarketSnapshot(BenchSuite *s) {
+    (void)s;
+    return saveMarketSnapshot(MARKET_FILE) ? marketCount : 0;
 }
 
-int cmpHoldByProfit(const void *a, const void *b) {
-    const HoldingView *x = (const HoldingView *)a;
-    const HoldingView *y = (const HoldingView *)b;
-    if (x->totalProfit < y->totalProfit) return -1;
-    if (x->totalProfit > y->totalProfit) return  1;
-    return strcmp(x->symbol, y->symbol);
+static long suiteLoadMarketSnapshot(BenchSuite *s) {
+    (void)s;
+    useSnapshots = 1;
+    return loadMarketFromFile(MARKET_FILE) ? marketCount : 0;
 }
 
-void displayUserPortfolioInteractive() {
-    int count = 0;
-    HoldingView temp[TABLE_SIZE];
-    double totalInvestment = 0, totalCurrentValue = 0, totalProfit = 0;
+static long suiteHash(BenchSuite *s) {
+    for (int i = 0; i < s->hitCount; i++) s->sink += hash(s->hits[i]);
+    return s->hitCount;
+}
 
-    // Gather holdings with current prices and profit calculations
-    for (int i = 0; i < TABLE_SIZE; i++) {
-        if (holdingTable[i].status == OCCUPIED) {
-            strcpy(temp[count].symbol, holdingTable[i].symbol);
-            strcpy(temp[count].sector, holdingTable[i].sector);
-            temp[count].quantity = holdingTable[i].quantity;
-            temp[count].avgBuyPrice = holdingTable[i].avgBuyPrice;
-            strcpy(temp[count].lastBuyDate, holdingTable[i].lastBuyDate);
-
-            // Get current market price
-            double currentPrice;
-            char sectorDummy[MAX_SECTOR_LEN];
-            if (searchMarketStockExact(holdingTable[i].symbol, &currentPrice, sectorDummy)) {
-                temp[count].currentPrice = currentPrice;
-                temp[count].profitPerShare = currentPrice - holdingTable[i].avgBuyPrice;
-                temp[count].totalProfit = temp[count].profitPerShare * holdingTable[i].quantity;
-            } else {
-                temp[count].currentPrice = 0;
-                temp[count].profitPerShare = 0;
-                temp[count].totalProfit = 0;
-            }
+static long suiteSymbolKey(BenchSuite *s) {
+    for (int i = 0; i < s->hitCount; i++) s->sink += symbolKey(s->hits[i]);
+    return s->hitCount;
+}
 
-            totalInvestment += holdingTable[i].avgBuyPrice * holdingTable[i].quantity;
-            totalCurrentValue += temp[count].currentPrice * holdingTable[i].quantity;
-            totalProfit += temp[count].totalProfit;
+static long suiteFindMarketHit(BenchSuite *s) {
+    long ops = s->hitCount > BENCH_SUITE_MIN_OPS ? s->hitCount : BENCH_SUITE_MIN_OPS;
+    for (long i = 0, j = 0; i < ops; i++) {
+        s->sink += findMarketSlot(s->hits[j], NULL);
+        if (++j == s->hitCount) j = 0;
+    }
+    return ops;
+}
 
-            count++;
-        }
+static long suiteFindMarketMiss(BenchSuite *s) {
+    long ops = BENCH_SUITE_MIN_OPS;
+    for (long i = 0, j = 0; i < ops; i++) {
+        s->sink += findMarketSlot(s->misses[j], NULL);
+        if (++j == s->missCount) j = 0;
     }
+    return ops;
+}
 
-    if (count == 0) {
-        printf("No holdings in your portfolio.\n");
-        return;
+static long suiteSearchExact(BenchSuite *s) {
+    long ops = s->hitCount > BENCH_SUITE_MIN_OPS ? s->hitCount : BENCH_SUITE_MIN_OPS;
+    double price;
+    for (long i = 0, j = 0; i < ops; i++) {
+        s->sink += searchMarketStockExact(s->hits[j], &price, NULL);
+        if (++j == s->hitCount) j = 0;
     }
+    return ops;
+}
 
-    int sortChoice;
-    printf("\nSort portfolio by:\n");
-    printf("1. No sorting\n");
-    printf("2. By current price\n");
-    printf("3. By sector\n");
-    printf("4. By total profit\n");
-    printf("Enter choice: ");
-    if (scanf("%d", &sortChoice) != 1) {
-        printf("Invalid input.\n");
-        clearInputBuffer();
-        return;
+static long suiteFindHolding(BenchSuite *s, const char **symbols, int count) {
+    long ops = BENCH_SUITE_MIN_OPS;
+    int found;
+    if (count == 0) return 0;
+    for (long i = 0, j = 0; i < ops; i++) {
+        s->sink += findHoldingSlot(s->acct, symbols[j], &found) + found;
+        if (++j == count) j = 0;
     }
-    clearInputBuffer();
+    return ops;
+}
 
-    switch (sortChoice) {
-        case 2: qsort(temp, count, sizeof(HoldingView), cmpHoldByPrice); break;
-        case 3: qsort(temp, count, sizeof(HoldingView), cmpHoldBySector); break;
-        case 4: qsort(temp, count, sizeof(HoldingView), cmpHoldByProfit); break;
+static long suiteFindHoldingHit(BenchSuite *s) {
+    return suiteFindHolding(s, s->held, s->heldCount);
+}
+
+static long suiteFindHoldingMiss(BenchSuite *s) {
+    return suiteFindHolding(s, s->notHeld, s->notHeldCount);
+}
+
+static long suiteQueryHistory(BenchSuite *s) {
+    unsigned long long rng = 0x94d049bb133111ebULL;
+    int records[HISTORY_PAGE_SIZE];
+    TransactionEntry rows[HISTORY_PAGE_SIZE];
+    HistoryQuery q;
+    q.type = -1;
+    if (s->heldCount == 0) return 0;
+    for (long i = 0; i < BENCH_SUITE_HISTORY_QUERIES; i++) {
+        strcpy(q.symbol, s->held[i % s->heldCount]);
+        q.from = GEN_HISTORY_START * NS_PER_SECOND + (long long)(genNext(&rng) % GEN_HISTORY_MINUTES) * NS_PER_MINUTE;
+        q.to = q.from + 30 * NS_PER_DAY;
+        int total = queryTransactionHistory(s->acct, &q, 0, HISTORY_PAGE_SIZE, records);
+        int n = total < HISTORY_PAGE_SIZE ? total : HISTORY_PAGE_SIZE;
+        if (n > 0 && readTransactionRecords(s->acct, records, n, rows)) s->sink += rows[0].quantity;
+        s->sink += total;
     }
+    return BENCH_SUITE_HISTORY_QUERIES;
+}
 
-    printf("\n----- Your Portfolio -----\n");
-    printf("%-12s | %-10s | Qty | AvgBuy | CurPrice | Profit/Sh | TotalProfit\n", 
-           "Symbol", "Sector");
-    printf("------------------------------------------------------------------------\n");
-    
-    for (int i = 0; i < count; i++) {
-        printf("%-12s | %-10s | %3d | %6.2f | %8.2f | %9.2f | %11.2f\n",
-               temp[i].symbol,
-               temp[i].sector,
-               temp[i].quantity,
-               temp[i].avgBuyPrice,
-               temp[i].currentPrice,
-               temp[i].profitPerShare,
-               temp[i].totalProfit);
+static long suiteLoadHoldings(BenchSuite *s, int snapshots) {
+    long ops = 0;
+    useSnapshots = snapshots;
+    for (int i = 0; i < BENCH_SUITE_HOLDING_REPS; i++) {
+        if (!loadHoldingsFromFile(s->acct)) return 0;
+        ops += s->acct->totals.holdings;
     }
-    
-    printf("------------------------------------------------------------------------\n");
-    printf("TOTALS: Investment: %.2f | Current Value: %.2f | Net Profit/Loss: %.2f\n",
-           totalInvestment, totalCurrentValue, totalProfit);
+    return ops;
 }
 
-int saveHoldingsToFile(const char *filename) {
-    FILE *fp = fopen(filename, "w");
-    if (!fp) {
-        perror("Error opening holdings file for saving");
-        return 0;
+static long suiteLoadHoldingsText(BenchSuite *s) {
+    return suiteLoadHoldings(s, 0);
+}
+
+static long suiteLoadHoldingsSnapshot(BenchSuite *s) {
+    return suiteLoadHoldings(s, 1);
+}
+
+static long suiteSaveHoldings(BenchSuite *s) {
+    long ops = 0;
+    useSnapshots = 0;
+    for (int i = 0; i < BENCH_SUITE_HOLDING_SAVES; i++) {
+        if (!saveHoldingsToFile(s->acct)) return 0;
+        ops += s->acct->totals.holdings;
     }
+    return ops;
+}
 
-    for (int i = 0; i < TABLE_SIZE; i++) {
-        if (holdingTable[i].status == OCCUPIED) {
-            fprintf(fp, "%s %s %d %.10f %s\n",
-                    holdingTable[i].symbol,
-                    holdingTable[i].sector,
-                    holdingTable[i].quantity,
-                    holdingTable[i].avgBuyPrice,
-                    holdingTable[i].lastBuyDate);
-        }
+static long suiteSaveHoldingsSnapshot(BenchSuite *s) {
+    long ops = 0;
+    for (int i = 0; i < BENCH_SUITE_HOLDING_REPS; i++) {
+        if (!saveHoldingsSnapshot(s->acct)) return 0;
+        ops += s->acct->totals.holdings;
     }
+    return ops;
+}
 
-    fclose(fp);
-    return 1;
+static long suiteLoadTransactions(BenchSuite *s, int snapshots) {
+    useSnapshots = snapshots;
+    loadTransactionsFromFile(s->acct);
+    return s->acct->transactionCount;
 }
 
-int loadHoldingsFromFile(const char *filename) {
-    FILE *fp = fopen(filename, "r");
-    if (!fp) {
-        return 0;
-    }
+static long suiteLoadTransactionsText(BenchSuite *s) {
+    return suiteLoadTransactions(s, 0);
+}
 
-    initHoldingTable();
+static long suiteLoadTransactionsSnapshot(BenchSuite *s) {
+    return suiteLoadTransactions(s, 1);
+}
 
-    char symbol[MAX_SYMBOL_LEN];
-    char sector[MAX_SECTOR_LEN];
-    int quantity;
-    double avgBuyPrice;
-    char lastBuyDate[MAX_DATE_LEN];
+static long suiteSaveTransactionsText(BenchSuite *s) {
+    return saveTransactionsToFile(s->acct, TRANSACTION_FILE ".bench") ? s->acct->transactionCount : 0;
+}
 
-    while (fscanf(fp, "%15s %19s %d %lf %31s", 
-                  symbol, sector, &quantity, &avgBuyPrice, lastBuyDate) == 5) {
-        
-        char symbolUpper[MAX_SYMBOL_LEN];
-        strcpy(symbolUpper, symbol);
-        toUpperStr(symbolUpper);
+static long suiteSaveTransactionsSnapshot(BenchSuite *s) {
+    s->acct->transactionSnapshotCount = -1;   // full rewrite, not an append
+    return saveTransactionSnapshot(s->acct) ? s->acct->transactionCount : 0;
+}
 
-        int found = 0;
-        int slot = findHoldingSlot(symbolUpper, &found);
-        if (slot != -1) {
-            strcpy(holdingTable[slot].symbol, symbolUpper);
-            strcpy(holdingTable[slot].sector, sector);
-            holdingTable[slot].quantity = quantity;
-            holdingTable[slot].avgBuyPrice = avgBuyPrice;
-            strcpy(holdingTable[slot].lastBuyDate, lastBuyDate);
-            holdingTable[slot].status = OCCUPIED;
+static long suiteSortMarket(BenchSuite *s, int (*cmp)(const void *, const void *)) {
+    memcpy(s->viewWork, s->views, sizeof(MarketView) * s->viewCount);
+    qsort(s->viewWork, s->viewCount, sizeof(MarketView), cmp);
+    return s->viewCount;
+}
+
+static long suiteSortMarketByPrice(BenchSuite *s) {
+    return suiteSortMarket(s, cmpMarketByPrice);
+}
+
+static long suiteSortMarketBySector(BenchSuite *s) {
+    return suiteSortMarket(s, cmpMarketBySector);
+}
+
+// What displayMarketTopK does for K = BENCH_SUITE_TOP_K, without printing
+static long suiteTopMarketByPrice(BenchSuite *s) {
+    TopKEntry best[BENCH_SUITE_TOP_K];
+    long ops = 0;
+    int rows = marketVisibleCount();
+    while (ops < BENCH_SUITE_MIN_OPS && rows > 0) {
+        TopK top = { best, 0, BENCH_SUITE_TOP_K, 0 };
+        int phase = marketReadBegin();
+        for (int i = 0; i < rows; i++) {
+            MarketQuote quote;
+            if (readMarketQuote(i, &quote) && quote.listed) topKOffer(&top, quote.price, i);
         }
+        marketReadEnd(phase);
+        s->sink += topKFinish(&top) + best[0].id;
+        ops += rows;
     }
+    return ops;
+}
 
-    fclose(fp);
-    return 1;
+static long suiteSortHoldings(BenchSuite *s, int (*cmp)(const void *, const void *)) {
+    long ops = 0;
+    for (long i = 0; ops < BENCH_SUITE_MIN_OPS && s->holdViewCount > 0; i++) {
+        memcpy(s->holdWork, s->holdViews, sizeof(HoldingView) * s->holdViewCount);
+        qsort(s->holdWork, s->holdViewCount, sizeof(HoldingView), cmp);
+        ops += s->holdViewCount;
+    }
+    return ops;
 }
 
-// ================= STATISTICS =================
+static long suiteSortHoldingsByPrice(BenchSuite *s) {
+    return suiteSortHoldings(s, cmpHoldByPrice);
+}
 
-void showMarketStatistics() {
-    int count = 0;
-    double totalValue = 0, minPrice = 1e9, maxPrice = 0;
-    char sectors[TABLE_SIZE][MAX_SECTOR_LEN];
-    int sectorCount = 0;
+static long suiteSortHoldingsBySector(BenchSuite *s) {
+    return suiteSortHoldings(s, cmpHoldBySector);
+}
 
-    for (int i = 0; i < TABLE_SIZE; i++) {
-        if (marketTable[i].status == OCCUPIED) {
-            count++;
-            totalValue += marketTable[i].price;
-            
-            if (marketTable[i].price < minPrice) minPrice = marketTable[i].price;
-            if (marketTable[i].price > maxPrice) maxPrice = marketTable[i].price;
+static long suiteSortHoldingsByProfit(BenchSuite *s) {
+    return suiteSortHoldings(s, cmpHoldByProfit);
+}
 
-            // Count unique sectors
-            int found = 0;
-            for (int j = 0; j < sectorCount; j++) {
-                if (equalsIgnoreCase(sectors[j], marketTable[i].sector)) {
-                    found = 1;
-                    break;
-                }
-            }
-            if (!found) {
-                strcpy(sectors[sectorCount], marketTable[i].sector);
-                sectorCount++;
-            }
-        }
-    }
+static void suiteReport(const char *op, long rows, long ops, double seconds, size_t memBytes) {
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    printf("%s,%ld,%ld,%.2f,%.0f,%zu,%ld\n", op, rows, ops,
+           ops > 0 ? seconds * 1e9 / ops : 0.0, seconds > 0 ? ops / seconds : 0.0,
+           memBytes, (long)ru.ru_maxrss);
+    fflush(stdout);
+}
 
-    printf("\n----- Market Statistics -----\n");
-    printf("Total Stocks: %d\n", count);
-    printf("Unique Sectors: %d\n", sectorCount);
-    if (count > 0) {
-        printf("Average Price: %.2f\n", totalValue / count);
-        printf("Price Range: %.2f - %.2f\n", minPrice, maxPrice);
-        printf("Sectors: ");
-        for (int i = 0; i < sectorCount; i++) {
-            printf("%s", sectors[i]);
-            if (i < sectorCount - 1) printf(", ");
-        }
-        printf("\n");
+static void suiteRun(const char *op, BenchSuiteOp fn, BenchSuiteMem mem, BenchSuite *s, long rows) {
+    double best = 1e30;
+    long ops = 0;
+    for (int run = 0; run < BENCH_SUITE_RUNS; run++) {
+        double start = monotonicSeconds();
+        ops = fn(s);
+        double elapsed = monotonicSeconds() - start;
+        if (elapsed < best) best = elapsed;
     }
+    suiteReport(op, rows, ops, best, mem ? mem(s) : 0);
 }
 
-void showPortfolioStatistics() {
-    int count = 0;
-    double totalInvestment = 0, totalCurrentValue = 0;
-    double bestProfit = -1e9, worstProfit = 1e9;
-    char bestStock[MAX_SYMBOL_LEN] = "", worstStock[MAX_SYMBOL_LEN] = "";
+// Query sets for the lookup and sort benchmarks, built once the market is
+// loaded for the last time
+static int prepareBenchSuite(BenchSuite *s, long rows) {
+    unsigned long long rng = 0x2545f4914f6cdd1dULL;
+    s->hitCount = marketCount;
+    s->missCount = BENCH_SUITE_MISSES;
+    s->viewCount = marketCount < BENCH_SUITE_SORT_ROWS ? marketCount : BENCH_SUITE_SORT_ROWS;
+    s->hits = malloc(sizeof(char *) * (s->hitCount ? s->hitCount : 1));
+    s->misses = malloc(sizeof(*s->misses) * s->missCount);
+    s->views = malloc(sizeof(MarketView) * (s->viewCount ? s->viewCount : 1));
+    s->viewWork = malloc(sizeof(MarketView) * (s->viewCount ? s->viewCount : 1));
+    if (!s->hits || !s->misses || !s->views || !s->viewWork) {
+        perror("Error allocating benchmark queries");
+        return 0;
+    }
 
-    for (int i = 0; i < TABLE_SIZE; i++) {
-        if (holdingTable[i].status == OCCUPIED) {
-            count++;
-            double investment = holdingTable[i].avgBuyPrice * holdingTable[i].quantity;
-            totalInvestment += investment;
-
-            double currentPrice;
-            char sectorDummy[MAX_SECTOR_LEN];
-            if (searchMarketStockExact(holdingTable[i].symbol, &currentPrice, sectorDummy)) {
-                double currentValue = currentPrice * holdingTable[i].quantity;
-                double profit = currentValue - investment;
-                totalCurrentValue += currentValue;
-
-                if (profit > bestProfit) {
-                    bestProfit = profit;
-                    strcpy(bestStock, holdingTable[i].symbol);
-                }
-                if (profit < worstProfit) {
-                    worstProfit = profit;
-                    strcpy(worstStock, holdingTable[i].symbol);
-                }
-            }
-        }
+    for (int i = 0; i < s->hitCount; i++) s->hits[i] = marketSymbols[i];
+    for (int i = s->hitCount - 1; i > 0; i--) {
+        int j = (int)(genNext(&rng) % (i + 1));
+        const char *tmp = s->hits[i];
+        s->hits[i] = s->hits[j];
+        s->hits[j] = tmp;
+    }
+    for (int i = 0; i < s->missCount; i++) genTicker(rows + i, s->misses[i]);
+    for (int i = 0; i < s->viewCount; i++) {
+        int row = (int)(genNext(&rng) % marketCount);
+        strcpy(s->views[i].symbol, marketSymbols[row]);
+        strcpy(s->views[i].sector, sectorName(marketSectorIds[row]));
+        s->views[i].price = marketPrices[row];
     }
 
-    printf("\n----- Portfolio Statistics -----\n");
-    printf("Total Holdings: %d\n", count);
-    printf("Total Investment: %.2f\n", totalInvestment);
-    printf("Current Portfolio Value: %.2f\n", totalCurrentValue);
-    printf("Net Profit/Loss: %.2f\n", totalCurrentValue - totalInvestment);
-    if (totalInvestment > 0) {
-        double roi = ((totalCurrentValue - totalInvestment) / totalInvestment) * 100;
-        printf("ROI: %.2f%%\n", roi);
+    const Account *acct = s->acct;
+    for (int slot = 0; slot < TABLE_SIZE; slot++) {
+        const HoldingEntry *h = &acct->holdings[slot];
+        if (h->status != OCCUPIED) continue;
+        HoldingView *v = &s->holdViews[s->holdViewCount++];
+        int row = acct->aggregates[slot].marketRow;
+        strcpy(v->symbol, h->symbol);
+        strcpy(v->sector, sectorName(h->sectorId));
+        v->quantity = h->quantity;
+        v->avgBuyPrice = h->avgBuyPrice;
+        v->lastBuyTime = h->lastBuyTime;
+        v->currentPrice = row >= 0 ? marketPrices[row] : h->avgBuyPrice;
+        v->profitPerShare = v->currentPrice - v->avgBuyPrice;
+        v->totalProfit = v->profitPerShare * v->quantity;
+        s->held[s->heldCount++] = h->symbol;
     }
-    if (count > 0) {
-        printf("Best Performing: %s (%.2f)\n", bestStock, bestProfit);
-        printf("Worst Performing: %s (%.2f)\n", worstStock, worstProfit);
+    for (int i = 0; i < s->hitCount && s->notHeldCount < TABLE_SIZE; i++) {
+        int found;
+        findHoldingSlot(s->acct, s->hits[i], &found);
+        if (!found) s->notHeld[s->notHeldCount++] = s->hits[i];
+    }
+    return 1;
+}
+
+static void removeBenchDirectory(const char *dir) {
+    DIR *d = opendir(dir);
+    if (!d) return;
+    struct dirent *entry;
+    while ((entry = readdir(d)) != NULL) {
+        char path[MAX_PATH_LEN + sizeof(entry->d_name)];
+        if (entry->d_name[0] == '.') continue;
+        snprintf(path, sizeof(path), "%s/%s", dir, entry->d_name);
+        unlink(path);
+    }
+    closedir(d);
+    rmdir(dir);
+}
+
+// Runs the whole suite on a fresh rows-row data set. The data lives in a
+// scratch directory that is removed afterwards; the working directory's
+// files are never read or written.
+int runBenchmarkSuite(long rows) {
+    if (rows <= 0) rows = 100000;
+    char dir[] = "/tmp/portfolio-bench-XXXXXX";
+    if (!mkdtemp(dir)) {
+        perror("Error creating benchmark directory");
+        return 0;
+    }
+    printf("# bench-suite rows=%ld cpus=%ld snapshot_version=%d\n",
+           rows, sysconf(_SC_NPROCESSORS_ONLN), SNAPSHOT_VERSION);
+    printf("op,rows,ops,ns_per_op,ops_per_sec,mem_bytes,max_rss_kb\n");
+
+    double start = monotonicSeconds();
+    BenchSuite *s = calloc(1, sizeof(BenchSuite));
+    int ok = s && generateDataSet(rows, dir) && chdir(dir) == 0;
+    if (ok) {
+        suiteReport("generate_data", rows, 2 * rows, monotonicSeconds() - start, 0);
+
+        initMarketTable();
+        suiteRun("load_market_text", suiteLoadMarketText, suiteMarketBytes, s, rows);
+        suiteRun("save_market_text", suiteSaveMarketText, suiteMarketBytes, s, rows);
+        suiteRun("save_market_snapshot", suiteSaveMarketSnapshot, suiteMarketBytes, s, rows);
+        suiteRun("load_market_snapshot", suiteLoadMarketSnapshot, suiteMarketBytes, s, rows);
+
+        s->acct = newAccount(DEFAULT_ACCOUNT);
+        ok = s->acct != NULL;
+    }
+    if (ok) {
+        suiteRun("load_holdings_text", suiteLoadHoldingsText, suiteAccountBytes, s, rows);
+        suiteRun("save_holdings", suiteSaveHoldings, suiteAccountBytes, s, rows);
+        suiteRun("save_holdings_snapshot", suiteSaveHoldingsSnapshot, suiteAccountBytes, s, rows);
+        suiteRun("load_holdings_snapshot", suiteLoadHoldingsSnapshot, suiteAccountBytes, s, rows);
+        suiteRun("load_transactions_text", suiteLoadTransactionsText, suiteHistoryBytes, s, rows);
+        suiteRun("save_transactions_text", suiteSaveTransactionsText, suiteHistoryBytes, s, rows);
+        suiteRun("save_transactions_snapshot", suiteSaveTransactionsSnapshot, suiteHistoryBytes, s, rows);
+        suiteRun("load_transactions_snapshot", suiteLoadTransactionsSnapshot, suiteHistoryBytes, s, rows);
+        ok = prepareBenchSuite(s, rows);
     }
+    if (ok) {
+        suiteRun("hash", suiteHash, NULL, s, rows);
+        suiteRun("symbol_key", suiteSymbolKey, NULL, s, rows);
+        suiteRun("find_market_hit", suiteFindMarketHit, suiteMarketIndexBytes, s, rows);
+        suiteRun("find_market_miss", suiteFindMarketMiss, suiteMarketIndexBytes, s, rows);
+        suiteRun("search_market_exact", suiteSearchExact, suiteMarketIndexBytes, s, rows);
+        suiteRun("find_holding_hit", suiteFindHoldingHit, suiteHoldingKeyBytes, s, rows);
+        suiteRun("find_holding_miss", suiteFindHoldingMiss, suiteHoldingKeyBytes, s, rows);
+        suiteRun("query_history", suiteQueryHistory, suiteHistoryIndexBytes, s, rows);
+        suiteRun("sort_market_by_price", suiteSortMarketByPrice, suiteViewBytes, s, rows);
+        suiteRun("sort_market_by_sector", suiteSortMarketBySector, suiteViewBytes, s, rows);
+        suiteRun("top_market_by_price", suiteTopMarketByPrice, NULL, s, rows);
+        suiteRun("sort_holdings_by_price", suiteSortHoldingsByPrice, suiteHoldViewBytes, s, rows);
+        suiteRun("sort_holdings_by_sector", suiteSortHoldingsBySector, suiteHoldViewBytes, s, rows);
+        suiteRun("sort_holdings_by_profit", suiteSortHoldingsByProfit, suiteHoldViewBytes, s, rows);
+        printf("# checksum %llu\n", s->sink);
+    }
+
+    closeAllAccounts();
+    removeBenchDirectory(dir);
+    if (s) {
+        free(s->hits);
+        free(s->misses);
+        free(s->views);
+        free(s->viewWork);
+        free(s);
+    }
+    return ok;
 }
 
 // ================= USER MENU =================
@@ -1127,6 +7705,14 @@ void userMenu() {
         printf("9. Display All Stocks\n");
         printf("10. Insert/Update Market Stock\n");  // NEW
         printf("11. Show Market Statistics\n");
+        printf("12. Compact Transaction Journal\n");
+        printf("13. Switch Account (current: %s)\n", activeAccount->name);
+        printf("14. Book Summary (all accounts)\n");
+        printf("15. Hash Table Health\n");
+        printf("16. Query Transaction History\n");
+        printf("17. Tax Lots and Realized P&L\n");
+        printf("18. Verify Holdings Against History\n");
+        printf("19. Leaderboard (all accounts)\n");
         printf("0. Exit\n");
         printf("Enter choice: ");
         
@@ -1171,11 +7757,37 @@ void userMenu() {
             case 11:
                 showMarketStatistics();
                 break;
+            case 12:
+                if (compactTransactionJournal(activeAccount))
+                    printf("Transaction journal compacted (%d records).\n", activeAccount->transactionCount);
+                break;
+            case 13:
+                switchAccountInteractive();
+                break;
+            case 14:
+                showBookSummary();
+                break;
+            case 15:
+                showTableHealth();
+                break;
+            case 16:
+                queryTransactionHistoryInteractive();
+                break;
+            case 17:
+                showTaxLots(activeAccount);
+                break;
+            case 18:
+                if (verifyHoldings(activeAccount, 0) > 0)
+                    printf("Run with --rebuild-holdings to replace them with the log's result.\n");
+                break;
+            case 19:
+                showLeaderboardInteractive();
+                break;
             case 0:
                 printf("Saving data and exiting...\n");
                 saveMarketToFile(MARKET_FILE);
-                saveHoldingsToFile(USER_FILE);
-                saveTransactionsToFile(TRANSACTION_FILE);
+                saveDirtyAccounts();
+                closeAllAccounts();
                 printf("Goodbye!\n");
                 break;
             default:
@@ -1186,12 +7798,144 @@ void userMenu() {
 
 // ================= MAIN FUNCTION =================
 
-int main() {
+void printUsage(const char *prog) {
+    printf("Usage: %s [--account NAME] [--threads N] [--group-commit N] [--history-window N] [--cost-basis AVG|FIFO|LIFO] [--verify-holdings | --rebuild-holdings] [--batch FILE [--checkpoint-every N]] [--no-snapshots] [--bench-parse] [--bench-layout N] [--bench-valuation N] [--bench-book N] [--bench-concurrent N] [--bench-suite N] [--gen-data N DIR] [--no-simd] [--ticks FILE [--follow]] [--gen-ticks N [--tick-rate R]]\n", prog);
+    printf("  --account NAME     start in account NAME (created on first save; default: %s)\n", DEFAULT_ACCOUNT);
+    printf("  --threads N        worker threads for book revaluation (0 = one per CPU)\n");
+    printf("  --group-commit N   fsync the transaction journal every N trades (0 = never)\n");
+    printf("  --history-window N keep only the last N transactions in memory (0 = all)\n");
+    printf("  --cost-basis R     lots closed by sells that do not name a relief (default AVG)\n");
+    printf("  --verify-holdings  at startup, compare every account's holdings with its transaction log\n");
+    printf("  --rebuild-holdings as --verify-holdings, then replace differing holdings with the log's result\n");
+    printf("  --batch FILE       apply BUY/SELL/PRICE/ACCOUNT orders from FILE ('-' = stdin) and exit\n");
+    printf("  --checkpoint-every N  persist after every N batch trades (0 = end of batch only)\n");
+    printf("  --no-snapshots     ignore and do not write the binary .bin snapshots\n");
+    printf("  --bench-parse      benchmark the fscanf loops against the fast text loader\n");
+    printf("  --bench-layout N   benchmark market scans over N rows as row structs vs columns\n");
+    printf("  --bench-valuation N  benchmark the valuation kernels over N positions\n");
+    printf("  --bench-book N     benchmark revaluing N synthetic accounts across thread counts\n");
+    printf("  --bench-concurrent N  list N symbols while --threads readers (default 3) read lock-free\n");
+    printf("  --bench-suite N    time the core table operations on a generated N row data set (CSV)\n");
+    printf("  --gen-data N DIR   write N row market and transaction files, and their holdings, to DIR\n");
+    printf("  --no-simd          use the scalar valuation kernels even if the CPU has AVX2\n");
+    printf("  --ticks FILE       apply \"SYMBOL PRICE [SENT_NS]\" price ticks from FILE ('-' = stdin) and exit\n");
+    printf("  --follow           with --ticks, keep reading as FILE grows until interrupted\n");
+    printf("  --gen-ticks N      write N synthetic ticks for the listed symbols to stdout and exit\n");
+    printf("  --tick-rate R      with --gen-ticks, pace output to R ticks/sec (0 = unthrottled)\n");
+}
+
+int main(int argc, char *argv[]) {
+    const char *batchFile = NULL;
+    int checkpointEvery = 0;
+    const char *tickFile = NULL;
+    int tickFollow = 0;
+    long genTicks = -1, tickRate = 0;
+    const char *accountName = DEFAULT_ACCOUNT;
+    int benchBook = -1, benchConcurrent = -1;
+    int benchLayout = -1, benchValuation = -1, benchParse = 0;
+    long benchSuite = -1, genDataRows = -1;
+    const char *genDataDir = NULL;
+    int verifyMode = -1;   // 0 = verify, 1 = rebuild holdings at startup
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--account") == 0 && i + 1 < argc) {
+            accountName = argv[++i];
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            poolThreads = atoi(argv[++i]);
+            if (poolThreads < 0) poolThreads = 0;
+        } else if (strcmp(argv[i], "--bench-concurrent") == 0 && i + 1 < argc) {
+            benchConcurrent = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--bench-suite") == 0 && i + 1 < argc) {
+            benchSuite = atol(argv[++i]);
+        } else if (strcmp(argv[i], "--gen-data") == 0 && i + 2 < argc) {
+            genDataRows = atol(argv[++i]);
+            genDataDir = argv[++i];
+        } else if (strcmp(argv[i], "--bench-book") == 0 && i + 1 < argc) {
+            benchBook = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--group-commit") == 0 && i + 1 < argc) {
+            journalGroupCommit = atoi(argv[++i]);
+            if (journalGroupCommit < 0) journalGroupCommit = 0;
+        } else if (strcmp(argv[i], "--history-window") == 0 && i + 1 < argc) {
+            historyWindow = atoi(argv[++i]);
+            if (historyWindow < 0) historyWindow = 0;
+        } else if (strcmp(argv[i], "--cost-basis") == 0 && i + 1 < argc) {
+            if (!parseRelief(argv[++i], &defaultRelief) || defaultRelief >= 0) {
+                printUsage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--verify-holdings") == 0) {
+            verifyMode = 0;
+        } else if (strcmp(argv[i], "--rebuild-holdings") == 0) {
+            verifyMode = 1;
+        } else if (strcmp(argv[i], "--batch") == 0 && i + 1 < argc) {
+            batchFile = argv[++i];
+        } else if (strcmp(argv[i], "--checkpoint-every") == 0 && i + 1 < argc) {
+            checkpointEvery = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--no-snapshots") == 0) {
+            useSnapshots = 0;
+        } else if (strcmp(argv[i], "--ticks") == 0 && i + 1 < argc) {
+            tickFile = argv[++i];
+        } else if (strcmp(argv[i], "--follow") == 0) {
+            tickFollow = 1;
+        } else if (strcmp(argv[i], "--gen-ticks") == 0 && i + 1 < argc) {
+            genTicks = atol(argv[++i]);
+        } else if (strcmp(argv[i], "--tick-rate") == 0 && i + 1 < argc) {
+            tickRate = atol(argv[++i]);
+        } else if (strcmp(argv[i], "--bench-layout") == 0 && i + 1 < argc) {
+            benchLayout = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--bench-valuation") == 0 && i + 1 < argc) {
+            benchValuation = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--no-simd") == 0) {
+            simdKernelsEnabled = 0;
+        } else if (strcmp(argv[i], "--bench-parse") == 0) {
+            benchParse = 1;
+        } else {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    // Benchmarks run once every flag is known (--threads, --no-simd, ...)
+    if (benchLayout >= 0) {
+        benchmarkMarketLayout(benchLayout);
+        return 0;
+    }
+    if (benchValuation >= 0) {
+        benchmarkValuation(benchValuation);
+        return 0;
+    }
+    if (benchParse) {
+        benchmarkTextParsers();
+        return 0;
+    }
+    if (benchSuite >= 0) {
+        // Works in its own scratch directory
+        return runBenchmarkSuite(benchSuite) ? 0 : 1;
+    }
+    if (genDataDir) {
+        if (!generateDataSet(genDataRows, genDataDir)) return 1;
+        printf("Wrote %ld market rows and %ld transactions, with the holdings they leave, to %s\n",
+               genDataRows > 0 ? genDataRows : 1000, genDataRows > 0 ? genDataRows : 1000, genDataDir);
+        return 0;
+    }
+
+    if (benchConcurrent >= 0) {
+        // Runs on an empty in-memory market; nothing is loaded or saved
+        benchmarkConcurrentReads(benchConcurrent);
+        return 0;
+    }
+
+    if (genTicks >= 0) {
+        // stdout carries the tick stream, so load quietly
+        initMarketTable();
+        loadMarketFromFile(MARKET_FILE);
+        return generatePriceTicks(genTicks, tickRate) ? 0 : 1;
+    }
+
     printf("Initializing Stock Portfolio Manager...\n");
     
     // Initialize tables
     initMarketTable();
-    initHoldingTable();
     
     // Load existing data
     if (loadMarketFromFile(MARKET_FILE)) {
@@ -1200,14 +7944,38 @@ int main() {
         printf("No existing market data found. Starting fresh.\n");
     }
     
-    if (loadHoldingsFromFile(USER_FILE)) {
+    if (benchBook >= 0) {
+        benchmarkBookRevaluation(benchBook);
+        return 0;
+    }
+
+    if (loadAllAccounts() > 0) {
         printf("Portfolio data loaded successfully.\n");
     } else {
         printf("No existing portfolio data found. Starting fresh.\n");
     }
-    
-    loadTransactionsFromFile(TRANSACTION_FILE);
+    if (accountCount > 1) printf("%d accounts found.\n", accountCount);
+    if (verifyMode >= 0) {
+        for (int i = 0; i < accountCount; i++) verifyHoldings(accounts[i], verifyMode);
+    }
+
+    if (!activateAccount(openAccount(accountName))) {
+        printf("Invalid account name: %s\n", accountName);
+        closeAllAccounts();
+        return 1;
+    }
     printf("Transaction history loaded.\n");
+
+    if (batchFile) {
+        int ok = runBatchOrders(batchFile, checkpointEvery);
+        closeAllAccounts();
+        return ok ? 0 : 2;
+    }
+    if (tickFile) {
+        int ok = runPriceTicks(tickFile, tickFollow);
+        closeAllAccounts();
+        return ok ? 0 : 2;
+    }
     
     // Start application
     userMenu();